@@ -30,9 +30,11 @@
     if(self)
     {
         NSString* bundlePath = [[NSBundle mainBundle] resourcePath];
+        NSString* cachePath = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject;
 
         Config currentConfig {
             .bundlePath { [bundlePath UTF8String] },
+            .cachePath { cachePath ? [cachePath UTF8String] : "" },
             .simulator {
                 .modelName { "turtle" },
                 .h = 0.005,
@@ -43,11 +45,24 @@
                 .loadedVert = 296,
                 .BCs = { 1, 3, 6, 8, 11, 12, 13, 15, 17, 18, 26, 29, 42, 45, 47, 49, 58, 59, 60, 247, 248, 256, 265 },
 
+                .elementModel = Config::Simulator::ElementModel::ARAP,
+                .warmStartRotations = true,
+                .instructionSet = Config::Simulator::InstructionSet::Auto,
+                .asynchronous = true,
+                .stepRate = 60.0,
+
                 .material {
                     .E = 30,
                     .nu = 0.35,
                     .rho = 1000,
+                    .model = Config::Simulator::Material::Model::ARAP,
                 }
+            },
+            .renderer {
+                .packNormals = false,
+                .motionThreshold = 1.e-4f,
+                .optimizeMeshes = true,
+                .quantizeInterpolationWeights = false,
             }
         };
 
@@ -63,7 +78,7 @@
     auto start = std::chrono::steady_clock::now();
 
     const State currentState = { g_Renderer.GetSelectedVert() }; // get it from app
-    const Result& result = g_Simulator.Step(currentState);
+    const Result& result = g_Simulator.Update(currentState);
     g_Renderer.Draw(view, currentState, result);
 
     auto end = std::chrono::steady_clock::now();
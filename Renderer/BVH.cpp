@@ -0,0 +1,204 @@
+//
+//  BVH.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "BVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    constexpr uint32_t maxLeafSize = 4;
+    constexpr int maxDepth = 64;
+}
+
+void BVH::Build(const std::vector<uint32_t>& indices, const Vertex* vertices)
+{
+    const uint32_t numTriangles = uint32_t(indices.size() / 3);
+    triangles.resize(numTriangles);
+    std::iota(triangles.begin(), triangles.end(), 0);
+
+    nodes.clear();
+    if (numTriangles == 0)
+        return;
+
+    std::vector<simd_float3> centroids(numTriangles);
+    for (uint32_t t = 0; t < numTriangles; ++t)
+        centroids[t] = (vertices[indices[3 * t]].position + vertices[indices[3 * t + 1]].position + vertices[indices[3 * t + 2]].position) / 3.f;
+
+    nodes.reserve(2 * numTriangles);
+    nodes.emplace_back();
+    BuildNode(centroids, 0, 0, numTriangles);
+
+    Refit(indices, vertices);
+}
+
+void BVH::BuildNode(const std::vector<simd_float3>& centroids, uint32_t node, uint32_t begin, uint32_t end)
+{
+    if (end - begin <= maxLeafSize)
+    {
+        nodes[node].first = begin;
+        nodes[node].count = end - begin;
+        return;
+    }
+
+    simd_float3 lo = centroids[triangles[begin]], hi = lo;
+    for (uint32_t i = begin + 1; i < end; ++i)
+    {
+        lo = simd_min(lo, centroids[triangles[i]]);
+        hi = simd_max(hi, centroids[triangles[i]]);
+    }
+    const simd_float3 extent = hi - lo;
+    const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    const uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    // children always come after their parent, Refit relies on it
+    const uint32_t left = uint32_t(nodes.size());
+    nodes[node].first = left;
+    nodes[node].count = 0;
+    nodes.emplace_back();
+    nodes.emplace_back();
+
+    BuildNode(centroids, left, begin, mid);
+    BuildNode(centroids, left + 1, mid, end);
+}
+
+void BVH::FitLeaf(Node& node, const uint32_t* indices, const Vertex* vertices) const
+{
+    const uint32_t* tri = &indices[3 * triangles[node.first]];
+    node.min = node.max = vertices[tri[0]].position;
+
+    for (uint32_t i = node.first; i < node.first + node.count; ++i)
+    {
+        tri = &indices[3 * triangles[i]];
+        for (int c = 0; c < 3; ++c)
+        {
+            node.min = simd_min(node.min, vertices[tri[c]].position);
+            node.max = simd_max(node.max, vertices[tri[c]].position);
+        }
+    }
+}
+
+void BVH::Refit(const std::vector<uint32_t>& indices, const Vertex* vertices)
+{
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        Node& node = nodes[i];
+        if (node.count > 0)
+        {
+            FitLeaf(node, indices.data(), vertices);
+        }
+        else
+        {
+            node.min = simd_min(nodes[node.first].min, nodes[node.first + 1].min);
+            node.max = simd_max(nodes[node.first].max, nodes[node.first + 1].max);
+        }
+    }
+}
+
+namespace
+{
+    // slab test, the entry distance if the box is hit before tMax
+    bool IntersectBox(simd_float3 origin, simd_float3 invDirection, simd_float3 min, simd_float3 max, float tMax, float& tEntry)
+    {
+        const simd_float3 t0 = (min - origin) * invDirection;
+        const simd_float3 t1 = (max - origin) * invDirection;
+        const simd_float3 tNear = simd_min(t0, t1);
+        const simd_float3 tFar = simd_max(t0, t1);
+
+        tEntry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+        const float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+        return tEntry <= tExit;
+    }
+
+    // Möller-Trumbore, two sided
+    bool IntersectTriangle(simd_float3 origin, simd_float3 direction, simd_float3 a, simd_float3 b, simd_float3 c, float& t, float& u, float& v)
+    {
+        const simd_float3 e1 = b - a;
+        const simd_float3 e2 = c - a;
+        const simd_float3 p = simd_cross(direction, e2);
+        const float det = simd_dot(e1, p);
+        if (std::abs(det) < 1.e-12f)
+            return false;
+
+        const float invDet = 1.f / det;
+        const simd_float3 s = origin - a;
+        u = simd_dot(s, p) * invDet;
+        if (u < 0.f || u > 1.f)
+            return false;
+
+        const simd_float3 q = simd_cross(s, e1);
+        v = simd_dot(direction, q) * invDet;
+        if (v < 0.f || u + v > 1.f)
+            return false;
+
+        t = simd_dot(e2, q) * invDet;
+        return t >= 0.f;
+    }
+}
+
+bool BVH::Intersect(simd_float3 origin, simd_float3 direction, const std::vector<uint32_t>& indices, const Vertex* vertices, RayHit& hit) const
+{
+    if (nodes.empty())
+        return false;
+
+    // a zero component gives an infinite slab, which the comparisons handle
+    const simd_float3 invDirection = simd_make_float3(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+
+    hit.t = INFINITY;
+    bool found = false;
+
+    uint32_t stack[maxDepth];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+
+        float tEntry;
+        if (!IntersectBox(origin, invDirection, node.min, node.max, hit.t, tEntry))
+            continue;
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+                const uint32_t* tri = &indices[3 * triangles[i]];
+
+                float t, u, v;
+                if (IntersectTriangle(origin, direction, vertices[tri[0]].position, vertices[tri[1]].position, vertices[tri[2]].position, t, u, v) &&
+                    t < hit.t)
+                {
+                    hit = RayHit{ triangles[i], t, u, v };
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // nearer child on top; median splits keep the tree well below maxDepth
+        float tLeft, tRight;
+        const bool left = IntersectBox(origin, invDirection, nodes[node.first].min, nodes[node.first].max, hit.t, tLeft);
+        const bool right = IntersectBox(origin, invDirection, nodes[node.first + 1].min, nodes[node.first + 1].max, hit.t, tRight);
+        if (left && right)
+        {
+            stack[stackSize++] = tLeft < tRight ? node.first + 1 : node.first;
+            stack[stackSize++] = tLeft < tRight ? node.first : node.first + 1;
+        }
+        else if (left)
+            stack[stackSize++] = node.first;
+        else if (right)
+            stack[stackSize++] = node.first + 1;
+    }
+    return found;
+}
@@ -0,0 +1,50 @@
+//
+//  BVH.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "ShaderTypes.h"
+
+#include <cstdint>
+#include <vector>
+
+struct RayHit
+{
+    uint32_t triangle;
+    // distance in units of the ray's direction, barycentrics of the 2nd and 3rd corner
+    float t, u, v;
+};
+
+// Bounding volume hierarchy over the triangles of a deforming mesh. The tree
+// is built once from the rest pose (median splits of the centroids); as the
+// mesh deforms only the boxes are refit, bottom-up, the topology stays.
+class BVH
+{
+public:
+    void Build(const std::vector<uint32_t>& indices, const Vertex* vertices);
+    void Refit(const std::vector<uint32_t>& indices, const Vertex* vertices);
+
+    bool IsEmpty() const { return nodes.empty(); }
+
+    // closest triangle along origin + t * direction, t >= 0
+    bool Intersect(simd_float3 origin, simd_float3 direction, const std::vector<uint32_t>& indices, const Vertex* vertices, RayHit& hit) const;
+
+private:
+    struct Node
+    {
+        simd_float3 min, max;
+        // leaf: triangles[first .. first + count), inner: children first and first + 1
+        uint32_t first, count;
+    };
+
+    void BuildNode(const std::vector<simd_float3>& centroids, uint32_t node, uint32_t begin, uint32_t end);
+    void FitLeaf(Node& node, const uint32_t* indices, const Vertex* vertices) const;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> triangles;
+};
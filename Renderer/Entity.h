@@ -9,6 +9,10 @@
 #pragma once
 
 #include "Mesh.h"
+#include "BVH.h"
+#include "InterpolationOperator.h"
+#include "MeshOptimizer.h"
+#include "VertexNormals.h"
 
 #include <Metal/Metal.h>
 
@@ -19,18 +23,46 @@ public:
 
     simd_float4x4 modelMatrix;
 
-    void SetDisplacement(const std::vector<simd_float3>& u);
-    void LoadGeometryFromFile(const std::string& fullPath, id<MTLDevice> device);
+    // u: xyz interleaved displacements of the simulation mesh; the surface
+    // stays at rest until LoadInterpolationWeights succeeded
+    void SetDisplacement(const double* u);
+    // cacheDirectory: where the optimized order is kept between runs, may be
+    // empty; false if the file could not be loaded, the reason is logged
+    bool LoadGeometryFromFile(const std::string& fullPath, id<MTLDevice> device,
+                              NormalEncoding normalEncoding = NormalEncoding::Float32,
+                              MeshOptimization optimization = MeshOptimization::None,
+                              const std::string& cacheDirectory = {});
     void Draw(id<MTLRenderCommandEncoder> renderEncoder, const simd_float4x4& viewProjectionMatrix);
 
-    void LoadInterpolationWeights(const std::string& filename);
+    // rows are per vertex in file order, remapped to the optimized one;
+    // filename is vega's .interp, a binary copy is picked up next to it or
+    // left in cacheDirectory (see InterpolationWeights::Load)
+    void LoadInterpolationWeights(const std::string& filename, const std::string& cacheDirectory = {},
+                                  InterpolationWeights::Encoding encoding = InterpolationWeights::Encoding::Float32);
+
+    // the simulation vertex under ndc (Metal's normalized device coordinates)
+    // as last drawn with viewProjectionMatrix, 0xFFFFFFFF if the surface is missed
+    // or there are no interpolation weights
+    uint32_t Pick(const simd_float4x4& viewProjectionMatrix, simd_float2 ndc);
+
+    // > 0: only update the surface around simulation vertices that moved more
+    // than this since the last update, see InterpolationOperator::ApplyDirty
+    void SetMotionThreshold(float threshold) { motionThreshold = threshold; }
 private:
-    struct Interpolator {
-        int numElementVertices;
-        int* vertices;
-        double* weights;
-    } interpolator;
+    InterpolationOperator interpolator;
 
     Mesh<Geometry<Vertex, uint32_t>> mesh;
     Geometry<Vertex, uint32_t> initGeometry;
+    VertexNormals normals;
+
+    // refit on the first Pick after the surface moved
+    BVH bvh;
+    bool bvhStale = false;
+
+    // vertexOrder[i]: the file's vertex now at i
+    std::vector<uint32_t> vertexOrder;
+
+    float motionThreshold = 0.f;
+    std::vector<uint32_t> movedVertices, updatedVertices;
+    std::vector<VertexRange> positionRanges, normalRanges;
 };
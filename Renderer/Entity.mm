@@ -12,101 +12,118 @@
 #include "LoadOBJ.h"
 
 #include <cmath>
+#include <iostream>
 
-#include "../Simulator/vega/volumetricMesh/volumetricMesh.h"
-
-void Entity::LoadGeometryFromFile(const std::string& fullPath, id<MTLDevice> device)
+bool Entity::LoadGeometryFromFile(const std::string& fullPath, id<MTLDevice> device, NormalEncoding normalEncoding,
+                                  MeshOptimization optimization, const std::string& cacheDirectory)
 {
-    mesh.geometry = LoadOBJ(fullPath);
+    std::string error;
+    if (!LoadOBJ(fullPath, mesh.geometry, error))
+    {
+        std::cout << error << '\n';
+        return false;
+    }
+
+    std::string cacheFile;
+    if (optimization != MeshOptimization::None && !cacheDirectory.empty())
+        cacheFile = cacheDirectory + '/' + fullPath.substr(fullPath.find_last_of('/') + 1) + ".order";
+    OptimizeMesh(mesh.geometry, optimization, cacheFile, vertexOrder);
+
     initGeometry = mesh.geometry;
-    mesh.CreateBuffers(device);
-    mesh.UploadGeometry();
+    mesh.CreateBuffers(device, normalEncoding);
+
+    normals.Build(mesh.geometry.indices, mesh.geometry.vertices.size());
+    bvh.Build(mesh.geometry.indices, mesh.geometry.vertices.data());
+    bvhStale = false;
 
-    interpolator.vertices = nullptr;
-    interpolator.weights = nullptr;
+    interpolator = InterpolationOperator{};
+    return true;
 }
 
-void Entity::LoadInterpolationWeights(const std::string& filename)
+void Entity::LoadInterpolationWeights(const std::string& filename, const std::string& cacheDirectory,
+                                      InterpolationWeights::Encoding encoding)
 {
-    interpolator.numElementVertices = VolumetricMesh::getNumInterpolationElementVertices(filename.c_str());
-    VolumetricMesh::loadInterpolationWeights(filename.c_str(),
-                                             mesh.geometry.vertices.size(),
-                                             interpolator.numElementVertices,
-                                             &(interpolator.vertices),
-                                             &(interpolator.weights));
+    const uint32_t numVertices = uint32_t(mesh.geometry.vertices.size());
+
+    std::string error;
+    InterpolationWeights weights;
+    if (!weights.Load(filename, InterpolationWeights::Source::ASCII, numVertices, cacheDirectory, encoding, error))
+    {
+        std::cout << error << '\n';
+        return;
+    }
+
+    // into the order of the optimized mesh
+    interpolator.Build(weights.GetModel(0), vertexOrder.data());
 }
 
-void Entity::SetDisplacement(const std::vector<simd_float3>& u)
+void Entity::SetDisplacement(const double* u)
 {
-    if (!interpolator.vertices)
+    // nothing was loaded
+    if (mesh.geometry.indices.empty())
+        return;
+
+    // the surface is only moved through its embedding, without one it stays at rest
+    if (interpolator.IsEmpty())
+        return;
+
+    bvhStale = true;
+
+    if (motionThreshold > 0.f)
     {
-        for (size_t i = 0; i < mesh.geometry.vertices.size(); ++i)
-            mesh.geometry.vertices[i].position = initGeometry.vertices[i].position + u[i];
+        // only what moved: its surface vertices, then the normals of their one-ring
+        interpolator.ApplyDirty(u, initGeometry.vertices.data(), mesh.geometry.vertices.data(), motionThreshold, movedVertices);
+        normals.ComputeAround(mesh.geometry.indices, mesh.geometry.vertices.data(), movedVertices, updatedVertices);
+
+        BuildVertexRanges(movedVertices, 16, positionRanges);
+        BuildVertexRanges(updatedVertices, 16, normalRanges);
+        mesh.UploadVertices(positionRanges, normalRanges);
     }
     else
     {
-        std::vector<double> simDisps;
-        simDisps.reserve(3 * u.size());
-        for (const auto& vx : u)
-            for (int i = 0; i < 3; ++i)
-                simDisps.emplace_back(double(vx[i]));
-
-        std::vector<double> interpolatedDisps(3 * mesh.geometry.vertices.size(), 0.0);
-
-        VolumetricMesh::interpolate(simDisps.data(),
-                                    interpolatedDisps.data(),
-                                    mesh.geometry.vertices.size(),
-                                    interpolator.numElementVertices,
-                                    interpolator.vertices,
-                                    interpolator.weights);
-
-        for (size_t i = 0; i < mesh.geometry.vertices.size(); ++i)
-        {
-            mesh.geometry.vertices[i].position =
-                initGeometry.vertices[i].position +
-                simd_float3{
-                    float(interpolatedDisps[3 * i + 0]),
-                    float(interpolatedDisps[3 * i + 1]),
-                    float(interpolatedDisps[3 * i + 2])
-                }
-            ;
-        }
-
-        // normal computation
-        const auto& vertices = mesh.geometry.vertices;
-        const auto& indices = mesh.geometry.indices;
-        std::vector<simd_float3> normals(vertices.size(), simd_float3{0,0,0});
-
-        for (size_t i = 0; i < indices.size() / 3; ++i)
-        {
-            uint32_t index0 = indices[3 * i + 0];
-            uint32_t index1 = indices[3 * i + 1];
-            uint32_t index2 = indices[3 * i + 2];
-
-            simd_float3 a = vertices[index0].position;
-            simd_float3 b = vertices[index1].position;
-            simd_float3 c = vertices[index2].position;
-
-            const simd_float3 ba = b - a;
-            const simd_float3 ca = c - a;
-
-            simd_float3 cross = simd_cross(ba, ca);
-            cross *= 0.5 / simd_length(cross);
-
-            normals[index0] += cross;
-            normals[index1] += cross;
-            normals[index2] += cross;
-        }
-
-        for (size_t i = 0; i < vertices.size(); ++i)
-            mesh.geometry.vertices[i].normal = simd_normalize(normals[i]);
+        // converts u to float once per simulation vertex, then gathers straight into the positions
+        interpolator.Apply(u, initGeometry.vertices.data(), mesh.geometry.vertices.data());
+
+        normals.Compute(mesh.geometry.indices, mesh.geometry.vertices.data());
+
+        mesh.UploadGeometry();
     }
+}
 
-    mesh.UploadGeometry();
+uint32_t Entity::Pick(const simd_float4x4& viewProjectionMatrix, simd_float2 ndc)
+{
+    // no embedding, no simulation vertex to map the hit to
+    if (bvh.IsEmpty() || interpolator.IsEmpty())
+        return 0xFFFFFFFF;
+
+    if (bvhStale)
+    {
+        bvh.Refit(mesh.geometry.indices, mesh.geometry.vertices.data());
+        bvhStale = false;
+    }
+
+    // the ray from the near to the far plane, in model space
+    const simd_float4x4 inverse = simd_inverse(matrix_multiply(viewProjectionMatrix, modelMatrix));
+    const simd_float4 near = matrix_multiply(inverse, simd_make_float4(ndc.x, ndc.y, 0.f, 1.f));
+    const simd_float4 far = matrix_multiply(inverse, simd_make_float4(ndc.x, ndc.y, 1.f, 1.f));
+    const simd_float3 origin = near.xyz / near.w;
+    const simd_float3 direction = far.xyz / far.w - origin;
+
+    RayHit hit;
+    if (!bvh.Intersect(origin, direction, mesh.geometry.indices, mesh.geometry.vertices.data(), hit))
+        return 0xFFFFFFFF;
+
+    const uint32_t* triangle = &mesh.geometry.indices[3 * hit.triangle];
+    const float barycentrics[3] = { 1.f - hit.u - hit.v, hit.u, hit.v };
+
+    return interpolator.FindNearestSource(triangle, barycentrics);
 }
 
 void Entity::Draw(id<MTLRenderCommandEncoder> renderEncoder, const simd_float4x4& viewProjectionMatrix)
 {
+    if (mesh.geometry.indices.empty())
+        return;
+
     modelMatrix =
     matrix_multiply(Matrix::Translation(0, -1.05, 0.5),
                     matrix_multiply(Matrix::Rotation((-30.f / 180) * M_PI),
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 template<typename VertexType,
@@ -17,3 +18,23 @@ struct Geometry
     std::vector<VertexType> vertices;
     std::vector<IndexType> indices;
 };
+
+// half-open range of vertices [begin, end)
+struct VertexRange
+{
+    uint32_t begin, end;
+};
+
+// coalesces ascending vertex indices into ranges, bridging gaps of up to
+// maxGap untouched vertices to keep the number of copies down
+inline void BuildVertexRanges(const std::vector<uint32_t>& sortedIndices, uint32_t maxGap, std::vector<VertexRange>& ranges)
+{
+    ranges.clear();
+    for (uint32_t index : sortedIndices)
+    {
+        if (!ranges.empty() && index <= ranges.back().end + maxGap)
+            ranges.back().end = index + 1;
+        else
+            ranges.push_back(VertexRange{ index, index + 1 });
+    }
+}
@@ -0,0 +1,235 @@
+//
+//  InterpolationOperator.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "InterpolationOperator.h"
+
+#include "../Simulator/ThreadPool.h"
+
+#include <algorithm>
+#include <utility>
+
+void InterpolationOperator::Build(const InterpolationWeights::Model& model, const uint32_t* targetOrder)
+{
+    ThreadPool& pool = ThreadPool::Get();
+
+    numTargets = model.numTargets;
+    const uint32_t numElementVertices = model.numElementVertices;
+
+    // each row sorted by source, repeated sources summed (in double, like a
+    // SparseMatrix would); rows are at most numElementVertices long
+    std::vector<uint32_t> rowIndices(size_t(numTargets) * numElementVertices);
+    std::vector<float> rowWeights(size_t(numTargets) * numElementVertices);
+    std::vector<uint32_t> rowLengths(numTargets);
+    pool.ParallelFor(0, int(numTargets), 4096, [&](int begin, int end) {
+        std::vector<std::pair<uint32_t, double>> row(numElementVertices);
+        for (int i = begin; i < end; ++i)
+        {
+            const size_t first = size_t(numElementVertices) * (targetOrder ? targetOrder[i] : uint32_t(i));
+            for (uint32_t j = 0; j < numElementVertices; ++j)
+                row[j] = { model.indices[first + j], model.GetWeight(first + j) };
+            std::stable_sort(row.begin(), row.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+            uint32_t length = 0;
+            double sum = 0.0;
+            for (uint32_t j = 0; j < numElementVertices; ++j)
+            {
+                sum += row[j].second;
+                if (j + 1 == numElementVertices || row[j + 1].first != row[j].first)
+                {
+                    rowIndices[size_t(numElementVertices) * i + length] = row[j].first;
+                    rowWeights[size_t(numElementVertices) * i + length] = float(sum);
+                    ++length;
+                    sum = 0.0;
+                }
+            }
+            rowLengths[i] = length;
+        }
+    });
+
+    width = 0;
+    numSources = 0;
+    for (uint32_t i = 0; i < numTargets; ++i)
+    {
+        width = std::max(width, rowLengths[i]);
+        if (rowLengths[i] > 0)
+            numSources = std::max(numSources, rowIndices[size_t(numElementVertices) * i + rowLengths[i] - 1] + 1);
+    }
+
+    indices.assign(numTargets * width, 0);
+    weights.assign(numTargets * width, 0.f);
+    pool.ParallelFor(0, int(numTargets), 4096, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            const uint32_t rowLength = rowLengths[i];
+            std::copy_n(&rowIndices[size_t(numElementVertices) * i], rowLength, &indices[width * i]);
+            std::copy_n(&rowWeights[size_t(numElementVertices) * i], rowLength, &weights[width * i]);
+
+            // padding gathers the row's first vertex again, which is in cache anyway
+            for (uint32_t j = rowLength; j < width; ++j)
+                indices[width * i + j] = rowLength > 0 ? indices[width * i] : 0;
+        }
+    });
+
+    sourceDisps.assign(numSources, simd_float3{ 0.f, 0.f, 0.f });
+
+    // transposed pattern, padding entries left out
+    sourceOffsets.assign(numSources + 1, 0);
+    for (uint32_t i = 0; i < numTargets; ++i)
+        for (uint32_t j = 0; j < width; ++j)
+            if (weights[width * i + j] != 0.f)
+                ++sourceOffsets[indices[width * i + j] + 1];
+    for (uint32_t s = 0; s < numSources; ++s)
+        sourceOffsets[s + 1] += sourceOffsets[s];
+
+    sourceTargets.resize(sourceOffsets.back());
+    std::vector<uint32_t> cursor(sourceOffsets.begin(), sourceOffsets.end() - 1);
+    for (uint32_t i = 0; i < numTargets; ++i)
+        for (uint32_t j = 0; j < width; ++j)
+            if (weights[width * i + j] != 0.f)
+                sourceTargets[cursor[indices[width * i + j]]++] = i;
+
+    moved.assign(numSources, 0);
+    targetStamps.assign(numTargets, 0);
+    stamp = 0;
+}
+
+void InterpolationOperator::Apply(const double* u, const Vertex* rest, Vertex* target)
+{
+    ThreadPool& pool = ThreadPool::Get();
+
+    pool.ParallelFor(0, int(numSources), 4096, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            sourceDisps[i] = simd_float3{ float(u[3 * i + 0]), float(u[3 * i + 1]), float(u[3 * i + 2]) };
+    });
+
+    pool.ParallelFor(0, int(numTargets), 2048, [&](int begin, int end) {
+        Gather(begin, end, rest, target);
+    });
+}
+
+void InterpolationOperator::ApplyDirty(const double* u, const Vertex* rest, Vertex* target, float threshold, std::vector<uint32_t>& dirtyTargets)
+{
+    ThreadPool& pool = ThreadPool::Get();
+
+    pool.ParallelFor(0, int(numSources), 4096, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            const simd_float3 disp{ float(u[3 * i + 0]), float(u[3 * i + 1]), float(u[3 * i + 2]) };
+            const simd_float3 delta = simd_abs(disp - sourceDisps[i]);
+
+            moved[i] = std::max(delta.x, std::max(delta.y, delta.z)) > threshold;
+            if (moved[i])
+                sourceDisps[i] = disp;
+        }
+    });
+
+    // stamps instead of clearing a flag array every frame
+    if (++stamp == 0)
+    {
+        std::fill(targetStamps.begin(), targetStamps.end(), 0);
+        stamp = 1;
+    }
+
+    dirtyTargets.clear();
+    for (uint32_t s = 0; s < numSources; ++s)
+    {
+        if (!moved[s])
+            continue;
+
+        for (uint32_t k = sourceOffsets[s]; k < sourceOffsets[s + 1]; ++k)
+        {
+            const uint32_t t = sourceTargets[k];
+            if (targetStamps[t] != stamp)
+            {
+                targetStamps[t] = stamp;
+                dirtyTargets.push_back(t);
+            }
+        }
+    }
+    std::sort(dirtyTargets.begin(), dirtyTargets.end());
+
+    pool.ParallelFor(0, int(dirtyTargets.size()), 2048, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k)
+            Gather(dirtyTargets[k], rest, target);
+    });
+}
+
+uint32_t InterpolationOperator::FindNearestSource(const uint32_t targets[3], const float barycentrics[3]) const
+{
+    // at most 3 * width distinct sources (width is 4 for tets, 8 for hexes)
+    uint32_t sources[3 * 8];
+    float sourceWeights[3 * 8];
+    uint32_t count = 0;
+
+    for (int k = 0; k < 3; ++k)
+    {
+        for (uint32_t j = 0; j < std::min(width, 8u); ++j)
+        {
+            const uint32_t source = indices[width * targets[k] + j];
+            const float weight = barycentrics[k] * weights[width * targets[k] + j];
+
+            uint32_t s = 0;
+            while (s < count && sources[s] != source)
+                ++s;
+            if (s == count)
+            {
+                sources[count] = source;
+                sourceWeights[count++] = 0.f;
+            }
+            sourceWeights[s] += weight;
+        }
+    }
+
+    uint32_t nearest = 0;
+    for (uint32_t s = 1; s < count; ++s)
+        if (sourceWeights[s] > sourceWeights[nearest])
+            nearest = s;
+    return sources[nearest];
+}
+
+void InterpolationOperator::Gather(uint32_t i, const Vertex* rest, Vertex* target) const
+{
+    const simd_float3* s = sourceDisps.data();
+    const uint32_t* idx = &indices[width * i];
+    const float* w = &weights[width * i];
+
+    simd_float3 disp = simd_float3{ 0.f, 0.f, 0.f };
+    for (uint32_t j = 0; j < width; ++j)
+        disp += w[j] * s[idx[j]];
+
+    target[i].position = rest[i].position + disp;
+}
+
+void InterpolationOperator::Gather(uint32_t begin, uint32_t end, const Vertex* rest, Vertex* target) const
+{
+    const simd_float3* s = sourceDisps.data();
+
+    if (width == 4)
+    {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const uint32_t* idx = &indices[4 * i];
+            const float* w = &weights[4 * i];
+            target[i].position = rest[i].position +
+                w[0] * s[idx[0]] + w[1] * s[idx[1]] + w[2] * s[idx[2]] + w[3] * s[idx[3]];
+        }
+        return;
+    }
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const uint32_t* idx = &indices[width * i];
+        const float* w = &weights[width * i];
+
+        simd_float3 disp = simd_float3{ 0.f, 0.f, 0.f };
+        for (uint32_t j = 0; j < width; ++j)
+            disp += w[j] * s[idx[j]];
+
+        target[i].position = rest[i].position + disp;
+    }
+}
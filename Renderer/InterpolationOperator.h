@@ -0,0 +1,68 @@
+//
+//  InterpolationOperator.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "InterpolationWeights.h"
+#include "ShaderTypes.h"
+
+#include <cstdint>
+#include <vector>
+
+// Embedding of a surface mesh in the simulation mesh as a sparse operator in
+// ELL layout: every surface vertex gathers exactly `width` simulation
+// vertices (shorter rows are padded with zero weights), with 32-bit indices
+// and float weights. Applied in parallel, straight into the vertex positions.
+class InterpolationOperator
+{
+public:
+    // row i of the operator is row targetOrder[i] of model (row i if
+    // targetOrder is null); model is only read here
+    void Build(const InterpolationWeights::Model& model, const uint32_t* targetOrder = nullptr);
+
+    bool IsEmpty() const { return numTargets == 0; }
+    uint32_t GetNumTargets() const { return numTargets; }
+    uint32_t GetNumSources() const { return numSources; }
+
+    // target[i].position = rest[i].position + sum_k w_ik u_(idx_ik), u being
+    // the xyz interleaved displacements of the simulation mesh
+    void Apply(const double* u, const Vertex* rest, Vertex* target);
+
+    // Apply limited to the surface vertices of simulation vertices that moved
+    // more than threshold (in any coordinate) since they were last applied;
+    // smaller motion is held back until it adds up. The re-gathered targets
+    // are written to dirtyTargets in ascending order.
+    void ApplyDirty(const double* u, const Vertex* rest, Vertex* target, float threshold, std::vector<uint32_t>& dirtyTargets);
+
+    // the simulation vertex with the largest weight in the point
+    // sum_k barycentrics[k] * target_k, e.g. a hit on a surface triangle
+    uint32_t FindNearestSource(const uint32_t targets[3], const float barycentrics[3]) const;
+
+private:
+    void Gather(uint32_t begin, uint32_t end, const Vertex* rest, Vertex* target) const;
+    void Gather(uint32_t i, const Vertex* rest, Vertex* target) const;
+
+    uint32_t numTargets = 0;
+    uint32_t numSources = 0;
+    uint32_t width = 0;
+
+    std::vector<uint32_t> indices;
+    std::vector<float> weights;
+
+    // u converted to float once per Apply, so the gather reads 16-byte aligned
+    // vectors; also the last applied displacement for ApplyDirty
+    std::vector<simd_float3> sourceDisps;
+
+    // transpose of the operator's pattern: surface vertices of each simulation vertex
+    std::vector<uint32_t> sourceOffsets;
+    std::vector<uint32_t> sourceTargets;
+
+    std::vector<uint8_t> moved;
+    std::vector<uint32_t> targetStamps;
+    uint32_t stamp = 0;
+};
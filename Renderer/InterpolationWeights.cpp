@@ -0,0 +1,352 @@
+//
+//  InterpolationWeights.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "InterpolationWeights.h"
+
+#include "../Simulator/CacheFile.h"
+#include "../Simulator/vega/volumetricMesh/volumetricMesh.h"
+#include "../Simulator/vega/volumetricMesh/interpolationWeightsMultiLoad.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr char binaryMagic[8] = { 'i', 'F', 'E', 'M', 'I', 'N', 'T', 'P' };
+    constexpr uint64_t alignment = 64;
+
+    uint64_t Align(uint64_t offset)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    bool Stat(const std::string& path, uint64_t& size, int64_t& time)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        size = uint64_t(st.st_size);
+        time = int64_t(st.st_mtime);
+        return true;
+    }
+
+    // the header of a binary weights file, if it is one
+    bool ReadHeader(const std::string& path, InterpolationWeights::BinaryHeader& header)
+    {
+        std::ifstream f(path, std::ios::binary);
+        return f.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+            memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) == 0 &&
+            header.version == InterpolationWeights::binaryVersion;
+    }
+
+    size_t WeightSize(InterpolationWeights::Encoding encoding)
+    {
+        return encoding == InterpolationWeights::Encoding::UNorm16 ? sizeof(uint16_t) : sizeof(float);
+    }
+}
+
+void InterpolationWeights::Release()
+{
+    if (mapping)
+        munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+
+    ownedIndices = {};
+    ownedWeights = {};
+    models.clear();
+    encoding = Encoding::Float32;
+}
+
+bool InterpolationWeights::Load(const std::string& sourcePath, Source source, uint32_t numTargets, const std::string& cacheDirectory,
+                                Encoding requestedEncoding, std::string& error)
+{
+    const size_t nameBegin = sourcePath.find_last_of('/') + 1;
+    const size_t extension = sourcePath.find_last_of('.');
+    const std::string basePath = extension != std::string::npos && extension > nameBegin ? sourcePath.substr(0, extension) : sourcePath;
+    const std::string name = basePath.substr(nameBegin);
+
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    const bool haveSource = Stat(sourcePath, sourceSize, sourceTime);
+
+    const auto matches = [&]() {
+        return numTargets == 0 || (!models.empty() && models[0].numTargets == numTargets);
+    };
+
+    // shipped next to the source (or instead of it), in whatever encoding it
+    // was made; the copy into the bundle doesn't keep the time
+    BinaryHeader header;
+    const std::string shippedPath = basePath + ".interpm";
+    if (ReadHeader(shippedPath, header) && (!haveSource || header.sourceSize == sourceSize) &&
+        LoadBinary(shippedPath, error) && matches())
+        return true;
+
+    const std::string cachedPath = cacheDirectory.empty() ? std::string{} : cacheDirectory + '/' + name + ".interpm";
+    if (!cachedPath.empty() && haveSource && ReadHeader(cachedPath, header) &&
+        header.sourceSize == sourceSize && header.sourceTime == sourceTime && header.encoding == uint32_t(requestedEncoding) &&
+        LoadBinary(cachedPath, error) && matches())
+        return true;
+
+    const bool converted = source == Source::ASCII ? LoadASCII(sourcePath, numTargets, error) : LoadVegaMultiBinary(sourcePath, error);
+    if (!converted)
+        return false;
+    if (!matches())
+    {
+        error = sourcePath + ": made for another surface";
+        Release();
+        return false;
+    }
+
+    // continue from the cache file, so this run sees the same (possibly
+    // quantized) weights as the next ones; a failed write only costs the
+    // fast path next time
+    std::string cacheError;
+    if (!cachedPath.empty() && SaveBinary(cachedPath, sourcePath, requestedEncoding, cacheError) &&
+        !LoadBinary(cachedPath, error))
+        return false;
+    return true;
+}
+
+bool InterpolationWeights::LoadBinary(const std::string& path, std::string& error)
+{
+    Release();
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        error = "Failed to open " + path;
+        return false;
+    }
+
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(BinaryHeader))
+        data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        error = "Failed to map " + path;
+        return false;
+    }
+    mapping = data;
+    mappingSize = size_t(st.st_size);
+
+    const auto fail = [&](const char* message) {
+        error = path + ": " + message;
+        Release();
+        return false;
+    };
+
+    BinaryHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) != 0)
+        return fail("not a binary weights file");
+    if (header.version != binaryVersion)
+        return fail("unsupported version");
+    if (header.encoding > uint32_t(Encoding::UNorm16))
+        return fail("unknown weight encoding");
+    if (header.numModels == 0 || sizeof(BinaryHeader) + uint64_t(header.numModels) * sizeof(ModelHeader) > mappingSize)
+        return fail("truncated or corrupt");
+
+    encoding = Encoding(header.encoding);
+    const char* bytes = static_cast<const char*>(mapping);
+
+    models.resize(header.numModels);
+    for (uint32_t m = 0; m < header.numModels; ++m)
+    {
+        ModelHeader modelHeader;
+        memcpy(&modelHeader, bytes + sizeof(BinaryHeader) + m * sizeof(ModelHeader), sizeof(modelHeader));
+
+        const uint64_t count = uint64_t(modelHeader.numTargets) * modelHeader.numElementVertices;
+        if (modelHeader.numElementVertices == 0 || count > INT32_MAX)
+            return fail("too many targets");
+
+        const uint64_t indicesSize = sizeof(uint32_t) * count;
+        const uint64_t weightsSize = WeightSize(encoding) * count;
+        if (modelHeader.indicesOffset % alignment != 0 || modelHeader.weightsOffset % alignment != 0 ||
+            modelHeader.indicesOffset < sizeof(BinaryHeader) || modelHeader.indicesOffset > mappingSize ||
+            indicesSize > mappingSize - modelHeader.indicesOffset || modelHeader.weightsOffset > mappingSize ||
+            weightsSize > mappingSize - modelHeader.weightsOffset)
+            return fail("truncated or corrupt");
+
+        Model& model = models[m];
+        model.numTargets = modelHeader.numTargets;
+        model.numElementVertices = modelHeader.numElementVertices;
+        model.indices = reinterpret_cast<const uint32_t*>(bytes + modelHeader.indicesOffset);
+        if (encoding == Encoding::UNorm16)
+            model.quantizedWeights = reinterpret_cast<const uint16_t*>(bytes + modelHeader.weightsOffset);
+        else
+            model.weights = reinterpret_cast<const float*>(bytes + modelHeader.weightsOffset);
+        model.weightMin = modelHeader.weightMin;
+        model.weightScale = modelHeader.weightScale;
+    }
+
+    return true;
+}
+
+bool InterpolationWeights::LoadASCII(const std::string& path, uint32_t numTargets, std::string& error)
+{
+    Release();
+
+    const int numElementVertices = VolumetricMesh::getNumInterpolationElementVertices(path.c_str());
+    int* vertices = nullptr;
+    double* weights = nullptr;
+    if (numElementVertices <= 0 ||
+        VolumetricMesh::loadInterpolationWeights(path.c_str(), int(numTargets), numElementVertices, &vertices, &weights) != 0)
+    {
+        free(vertices);
+        free(weights);
+        error = "Failed to load " + path;
+        return false;
+    }
+
+    const size_t count = size_t(numTargets) * numElementVertices;
+    ownedIndices.emplace_back(vertices, vertices + count);
+    ownedWeights.emplace_back(weights, weights + count);
+    free(vertices);
+    free(weights);
+
+    Model model;
+    model.numTargets = numTargets;
+    model.numElementVertices = uint32_t(numElementVertices);
+    model.indices = ownedIndices.back().data();
+    model.weights = ownedWeights.back().data();
+    models.push_back(model);
+    return true;
+}
+
+bool InterpolationWeights::LoadVegaMultiBinary(const std::string& path, std::string& error)
+{
+    Release();
+
+    int numModels = 0;
+    int* numTargetLocations = nullptr;
+    int* numElementVertices = nullptr;
+    int** vertices = nullptr;
+    double** weights = nullptr;
+    const bool loaded = multiLoadInterpolationWeightsBinary(path.c_str(), &numModels, &numTargetLocations, &numElementVertices,
+                                                            &vertices, &weights) == 0;
+
+    for (int m = 0; loaded && m < numModels; ++m)
+    {
+        const size_t count = size_t(numTargetLocations[m]) * numElementVertices[m];
+        ownedIndices.emplace_back(vertices[m], vertices[m] + count);
+        ownedWeights.emplace_back(weights[m], weights[m] + count);
+
+        Model model;
+        model.numTargets = uint32_t(numTargetLocations[m]);
+        model.numElementVertices = uint32_t(numElementVertices[m]);
+        model.indices = ownedIndices.back().data();
+        model.weights = ownedWeights.back().data();
+        models.push_back(model);
+    }
+
+    if (loaded)
+    {
+        for (int m = 0; m < numModels; ++m)
+        {
+            free(vertices[m]);
+            free(weights[m]);
+        }
+        free(numTargetLocations);
+        free(numElementVertices);
+        free(vertices);
+        free(weights);
+    }
+
+    if (!loaded || models.empty())
+    {
+        error = "Failed to load " + path;
+        Release();
+        return false;
+    }
+    return true;
+}
+
+bool InterpolationWeights::SaveBinary(const std::string& path, const std::string& sourcePath, Encoding outputEncoding,
+                                      std::string& error) const
+{
+    BinaryHeader header{};
+    memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+    header.version = binaryVersion;
+    header.encoding = uint32_t(outputEncoding);
+    header.numModels = uint32_t(models.size());
+    if (!sourcePath.empty())
+        Stat(sourcePath, header.sourceSize, header.sourceTime);
+
+    // the weights in the output encoding, and where everything goes
+    std::vector<ModelHeader> modelHeaders(models.size());
+    std::vector<std::vector<float>> floatWeights(models.size());
+    std::vector<std::vector<uint16_t>> quantizedWeights(models.size());
+    uint64_t offset = Align(sizeof(BinaryHeader) + models.size() * sizeof(ModelHeader));
+    for (size_t m = 0; m < models.size(); ++m)
+    {
+        const Model& model = models[m];
+        const size_t count = size_t(model.numTargets) * model.numElementVertices;
+
+        ModelHeader& modelHeader = modelHeaders[m];
+        modelHeader.numTargets = model.numTargets;
+        modelHeader.numElementVertices = model.numElementVertices;
+
+        floatWeights[m].resize(count);
+        for (size_t k = 0; k < count; ++k)
+            floatWeights[m][k] = model.GetWeight(k);
+
+        if (outputEncoding == Encoding::UNorm16)
+        {
+            const auto range = std::minmax_element(floatWeights[m].begin(), floatWeights[m].end());
+            modelHeader.weightMin = count > 0 ? *range.first : 0.f;
+            modelHeader.weightScale = count > 0 ? (*range.second - *range.first) / 65535.f : 0.f;
+
+            quantizedWeights[m].resize(count);
+            for (size_t k = 0; k < count; ++k)
+                quantizedWeights[m][k] = modelHeader.weightScale > 0.f ?
+                    uint16_t(std::min(65535.f, std::round((floatWeights[m][k] - modelHeader.weightMin) / modelHeader.weightScale))) : 0;
+            floatWeights[m] = {};
+        }
+
+        modelHeader.indicesOffset = offset;
+        modelHeader.weightsOffset = Align(offset + sizeof(uint32_t) * count);
+        offset = Align(modelHeader.weightsOffset + WeightSize(outputEncoding) * count);
+    }
+
+    return WriteCacheFile(path, error, [&](std::ofstream& f)
+    {
+        const char padding[alignment] = {};
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        f.write(reinterpret_cast<const char*>(modelHeaders.data()), std::streamsize(modelHeaders.size() * sizeof(ModelHeader)));
+        uint64_t written = sizeof(header) + modelHeaders.size() * sizeof(ModelHeader);
+        for (size_t m = 0; m < models.size(); ++m)
+        {
+            const ModelHeader& modelHeader = modelHeaders[m];
+            const uint64_t count = uint64_t(modelHeader.numTargets) * modelHeader.numElementVertices;
+
+            f.write(padding, std::streamsize(modelHeader.indicesOffset - written));
+            f.write(reinterpret_cast<const char*>(models[m].indices), std::streamsize(sizeof(uint32_t) * count));
+            written = modelHeader.indicesOffset + sizeof(uint32_t) * count;
+
+            f.write(padding, std::streamsize(modelHeader.weightsOffset - written));
+            if (outputEncoding == Encoding::UNorm16)
+                f.write(reinterpret_cast<const char*>(quantizedWeights[m].data()), std::streamsize(sizeof(uint16_t) * count));
+            else
+                f.write(reinterpret_cast<const char*>(floatWeights[m].data()), std::streamsize(sizeof(float) * count));
+            written = modelHeader.weightsOffset + WeightSize(outputEncoding) * count;
+        }
+    });
+}
@@ -0,0 +1,116 @@
+//
+//  InterpolationWeights.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The embedding of one or more surface meshes in the simulation mesh: for
+// every target (surface vertex) numElementVertices simulation vertices and
+// their weights. Either memory-mapped from a binary .interpm file and used in
+// place, or converted from one of vega's formats and owned.
+//
+// Binary layout, little-endian: a BinaryHeader, numModels ModelHeaders, then
+// per model the indices as numTargets x numElementVertices uint32s and the
+// weights as as many floats, or as uint16s that map [0, 65535] linearly onto
+// [weightMin, weightMin + 65535 * weightScale]. Arrays start at 64-byte
+// aligned offsets.
+class InterpolationWeights
+{
+public:
+    enum class Encoding : uint32_t
+    {
+        Float32,
+        // 16-bit quantized, an error of at most weightScale / 2 (~1e-5 for
+        // weights within [0, 1])
+        UNorm16,
+    };
+
+    enum class Source
+    {
+        // vega's .interp text, one model
+        ASCII,
+        // vega's multi-model binary, see interpolationWeightsMultiLoad.h
+        VegaMultiBinary,
+    };
+
+    struct BinaryHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t encoding;
+        uint32_t numModels;
+        uint32_t reserved;
+        // the file it was made from, to tell whether it is still current
+        uint64_t sourceSize;
+        int64_t sourceTime;
+    };
+
+    struct ModelHeader
+    {
+        uint32_t numTargets, numElementVertices;
+        uint64_t indicesOffset, weightsOffset;
+        float weightMin, weightScale;
+    };
+
+    // a view of one model's arrays
+    struct Model
+    {
+        uint32_t numTargets = 0, numElementVertices = 0;
+        const uint32_t* indices = nullptr;
+        // one of the two, by encoding
+        const float* weights = nullptr;
+        const uint16_t* quantizedWeights = nullptr;
+        float weightMin = 0.f, weightScale = 0.f;
+
+        float GetWeight(size_t k) const { return weights ? weights[k] : weightMin + weightScale * quantizedWeights[k]; }
+    };
+
+    static constexpr uint32_t binaryVersion = 1;
+
+    InterpolationWeights() = default;
+    ~InterpolationWeights() { Release(); }
+
+    InterpolationWeights(const InterpolationWeights&) = delete;
+    InterpolationWeights& operator=(const InterpolationWeights&) = delete;
+
+    // Takes the .interpm next to sourcePath (same name, extension replaced)
+    // if there is one, else cacheDirectory/<name>.interpm if it was made from
+    // the current sourcePath with this encoding, else converts sourcePath and
+    // then (cacheDirectory not empty) leaves the binary in the cache for the
+    // next time. numTargets: of the first model, for the ASCII source, which
+    // does not record it; also rejects a binary made for another surface.
+    bool Load(const std::string& sourcePath, Source source, uint32_t numTargets, const std::string& cacheDirectory,
+              Encoding encoding, std::string& error);
+
+    bool LoadBinary(const std::string& path, std::string& error);
+    bool LoadASCII(const std::string& path, uint32_t numTargets, std::string& error);
+    bool LoadVegaMultiBinary(const std::string& path, std::string& error);
+    // sourcePath: the file to record as the origin, may be empty
+    bool SaveBinary(const std::string& path, const std::string& sourcePath, Encoding encoding, std::string& error) const;
+
+    void Release();
+
+    bool IsMapped() const { return mapping != nullptr; }
+    Encoding GetEncoding() const { return encoding; }
+
+    uint32_t GetNumModels() const { return uint32_t(models.size()); }
+    const Model& GetModel(uint32_t model) const { return models[model]; }
+
+private:
+    Encoding encoding = Encoding::Float32;
+    std::vector<Model> models;
+
+    // storage behind the models: a read-only mapping, or these (float only)
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<std::vector<uint32_t>> ownedIndices;
+    std::vector<std::vector<float>> ownedWeights;
+};
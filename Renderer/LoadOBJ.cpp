@@ -0,0 +1,463 @@
+//
+//  LoadOBJ.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "LoadOBJ.h"
+
+#include "../Simulator/ThreadPool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr uint32_t noNormal = 0xFFFFFFFF;
+    constexpr size_t chunkSize = 1 << 20;
+
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& path)
+        {
+            const int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+
+            struct stat st;
+            if (fstat(fd, &st) == 0)
+            {
+                size = size_t(st.st_size);
+                if (size == 0)
+                    valid = true;
+                else if (void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0); p != MAP_FAILED)
+                {
+                    data = static_cast<const char*>(p);
+                    valid = true;
+                }
+            }
+            close(fd);
+        }
+
+        ~MappedFile()
+        {
+            if (data)
+                munmap(const_cast<char*>(data), size);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool valid = false;
+        const char* data = nullptr;
+        size_t size = 0;
+    };
+
+    // what a chunk holds, and after the prefix sums, where its data goes
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+        uint32_t lines = 0;
+        uint32_t positions = 0, normals = 0, uvs = 0, triangles = 0;
+        std::string error;
+    };
+
+    bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    const char* SkipSpace(const char* p, const char* end)
+    {
+        while (p < end && IsSpace(*p))
+            ++p;
+        return p;
+    }
+
+    const char* LineEnd(const char* p, const char* end)
+    {
+        const void* newline = memchr(p, '\n', size_t(end - p));
+        return newline ? static_cast<const char*>(newline) : end;
+    }
+
+    // exact powers for Clinger's fast path
+    constexpr double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    // Decimal float. The common case (at most 15 significant digits and a
+    // small exponent) is one exactly rounded double operation; the rest goes
+    // to strtod. std::from_chars for floating point would do, but it is not
+    // available on the deployment targets.
+    bool ParseFloat(const char*& p, const char* end, float& value)
+    {
+        const char* start = p;
+        const bool negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+            ++p;
+
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool any = false;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p, any = true)
+        {
+            if (digits < 19)
+            {
+                mantissa = 10 * mantissa + uint64_t(*p - '0');
+                digits += mantissa != 0;
+            }
+            else
+                ++exponent;
+        }
+        if (p < end && *p == '.')
+        {
+            for (++p; p < end && *p >= '0' && *p <= '9'; ++p, any = true)
+            {
+                if (digits < 19)
+                {
+                    mantissa = 10 * mantissa + uint64_t(*p - '0');
+                    digits += mantissa != 0;
+                    --exponent;
+                }
+            }
+        }
+        if (!any)
+            return false;
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            int e = 0;
+            const char* q = p + 1;
+            if (q < end && *q == '+')
+                ++q;
+            const auto [last, ec] = std::from_chars(q, end, e);
+            if (ec != std::errc{})
+                return false;
+            exponent += e;
+            p = last;
+        }
+
+        if (digits <= 15 && exponent >= -22 && exponent <= 22)
+        {
+            double d = double(mantissa);
+            d = exponent < 0 ? d / powersOf10[-exponent] : d * powersOf10[exponent];
+            value = float(negative ? -d : d);
+            return true;
+        }
+
+        char buffer[128];
+        const size_t length = std::min(size_t(p - start), sizeof(buffer) - 1);
+        memcpy(buffer, start, length);
+        buffer[length] = '\0';
+        value = std::strtof(buffer, nullptr);
+        return true;
+    }
+
+    bool ParseFloats(const char*& p, const char* end, float* values, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            p = SkipSpace(p, end);
+            if (!ParseFloat(p, end, values[i]))
+                return false;
+        }
+        return true;
+    }
+
+    // one-based into all count elements of the file, or negative counting
+    // back from the seenSoFar before the line; zero-based result
+    bool ResolveIndex(int64_t index, uint32_t seenSoFar, uint32_t count, uint32_t& resolved)
+    {
+        const int64_t r = index > 0 ? index - 1 : int64_t(seenSoFar) + index;
+        if (index == 0 || r < 0 || r >= int64_t(count))
+            return false;
+        resolved = uint32_t(r);
+        return true;
+    }
+
+    // the keyword of the line, and where its arguments start
+    enum class Keyword { Other, Position, Normal, UV, Face };
+
+    Keyword ReadKeyword(const char*& p, const char* end)
+    {
+        p = SkipSpace(p, end);
+        const char* word = p;
+        while (p < end && !IsSpace(*p))
+            ++p;
+
+        const size_t length = size_t(p - word);
+        if (length == 1 && word[0] == 'v')
+            return Keyword::Position;
+        if (length == 1 && word[0] == 'f')
+            return Keyword::Face;
+        if (length == 2 && word[0] == 'v' && word[1] == 'n')
+            return Keyword::Normal;
+        if (length == 2 && word[0] == 'v' && word[1] == 't')
+            return Keyword::UV;
+        return Keyword::Other;
+    }
+
+    uint32_t CountCorners(const char* p, const char* end)
+    {
+        uint32_t corners = 0;
+        while (true)
+        {
+            p = SkipSpace(p, end);
+            if (p == end || *p == '#')
+                return corners;
+            ++corners;
+            while (p < end && !IsSpace(*p))
+                ++p;
+        }
+    }
+
+    void CountChunk(Chunk& chunk)
+    {
+        for (const char* line = chunk.begin; line < chunk.end;)
+        {
+            const char* end = LineEnd(line, chunk.end);
+            ++chunk.lines;
+
+            const char* p = line;
+            switch (ReadKeyword(p, end))
+            {
+                case Keyword::Position: ++chunk.positions; break;
+                case Keyword::Normal: ++chunk.normals; break;
+                case Keyword::UV: ++chunk.uvs; break;
+                case Keyword::Face:
+                {
+                    const uint32_t corners = CountCorners(p, end);
+                    chunk.triangles += corners >= 3 ? corners - 2 : 0;
+                    break;
+                }
+                default: break;
+            }
+            line = end + 1;
+        }
+    }
+
+    struct Output
+    {
+        Vertex* vertices;
+        simd_float3* normals;
+        uint32_t* indices;
+        uint32_t* cornerNormals;
+        uint32_t numPositions, numNormals, numUVs;
+    };
+
+    // chunk's counters hold the offsets of its data by now
+    bool ParseChunk(Chunk& chunk, uint32_t firstLine, const Output& out)
+    {
+        uint32_t position = chunk.positions, normal = chunk.normals, uv = chunk.uvs;
+        uint32_t corner = 3 * chunk.triangles;
+        uint32_t lineNumber = firstLine;
+
+        const auto fail = [&](const char* message) {
+            chunk.error = "line " + std::to_string(lineNumber) + ": " + message;
+            return false;
+        };
+
+        for (const char* line = chunk.begin; line < chunk.end;)
+        {
+            const char* end = LineEnd(line, chunk.end);
+            ++lineNumber;
+
+            const char* p = line;
+            switch (ReadKeyword(p, end))
+            {
+                case Keyword::Position:
+                {
+                    float xyz[3];
+                    if (!ParseFloats(p, end, xyz, 3))
+                        return fail("bad vertex position");
+                    out.vertices[position++] = Vertex{ simd_make_float3(xyz[0], xyz[1], xyz[2]), simd_make_float3(0.f, 0.f, 0.f) };
+                    break;
+                }
+                case Keyword::Normal:
+                {
+                    float xyz[3];
+                    if (!ParseFloats(p, end, xyz, 3))
+                        return fail("bad vertex normal");
+                    out.normals[normal++] = simd_make_float3(xyz[0], xyz[1], xyz[2]);
+                    break;
+                }
+                case Keyword::UV:
+                    ++uv;
+                    break;
+                case Keyword::Face:
+                {
+                    uint32_t first[2] = {}, previous[2] = {};
+                    uint32_t corners = 0;
+                    while (true)
+                    {
+                        p = SkipSpace(p, end);
+                        if (p == end || *p == '#')
+                            break;
+
+                        // v, v/vt, v//vn or v/vt/vn
+                        int64_t v = 0, vt = 0, vn = 0;
+                        auto r = std::from_chars(p, end, v);
+                        if (r.ec != std::errc{})
+                            return fail("bad face index");
+                        p = r.ptr;
+                        if (p < end && *p == '/')
+                        {
+                            ++p;
+                            if (p < end && *p != '/')
+                            {
+                                r = std::from_chars(p, end, vt);
+                                if (r.ec != std::errc{})
+                                    return fail("bad face texture index");
+                                p = r.ptr;
+                            }
+                            if (p < end && *p == '/')
+                            {
+                                r = std::from_chars(p + 1, end, vn);
+                                if (r.ec != std::errc{})
+                                    return fail("bad face normal index");
+                                p = r.ptr;
+                            }
+                        }
+                        if (p < end && !IsSpace(*p))
+                            return fail("bad face corner");
+
+                        uint32_t current[2], unused;
+                        if (!ResolveIndex(v, position, out.numPositions, current[0]))
+                            return fail("face index out of range");
+                        if (vt != 0 && !ResolveIndex(vt, uv, out.numUVs, unused))
+                            return fail("face texture index out of range");
+                        current[1] = noNormal;
+                        if (vn != 0 && !ResolveIndex(vn, normal, out.numNormals, current[1]))
+                            return fail("face normal index out of range");
+
+                        // fan: (first, previous, current) from the third corner on
+                        if (corners == 0)
+                            std::copy(current, current + 2, first);
+                        else if (corners >= 2)
+                        {
+                            const uint32_t* triangle[3] = { first, previous, current };
+                            for (const uint32_t* c : triangle)
+                            {
+                                out.indices[corner] = c[0];
+                                out.cornerNormals[corner++] = c[1];
+                            }
+                        }
+                        std::copy(current, current + 2, previous);
+                        ++corners;
+                    }
+                    if (corners < 3)
+                        return fail("face with fewer than 3 corners");
+                    break;
+                }
+                default:
+                    break;
+            }
+            line = end + 1;
+        }
+        return true;
+    }
+}
+
+bool LoadOBJ(const std::string& fullPath, Geometry<Vertex, uint32_t>& geometry, std::string& error)
+{
+    geometry.vertices.clear();
+    geometry.indices.clear();
+
+    const MappedFile file(fullPath);
+    if (!file.valid)
+    {
+        error = "Failed to open " + fullPath;
+        return false;
+    }
+
+    // chunks start right after a newline
+    std::vector<Chunk> chunks;
+    const char* const fileEnd = file.data + file.size;
+    for (const char* begin = file.data; begin < fileEnd;)
+    {
+        const char* end = begin + std::min(chunkSize, size_t(fileEnd - begin));
+        if (end < fileEnd)
+            end = std::min(LineEnd(end, fileEnd) + 1, fileEnd);
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = end;
+        begin = end;
+    }
+
+    ThreadPool& pool = ThreadPool::Get();
+
+    pool.ParallelFor(0, int(chunks.size()), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            CountChunk(chunks[i]);
+    });
+
+    // exclusive prefix sums turn the counts into offsets
+    Output out{};
+    std::vector<uint32_t> firstLines(chunks.size());
+    uint32_t numTriangles = 0, numLines = 0;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        Chunk& chunk = chunks[i];
+        firstLines[i] = numLines;
+        numLines += chunk.lines;
+
+        std::swap(chunk.positions, out.numPositions);
+        out.numPositions += chunk.positions;
+        std::swap(chunk.normals, out.numNormals);
+        out.numNormals += chunk.normals;
+        std::swap(chunk.uvs, out.numUVs);
+        out.numUVs += chunk.uvs;
+        std::swap(chunk.triangles, numTriangles);
+        numTriangles += chunk.triangles;
+    }
+
+    if (out.numPositions == 0)
+    {
+        error = fullPath + ": no vertices";
+        return false;
+    }
+
+    geometry.vertices.resize(out.numPositions);
+    geometry.indices.resize(3 * size_t(numTriangles));
+    std::vector<simd_float3> normals(out.numNormals);
+    std::vector<uint32_t> cornerNormals(geometry.indices.size());
+
+    out.vertices = geometry.vertices.data();
+    out.normals = normals.data();
+    out.indices = geometry.indices.data();
+    out.cornerNormals = cornerNormals.data();
+
+    pool.ParallelFor(0, int(chunks.size()), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            ParseChunk(chunks[i], firstLines[i], out);
+    });
+
+    for (const Chunk& chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            error = fullPath + ": " + chunk.error;
+            geometry.vertices.clear();
+            geometry.indices.clear();
+            return false;
+        }
+    }
+
+    // in file order, so the last corner wins as it always did
+    for (size_t c = 0; c < geometry.indices.size(); ++c)
+        if (cornerNormals[c] != noNormal)
+            geometry.vertices[geometry.indices[c]].normal = normals[cornerNormals[c]];
+
+    return true;
+}
@@ -11,90 +11,14 @@
 #include "Geometry.h"
 #include "ShaderTypes.h"
 
-#include <vector>
 #include <string>
-#include <iostream>
-#include <fstream>
-#include <sstream>
 
-struct Index { uint32_t v[3], n[3], uv[3]; };
-
-Geometry<Vertex, uint32_t> LoadOBJ(const std::string& fullPath)
-{
-    std::ifstream f(fullPath);
-    if (!f.is_open())
-    {
-        std::cout << "Failed to open " << fullPath << '\n';
-        std::exit(420);
-    }
-
-    // parse OBJ
-    std::vector<std::string> lines;
-    std::string line;
-
-    while (std::getline(f, line))
-        lines.push_back(line);
-
-    std::vector<simd_float3> vertices;
-    std::vector<simd_float3> normals;
-    std::vector<simd_float2> uvs;
-    std::vector<Index>       indices;
-
-    for (const auto& i : lines)
-    {
-        std::stringstream line{i};
-        std::string type;
-        line >> type;
-        if(type == "v")
-        {
-            float x, y, z;
-            line >> x >> y >> z;
-            vertices.push_back(simd_float3{x,y,z});
-        }
-        else if(type == "vt")
-        {
-            float u, v;
-            line >> u >> v;
-            uvs.push_back(simd_float2{u,v});
-        }
-
-        else if(type == "vn")
-        {
-            float x, y, z;
-            line >> x >> y >> z;
-            normals.push_back(simd_float3{x,y,z});
-        }
-        else if(type == "f")
-        {
-            Index i;
-            char c;
-            for (int j = 0; j < 3; ++j) {
-                line >> i.v[j] >> c >> i.uv[j] >> c >> i.n[j];
-            }
-            indices.push_back(i);
-        }
-    }
-
-    // generate output
-    std::vector<Vertex>   outVertices;
-    std::vector<uint32_t> outIndices;
-    outVertices.reserve(vertices.size());
-    outIndices.reserve(indices.size());
-
-    for (const auto& v : vertices)
-        outVertices.emplace_back(Vertex{{v},{}});
-
-    for (const auto& index : indices)
-    {
-        for (int j = 0; j < 3; ++j)
-        {
-            uint32_t vIndex = index.v[j] - 1;
-            uint32_t nIndex = index.n[j] - 1;
-            uint32_t uvIndex = index.uv[j] - 1;
-
-            outVertices[vIndex].normal = normals[nIndex];
-            outIndices.emplace_back(vIndex);
-        }
-    }
-    return { outVertices, outIndices };
-};
+// Positions, normals and triangles of a Wavefront OBJ. Faces may use any of
+// the v, v/vt, v//vn and v/vt/vn forms, negative (relative) indices, and more
+// than three corners (fanned into triangles); a vertex takes the normal of
+// the last corner referring to it. Texture coordinates are skipped.
+//
+// The file is memory-mapped and parsed in parallel, in chunks split at line
+// boundaries. Returns false with a message in error if the file can't be
+// read or is malformed.
+bool LoadOBJ(const std::string& fullPath, Geometry<Vertex, uint32_t>& geometry, std::string& error);
@@ -9,7 +9,9 @@
 #pragma once
 
 #include "Geometry.h"
+#include "MetalUploadBackend.h"
 #include "ShaderTypes.h"
+#include "VertexStreams.h"
 
 #include <Metal/Metal.h>
 
@@ -23,10 +25,16 @@ public:
     ~Mesh() = default;
     Mesh(Geometry geometry) : geometry{geometry} {}
 
-    void CreateBuffers(id<MTLDevice> device);
+    // also uploads the whole geometry, the indices for good
+    void CreateBuffers(id<MTLDevice> device, NormalEncoding normalEncoding = NormalEncoding::Float32);
+    // positions and normals in full
     void UploadGeometry();
+    // only the given vertex ranges of each stream
+    void UploadVertices(const std::vector<VertexRange>& positionRanges, const std::vector<VertexRange>& normalRanges);
     void Draw(id<MTLRenderCommandEncoder> renderEncoder);
+
+    const UploadBackend& GetUploadBackend() const { return backend; }
 private:
-    id<MTLBuffer> vertexBuffer;
-    id<MTLBuffer> indexBuffer;
+    MetalUploadBackend backend;
+    VertexStreams streams;
 };
@@ -8,32 +8,56 @@
 
 #include "Mesh.h"
 
+// the position and normal members of the vertex array, for the streams
+static VertexSource GetVertexSource(const std::vector<Vertex>& vertices)
+{
+    VertexSource source;
+    if (!vertices.empty())
+    {
+        source.positions = reinterpret_cast<const float*>(&vertices.front().position);
+        source.normals = reinterpret_cast<const float*>(&vertices.front().normal);
+        source.stride = sizeof(Vertex);
+    }
+    return source;
+}
+
 template<>
-void Mesh<Geometry<Vertex, uint32_t>>::CreateBuffers(id<MTLDevice> device)
+void Mesh<Geometry<Vertex, uint32_t>>::CreateBuffers(id<MTLDevice> device, NormalEncoding normalEncoding)
 {
-    vertexBuffer = [device newBufferWithLength:sizeof(Vertex) * geometry.vertices.size()
-                                       options:MTLResourceStorageModeShared];
-    indexBuffer = [device newBufferWithLength:sizeof(uint32_t) * geometry.indices.size()
-                                      options:MTLResourceStorageModeShared];
+    backend = MetalUploadBackend{};
+    backend.SetDevice(device);
+    streams.Create(backend, GetVertexSource(geometry.vertices), uint32_t(geometry.vertices.size()), geometry.indices, normalEncoding);
 }
 
 template<>
 void Mesh<Geometry<Vertex, uint32_t>>::UploadGeometry()
 {
-    memcpy(vertexBuffer.contents, geometry.vertices.data(), sizeof(Vertex) * geometry.vertices.size());
-    memcpy(indexBuffer.contents, geometry.indices.data(), sizeof(uint32_t) * geometry.indices.size());
+    streams.MarkDirty(VertexStreams::Positions);
+    streams.MarkDirty(VertexStreams::Normals);
+    streams.Flush(backend, GetVertexSource(geometry.vertices));
+}
+
+template<>
+void Mesh<Geometry<Vertex, uint32_t>>::UploadVertices(const std::vector<VertexRange>& positionRanges, const std::vector<VertexRange>& normalRanges)
+{
+    streams.MarkDirty(VertexStreams::Positions, positionRanges);
+    streams.MarkDirty(VertexStreams::Normals, normalRanges);
+    streams.Flush(backend, GetVertexSource(geometry.vertices));
 }
 
 template<>
 void Mesh<Geometry<Vertex, uint32_t>>::Draw(id<MTLRenderCommandEncoder> renderEncoder)
 {
-    [renderEncoder setVertexBuffer:vertexBuffer
+    [renderEncoder setVertexBuffer:backend.GetBuffer(streams.GetBuffer(VertexStreams::Positions))
+                            offset:0
+                           atIndex:VertexInputIndexPositions];
+    [renderEncoder setVertexBuffer:backend.GetBuffer(streams.GetBuffer(VertexStreams::Normals))
                             offset:0
-                           atIndex:VertexInputIndexVertices];
+                           atIndex:VertexInputIndexNormals];
     [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
                               indexCount:geometry.indices.size()
                                indexType:MTLIndexTypeUInt32
-                             indexBuffer:indexBuffer
+                             indexBuffer:backend.GetBuffer(streams.GetIndexBuffer())
                        indexBufferOffset:0];
 }
 
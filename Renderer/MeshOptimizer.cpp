@@ -0,0 +1,321 @@
+//
+//  MeshOptimizer.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "MeshOptimizer.h"
+
+#include "../Simulator/CacheFile.h"
+#include "../Simulator/Hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+float ComputeACMR(const std::vector<uint32_t>& indices, uint32_t numVertices, uint32_t cacheSize)
+{
+    if (indices.empty())
+        return 0.f;
+
+    // a vertex is in the FIFO while fewer than cacheSize misses happened since its own
+    std::vector<uint64_t> missTime(numVertices, 0);
+    uint64_t misses = 0;
+    for (uint32_t index : indices)
+    {
+        if (missTime[index] == 0 || misses - missTime[index] >= cacheSize)
+            missTime[index] = ++misses;
+    }
+    return float(misses) / float(indices.size() / 3);
+}
+
+namespace
+{
+    constexpr int cacheSize = 32;
+    constexpr float cacheDecayPower = 1.5f;
+    constexpr float lastTriangleScore = 0.75f;
+    constexpr float valenceBoostScale = 2.f;
+    constexpr float valenceBoostPower = 0.5f;
+
+    float VertexScore(int cachePosition, uint32_t remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+            return -1.f;
+
+        float score = 0.f;
+        if (cachePosition >= 0)
+        {
+            // the last triangle's vertices get a fixed score, so the next one
+            // is not just a repeat of an edge
+            if (cachePosition < 3)
+                score = lastTriangleScore;
+            else
+                score = std::pow(1.f - float(cachePosition - 3) / float(cacheSize - 3), cacheDecayPower);
+        }
+        // vertices with few triangles left are worth finishing off
+        return score + valenceBoostScale * std::pow(float(remainingTriangles), -valenceBoostPower);
+    }
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t numVertices)
+{
+    const uint32_t numTriangles = uint32_t(indices.size() / 3);
+    if (numTriangles == 0)
+        return;
+
+    // vertex -> triangle adjacency (CSR); the live triangles of vertex v are
+    // the first remaining[v] of its list
+    std::vector<uint32_t> offsets(numVertices + 1, 0);
+    for (uint32_t index : indices)
+        ++offsets[index + 1];
+    for (uint32_t v = 0; v < numVertices; ++v)
+        offsets[v + 1] += offsets[v];
+
+    std::vector<uint32_t> triangles(indices.size());
+    std::vector<uint32_t> remaining(numVertices, 0);
+    for (uint32_t t = 0; t < numTriangles; ++t)
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t v = indices[3 * t + c];
+            triangles[offsets[v] + remaining[v]++] = t;
+        }
+
+    std::vector<int> cachePositions(numVertices, -1);
+    std::vector<float> vertexScores(numVertices);
+    for (uint32_t v = 0; v < numVertices; ++v)
+        vertexScores[v] = VertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScores(numTriangles);
+    for (uint32_t t = 0; t < numTriangles; ++t)
+        triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+
+    std::vector<uint8_t> emitted(numTriangles, 0);
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    // the three vertices of the triangle just emitted go in front of the
+    // cache, which may grow past cacheSize by as much before being cut back
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(cacheSize + 3);
+    nextCache.reserve(cacheSize + 3);
+
+    uint32_t scanStart = 0;
+    int64_t best = -1;
+    while (result.size() < indices.size())
+    {
+        if (best < 0)
+        {
+            // nothing in the cache has triangles left: best score of the rest
+            float bestScore = -1.f;
+            while (scanStart < numTriangles && emitted[scanStart])
+                ++scanStart;
+            for (uint32_t t = scanStart; t < numTriangles; ++t)
+            {
+                if (!emitted[t] && triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+
+        const uint32_t t = uint32_t(best);
+        emitted[t] = 1;
+
+        nextCache.clear();
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t v = indices[3 * t + c];
+            result.push_back(v);
+            nextCache.push_back(v);
+
+            // drop t from the live part of v's triangle list
+            uint32_t* live = &triangles[offsets[v]];
+            uint32_t* end = live + remaining[v];
+            *std::find(live, end, t) = *(end - 1);
+            --remaining[v];
+        }
+        for (uint32_t v : cache)
+            if (v != nextCache[0] && v != nextCache[1] && v != nextCache[2])
+                nextCache.push_back(v);
+
+        // rescore what is in or just fell out of the cache
+        for (size_t i = 0; i < nextCache.size(); ++i)
+        {
+            const uint32_t v = nextCache[i];
+            cachePositions[v] = i < cacheSize ? int(i) : -1;
+
+            const float score = VertexScore(cachePositions[v], remaining[v]);
+            const float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+
+            for (uint32_t k = 0; k < remaining[v]; ++k)
+                triangleScores[triangles[offsets[v] + k]] += delta;
+        }
+
+        if (nextCache.size() > cacheSize)
+            nextCache.resize(cacheSize);
+        std::swap(cache, nextCache);
+
+        // the next triangle comes from the cache if it has any left
+        best = -1;
+        float bestScore = -1.f;
+        for (uint32_t v : cache)
+        {
+            for (uint32_t k = 0; k < remaining[v]; ++k)
+            {
+                const uint32_t candidate = triangles[offsets[v] + k];
+                if (triangleScores[candidate] > bestScore)
+                {
+                    bestScore = triangleScores[candidate];
+                    best = candidate;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+void OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t numVertices, std::vector<uint32_t>& vertexOrder)
+{
+    constexpr uint32_t unused = 0xFFFFFFFF;
+
+    std::vector<uint32_t> newIndex(numVertices, unused);
+    vertexOrder.clear();
+    vertexOrder.reserve(numVertices);
+
+    for (uint32_t& index : indices)
+    {
+        if (newIndex[index] == unused)
+        {
+            newIndex[index] = uint32_t(vertexOrder.size());
+            vertexOrder.push_back(index);
+        }
+        index = newIndex[index];
+    }
+
+    for (uint32_t v = 0; v < numVertices; ++v)
+        if (newIndex[v] == unused)
+            vertexOrder.push_back(v);
+}
+
+namespace
+{
+    constexpr uint32_t cacheMagic = 0x4F4D4669; // "iFMO"
+    constexpr uint32_t cacheVersion = 2;
+
+    struct CacheHeader
+    {
+        uint32_t magic, version;
+        uint32_t mode;
+        uint32_t numVertices, numIndices;
+        float acmrBefore, acmrAfter;
+        uint32_t reserved;
+        uint64_t indexHash;
+    };
+
+    // FNV-1a over the index buffer in file order
+    uint64_t HashIndices(const std::vector<uint32_t>& indices)
+    {
+        Hash hash;
+        hash.Add(indices.data(), sizeof(uint32_t) * indices.size());
+        return hash.value;
+    }
+
+    bool ReadCache(const std::string& cacheFile, const CacheHeader& expected, CacheHeader& header, std::vector<uint32_t>& indices, std::vector<uint32_t>& vertexOrder)
+    {
+        std::ifstream f(cacheFile, std::ios::binary);
+        if (!f.is_open() || !f.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            return false;
+
+        if (header.magic != expected.magic || header.version != expected.version || header.mode != expected.mode ||
+            header.numVertices != expected.numVertices || header.numIndices != expected.numIndices ||
+            header.indexHash != expected.indexHash)
+            return false;
+
+        // read aside, the outputs are only replaced by a valid cache
+        std::vector<uint32_t> cachedIndices(header.numIndices), cachedOrder(header.numVertices);
+        f.read(reinterpret_cast<char*>(cachedIndices.data()), sizeof(uint32_t) * cachedIndices.size());
+        f.read(reinterpret_cast<char*>(cachedOrder.data()), sizeof(uint32_t) * cachedOrder.size());
+        if (!f)
+            return false;
+
+        // never trust it with out of range ids
+        for (uint32_t index : cachedIndices)
+            if (index >= header.numVertices)
+                return false;
+        std::vector<uint8_t> seen(header.numVertices, 0);
+        for (uint32_t v : cachedOrder)
+        {
+            if (v >= header.numVertices || seen[v])
+                return false;
+            seen[v] = 1;
+        }
+
+        indices.swap(cachedIndices);
+        vertexOrder.swap(cachedOrder);
+        return true;
+    }
+
+    void WriteCache(const std::string& cacheFile, const CacheHeader& header, const std::vector<uint32_t>& indices, const std::vector<uint32_t>& vertexOrder)
+    {
+        std::string error;
+        const bool written = WriteCacheFile(cacheFile, error, [&](std::ofstream& f)
+        {
+            f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            f.write(reinterpret_cast<const char*>(indices.data()), sizeof(uint32_t) * indices.size());
+            f.write(reinterpret_cast<const char*>(vertexOrder.data()), sizeof(uint32_t) * vertexOrder.size());
+        });
+        if (!written)
+            std::cout << error << '\n';
+    }
+}
+
+void OptimizeMesh(Geometry<Vertex, uint32_t>& geometry, MeshOptimization mode, const std::string& cacheFile, std::vector<uint32_t>& vertexOrder)
+{
+    const uint32_t numVertices = uint32_t(geometry.vertices.size());
+
+    vertexOrder.resize(numVertices);
+    std::iota(vertexOrder.begin(), vertexOrder.end(), 0);
+
+    if (mode == MeshOptimization::None)
+        return;
+
+    CacheHeader header{ cacheMagic, cacheVersion, uint32_t(mode), numVertices, uint32_t(geometry.indices.size()),
+                        0.f, 0.f, 0, HashIndices(geometry.indices) };
+
+    std::vector<uint32_t> indices;
+    CacheHeader cached;
+    if (!cacheFile.empty() && ReadCache(cacheFile, header, cached, indices, vertexOrder))
+    {
+        header = cached;
+    }
+    else
+    {
+        indices = geometry.indices;
+        header.acmrBefore = ComputeACMR(indices, numVertices);
+
+        OptimizeVertexCache(indices, numVertices);
+        if (mode == MeshOptimization::VertexCacheAndFetch)
+            OptimizeVertexFetch(indices, numVertices, vertexOrder);
+
+        header.acmrAfter = ComputeACMR(indices, numVertices);
+
+        if (!cacheFile.empty())
+            WriteCache(cacheFile, header, indices, vertexOrder);
+    }
+
+    std::cout << "mesh: ACMR " << header.acmrBefore << " -> " << header.acmrAfter << '\n';
+
+    geometry.indices.swap(indices);
+
+    std::vector<Vertex> vertices(numVertices);
+    for (uint32_t v = 0; v < numVertices; ++v)
+        vertices[v] = geometry.vertices[vertexOrder[v]];
+    geometry.vertices.swap(vertices);
+}
@@ -0,0 +1,43 @@
+//
+//  MeshOptimizer.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "Geometry.h"
+#include "ShaderTypes.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class MeshOptimization
+{
+    None,
+    // triangle order only, vertex ids stay those of the file
+    VertexCache,
+    // triangle order, then vertices renumbered by first use
+    VertexCacheAndFetch,
+};
+
+// average cache miss ratio: transformed vertices per triangle with a FIFO
+// post-transform cache of cacheSize entries (0.5 at best, 3 at worst)
+float ComputeACMR(const std::vector<uint32_t>& indices, uint32_t numVertices, uint32_t cacheSize = 16);
+
+// Forsyth's linear-speed vertex cache optimization: greedily emits the
+// triangle whose vertices score best on cache position and remaining valence
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t numVertices);
+
+// renumbers the vertices in order of first use (unused ones go last, in their
+// old order), rewriting indices; vertexOrder[new] = old
+void OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t numVertices, std::vector<uint32_t>& vertexOrder);
+
+// Runs the above on geometry as loaded from a file and reports the ACMR before
+// and after. The result only depends on the index buffer, so it is stored in
+// cacheFile (if not empty) keyed on a hash of it, and reused on the next load.
+// vertexOrder[new] = old, the identity unless the vertices were reordered.
+void OptimizeMesh(Geometry<Vertex, uint32_t>& geometry, MeshOptimization mode, const std::string& cacheFile, std::vector<uint32_t>& vertexOrder);
@@ -0,0 +1,31 @@
+//
+//  MetalUploadBackend.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "UploadBackend.h"
+
+#include <Metal/Metal.h>
+
+// shared storage buffers, written in place by the CPU
+class MetalUploadBackend : public UploadBackend
+{
+public:
+    void SetDevice(id<MTLDevice> device) { this->device = device; }
+
+    BufferId CreateBuffer(size_t size) override;
+
+    id<MTLBuffer> GetBuffer(BufferId buffer) const { return buffers[buffer]; }
+
+protected:
+    void Write(BufferId buffer, size_t offset, const void* data, size_t size) override;
+
+private:
+    id<MTLDevice> device;
+    std::vector<id<MTLBuffer>> buffers;
+};
@@ -0,0 +1,21 @@
+//
+//  MetalUploadBackend.mm
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "MetalUploadBackend.h"
+
+UploadBackend::BufferId MetalUploadBackend::CreateBuffer(size_t size)
+{
+    buffers.push_back([device newBufferWithLength:size
+                                          options:MTLResourceStorageModeShared]);
+    return BufferId(buffers.size() - 1);
+}
+
+void MetalUploadBackend::Write(BufferId buffer, size_t offset, const void* data, size_t size)
+{
+    memcpy(static_cast<uint8_t*>(buffers[buffer].contents) + offset, data, size);
+}
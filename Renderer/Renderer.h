@@ -28,6 +28,7 @@ public:
     void Draw(MTKView* mtkView, const State& state, const Result& result);
 
     void SetViewportSize(CGSize size);
+    // picks the simulation vertex under pos (in pixels) on the CPU
     void SetReadPos(CGPoint pos);
 
     uint32_t GetSelectedVert() { return selectedVert; }
@@ -47,18 +48,9 @@ private:
     id<MTLRenderPipelineState> pipelineState;
     id<MTLDepthStencilState> depthStencilState;
 
-    id<MTLRenderPipelineState> indexPipelineState;
-    id<MTLTexture> indexTexture;
-    id<MTLTexture> indexDepth;
-    MTLRenderPassDescriptor* indexRenderPassDescriptor;
-
-    id<MTLBuffer> readBuffer;
-    vector_float2 readPos;
     uint32_t selectedVert;
-    bool shouldReadTexture = false;
 
     Entity surfaceMesh;
-    Entity deformable;
 
     simd_float4x4 viewProjectionMatrix;
     vector_uint2 viewportSize;
@@ -12,10 +12,16 @@
 
 typedef enum VertexInputIndex
 {
-    VertexInputIndexVertices = 0,
-    VertexInputIndexMVP      = 1,
+    VertexInputIndexPositions = 0,
+    VertexInputIndexMVP       = 1,
+    VertexInputIndexNormals   = 2,
 } VertexInputIndex;
 
+typedef enum FunctionConstantIndex
+{
+    FunctionConstantIndexPackedNormals = 0,
+} FunctionConstantIndex;
+
 typedef struct
 {
     matrix_float4x4 modelMatrix, modelMatrixInv, viewProjMatrix;
@@ -27,3 +33,13 @@ typedef struct
     vector_float3 position;
     vector_float3 normal;
 } Vertex;
+
+// 12-byte float3 of the vertex streams
+#ifdef __METAL_VERSION__
+typedef packed_float3 PackedFloat3;
+#else
+typedef struct
+{
+    float x, y, z;
+} PackedFloat3;
+#endif
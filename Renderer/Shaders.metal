@@ -21,15 +21,33 @@ struct RasterizerData
     float3 eyePos;
 };
 
+constant bool packedNormals [[function_constant(FunctionConstantIndexPackedNormals)]];
+constant bool floatNormals = !packedNormals;
+
+// inverse of PackNormalOctahedral in VertexEncoding.h
+static float3 UnpackNormalOctahedral(uint packed)
+{
+    const float2 e = unpack_snorm2x16_to_float(packed);
+
+    float3 n = float3(e, 1.f - abs(e.x) - abs(e.y));
+    if (n.z < 0.f)
+        n.xy = (1.f - abs(e.yx)) * select(float2(-1.f), float2(1.f), e >= 0.f);
+    return normalize(n);
+}
+
 vertex RasterizerData
 vertexShader(uint vertexID [[vertex_id]],
-             constant Vertex *vertices [[buffer(VertexInputIndexVertices)]],
+             constant PackedFloat3 *positions [[buffer(VertexInputIndexPositions)]],
+             constant PackedFloat3 *normals [[buffer(VertexInputIndexNormals), function_constant(floatNormals)]],
+             constant uint *octahedralNormals [[buffer(VertexInputIndexNormals), function_constant(packedNormals)]],
              constant FrameData *frameData [[buffer(VertexInputIndexMVP)]])
 {
+    const float3 normal = packedNormals ? UnpackNormalOctahedral(octahedralNormals[vertexID]) : float3(normals[vertexID]);
+
     RasterizerData out;
-    out.worldPos = (frameData->modelMatrix * float4(vertices[vertexID].position, 1)).xyz;
+    out.worldPos = (frameData->modelMatrix * float4(float3(positions[vertexID]), 1)).xyz;
     out.position = frameData->viewProjMatrix * float4(out.worldPos, 1);
-    out.normal = (vector_float4(vertices[vertexID].normal, 1) * frameData->modelMatrixInv).xyz;
+    out.normal = (vector_float4(normal, 1) * frameData->modelMatrixInv).xyz;
     out.eyePos = { 0,0,4 };
     return out;
 }
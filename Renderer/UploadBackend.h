@@ -0,0 +1,80 @@
+//
+//  UploadBackend.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Where vertex streams end up. Every write goes through Upload, which also
+// keeps count of the traffic, so the same streaming code can run against the
+// GPU or headless against system memory.
+class UploadBackend
+{
+public:
+    using BufferId = uint32_t;
+
+    virtual ~UploadBackend() = default;
+
+    virtual BufferId CreateBuffer(size_t size) = 0;
+
+    void Upload(BufferId buffer, size_t offset, const void* data, size_t size)
+    {
+        uploadedBytes += size;
+        ++numUploads;
+        Write(buffer, offset, data, size);
+    }
+
+    size_t GetUploadedBytes() const { return uploadedBytes; }
+    size_t GetNumUploads() const { return numUploads; }
+    void ResetCounters() { uploadedBytes = 0; numUploads = 0; }
+
+protected:
+    virtual void Write(BufferId buffer, size_t offset, const void* data, size_t size) = 0;
+
+private:
+    size_t uploadedBytes = 0;
+    size_t numUploads = 0;
+};
+
+// buffers in system memory
+class CPUUploadBackend : public UploadBackend
+{
+public:
+    BufferId CreateBuffer(size_t size) override
+    {
+        buffers.emplace_back(size);
+        return BufferId(buffers.size() - 1);
+    }
+
+    const std::vector<uint8_t>& GetContents(BufferId buffer) const { return buffers[buffer]; }
+
+protected:
+    void Write(BufferId buffer, size_t offset, const void* data, size_t size) override
+    {
+        memcpy(buffers[buffer].data() + offset, data, size);
+    }
+
+private:
+    std::vector<std::vector<uint8_t>> buffers;
+};
+
+// drops the data, only the counters remain
+class NullUploadBackend : public UploadBackend
+{
+public:
+    BufferId CreateBuffer(size_t) override { return numBuffers++; }
+
+protected:
+    void Write(BufferId, size_t, const void*, size_t) override {}
+
+private:
+    BufferId numBuffers = 0;
+};
@@ -0,0 +1,97 @@
+//
+//  VertexEncoding.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "Geometry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// How the vertex streams are encoded, on plain floats so that it builds (and
+// can be checked) without simd.
+
+// float triples of each vertex, stride bytes apart (e.g. the position and
+// normal members of an array of Vertex)
+struct VertexSource
+{
+    const float* positions = nullptr;
+    const float* normals = nullptr;
+    size_t stride = 0;
+
+    const float* Position(uint32_t i) const { return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + stride * i); }
+    const float* Normal(uint32_t i) const { return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(normals) + stride * i); }
+};
+
+// octahedral encoding into two 16-bit snorms (x in the low half)
+inline uint32_t PackNormalOctahedral(float nx, float ny, float nz)
+{
+    const float l1 = std::abs(nx) + std::abs(ny) + std::abs(nz);
+    if (l1 == 0.f)
+        return 0;
+
+    float x = nx / l1;
+    float y = ny / l1;
+    if (nz < 0.f)
+    {
+        const float fx = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+        const float fy = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+        x = fx;
+        y = fy;
+    }
+
+    const auto snorm16 = [](float v) {
+        v = v < -1.f ? -1.f : (v > 1.f ? 1.f : v);
+        return uint32_t(uint16_t(int16_t(std::lround(v * 32767.f))));
+    };
+    return snorm16(x) | (snorm16(y) << 16);
+}
+
+// the inverse, normalized
+inline void UnpackNormalOctahedral(uint32_t packed, float n[3])
+{
+    const float x = std::max(float(int16_t(packed & 0xFFFF)) / 32767.f, -1.f);
+    const float y = std::max(float(int16_t(packed >> 16)) / 32767.f, -1.f);
+
+    n[0] = x;
+    n[1] = y;
+    n[2] = 1.f - std::abs(x) - std::abs(y);
+    if (n[2] < 0.f)
+    {
+        n[0] = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+        n[1] = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+    }
+
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    n[0] /= length;
+    n[1] /= length;
+    n[2] /= length;
+}
+
+// 12-byte float3 per vertex, the layout of PackedFloat3 in ShaderTypes.h
+inline void EncodeFloat3(const VertexSource& source, bool normals, VertexRange range, float* encoded)
+{
+    for (uint32_t i = range.begin; i < range.end; ++i)
+    {
+        const float* v = normals ? source.Normal(i) : source.Position(i);
+        encoded[3 * i + 0] = v[0];
+        encoded[3 * i + 1] = v[1];
+        encoded[3 * i + 2] = v[2];
+    }
+}
+
+inline void EncodeNormalsOctahedral(const VertexSource& source, VertexRange range, uint32_t* encoded)
+{
+    for (uint32_t i = range.begin; i < range.end; ++i)
+    {
+        const float* n = source.Normal(i);
+        encoded[i] = PackNormalOctahedral(n[0], n[1], n[2]);
+    }
+}
@@ -0,0 +1,131 @@
+//
+//  VertexNormals.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "VertexNormals.h"
+
+#include "../Simulator/ThreadPool.h"
+
+#include <algorithm>
+
+void VertexNormals::Build(const std::vector<uint32_t>& indices, size_t numVertices)
+{
+    this->numVertices = uint32_t(numVertices);
+    const uint32_t numFaces = uint32_t(indices.size() / 3);
+
+    // counting sort of the face corners by vertex
+    offsets.assign(numVertices + 1, 0);
+    for (uint32_t index : indices)
+        ++offsets[index + 1];
+    for (size_t v = 0; v < numVertices; ++v)
+        offsets[v + 1] += offsets[v];
+
+    faces.resize(indices.size());
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (uint32_t f = 0; f < numFaces; ++f)
+        for (int c = 0; c < 3; ++c)
+            faces[cursor[indices[3 * f + c]]++] = f;
+
+    faceNormals.resize(numFaces);
+
+    faceStamps.assign(numFaces, 0);
+    vertexStamps.assign(numVertices, 0);
+    stamp = 0;
+}
+
+void VertexNormals::Compute(const std::vector<uint32_t>& indices, Vertex* vertices)
+{
+    ThreadPool& pool = ThreadPool::Get();
+
+    pool.ParallelFor(0, int(faceNormals.size()), 4096, [&](int begin, int end) {
+        ComputeFaceNormals(indices.data(), vertices, begin, end);
+    });
+
+    pool.ParallelFor(0, int(numVertices), 4096, [&](int begin, int end) {
+        GatherVertexNormals(vertices, begin, end);
+    });
+}
+
+void VertexNormals::ComputeAround(const std::vector<uint32_t>& indices, Vertex* vertices, const std::vector<uint32_t>& moved, std::vector<uint32_t>& updated)
+{
+    // stamps instead of clearing flag arrays every frame
+    if (++stamp == 0)
+    {
+        std::fill(faceStamps.begin(), faceStamps.end(), 0);
+        std::fill(vertexStamps.begin(), vertexStamps.end(), 0);
+        stamp = 1;
+    }
+
+    dirtyFaces.clear();
+    updated.clear();
+    for (uint32_t v : moved)
+    {
+        for (uint32_t k = offsets[v]; k < offsets[v + 1]; ++k)
+        {
+            const uint32_t f = faces[k];
+            if (faceStamps[f] == stamp)
+                continue;
+
+            faceStamps[f] = stamp;
+            dirtyFaces.push_back(f);
+
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint32_t w = indices[3 * f + c];
+                if (vertexStamps[w] != stamp)
+                {
+                    vertexStamps[w] = stamp;
+                    updated.push_back(w);
+                }
+            }
+        }
+    }
+    std::sort(updated.begin(), updated.end());
+
+    ThreadPool& pool = ThreadPool::Get();
+
+    pool.ParallelFor(0, int(dirtyFaces.size()), 4096, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k)
+            ComputeFaceNormals(indices.data(), vertices, dirtyFaces[k], dirtyFaces[k] + 1);
+    });
+
+    pool.ParallelFor(0, int(updated.size()), 4096, [&](int begin, int end) {
+        for (int k = begin; k < end; ++k)
+            GatherVertexNormal(vertices, updated[k]);
+    });
+}
+
+void VertexNormals::ComputeFaceNormals(const uint32_t* indices, const Vertex* vertices, uint32_t begin, uint32_t end)
+{
+    for (uint32_t f = begin; f < end; ++f)
+    {
+        const simd_float3 a = vertices[indices[3 * f + 0]].position;
+        const simd_float3 b = vertices[indices[3 * f + 1]].position;
+        const simd_float3 c = vertices[indices[3 * f + 2]].position;
+
+        faceNormals[f] = simd_normalize(simd_cross(b - a, c - a));
+    }
+}
+
+void VertexNormals::GatherVertexNormals(Vertex* vertices, uint32_t begin, uint32_t end)
+{
+    for (uint32_t v = begin; v < end; ++v)
+        GatherVertexNormal(vertices, v);
+}
+
+void VertexNormals::GatherVertexNormal(Vertex* vertices, uint32_t v)
+{
+    // isolated vertices keep their normal
+    if (offsets[v] == offsets[v + 1])
+        return;
+
+    simd_float3 n = simd_make_float3(0.f, 0.f, 0.f);
+    for (uint32_t k = offsets[v]; k < offsets[v + 1]; ++k)
+        n += faceNormals[faces[k]];
+
+    vertices[v].normal = simd_normalize(n);
+}
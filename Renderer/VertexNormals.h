@@ -0,0 +1,53 @@
+//
+//  VertexNormals.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "ShaderTypes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Smooth normals of a triangle mesh, every incident triangle weighted
+// equally (the shading the surface always had). The vertex -> incident
+// triangle adjacency (CSR) is built once; each recompute is a face pass and a
+// per-vertex gather, both race-free and run on the thread pool, into storage
+// that is only allocated by Build.
+class VertexNormals
+{
+public:
+    void Build(const std::vector<uint32_t>& indices, size_t numVertices);
+
+    // writes vertices[].normal from the current positions
+    void Compute(const std::vector<uint32_t>& indices, Vertex* vertices);
+
+    // Compute limited to the one-ring of the moved vertices: their incident
+    // faces, and every vertex of those. The vertices whose normal was
+    // rewritten (a superset of moved) go to updated, in ascending order.
+    void ComputeAround(const std::vector<uint32_t>& indices, Vertex* vertices, const std::vector<uint32_t>& moved, std::vector<uint32_t>& updated);
+
+private:
+    void ComputeFaceNormals(const uint32_t* indices, const Vertex* vertices, uint32_t begin, uint32_t end);
+    void GatherVertexNormals(Vertex* vertices, uint32_t begin, uint32_t end);
+    void GatherVertexNormal(Vertex* vertices, uint32_t v);
+
+    uint32_t numVertices = 0;
+
+    // incident faces of vertex v: faces[offsets[v] .. offsets[v + 1])
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> faces;
+
+    std::vector<simd_float3> faceNormals;
+
+    // ComputeAround scratch
+    std::vector<uint32_t> dirtyFaces;
+    std::vector<uint32_t> faceStamps, vertexStamps;
+    uint32_t stamp = 0;
+};
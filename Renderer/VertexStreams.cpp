@@ -0,0 +1,94 @@
+//
+//  VertexStreams.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "VertexStreams.h"
+
+#include <algorithm>
+
+void VertexStreams::Create(UploadBackend& backend, const VertexSource& vertices, uint32_t numVertices, const std::vector<uint32_t>& indices, NormalEncoding normalEncoding)
+{
+    this->numVertices = numVertices;
+    this->normalEncoding = normalEncoding;
+
+    positions.resize(3 * size_t(numVertices));
+    normals.resize(normalEncoding == NormalEncoding::Float32 ? 3 * size_t(numVertices) : 0);
+    packedNormals.resize(normalEncoding == NormalEncoding::Octahedral16 ? numVertices : 0);
+
+    indexBuffer = backend.CreateBuffer(sizeof(uint32_t) * indices.size());
+    backend.Upload(indexBuffer, 0, indices.data(), sizeof(uint32_t) * indices.size());
+
+    for (int stream = 0; stream < NumDynamicStreams; ++stream)
+    {
+        buffers[stream] = backend.CreateBuffer(GetStride(Stream(stream)) * numVertices);
+        MarkDirty(Stream(stream));
+    }
+    Flush(backend, vertices);
+}
+
+size_t VertexStreams::GetStride(Stream stream) const
+{
+    if (stream == Normals && normalEncoding == NormalEncoding::Octahedral16)
+        return sizeof(uint32_t);
+    return 3 * sizeof(float);
+}
+
+void VertexStreams::MarkDirty(Stream stream, const std::vector<VertexRange>& ranges)
+{
+    dirtyRanges[stream].insert(dirtyRanges[stream].end(), ranges.begin(), ranges.end());
+}
+
+void VertexStreams::MarkDirty(Stream stream)
+{
+    dirtyRanges[stream].assign(1, VertexRange{ 0, numVertices });
+}
+
+void VertexStreams::Flush(UploadBackend& backend, const VertexSource& vertices)
+{
+    for (int s = 0; s < NumDynamicStreams; ++s)
+    {
+        const Stream stream = Stream(s);
+        std::vector<VertexRange>& ranges = dirtyRanges[stream];
+        if (ranges.empty())
+            continue;
+
+        // several MarkDirty calls between flushes may overlap
+        std::sort(ranges.begin(), ranges.end(), [](const VertexRange& a, const VertexRange& b) { return a.begin < b.begin; });
+        size_t numMerged = 0;
+        for (const VertexRange& range : ranges)
+        {
+            if (numMerged > 0 && range.begin <= ranges[numMerged - 1].end)
+                ranges[numMerged - 1].end = std::max(ranges[numMerged - 1].end, range.end);
+            else
+                ranges[numMerged++] = range;
+        }
+        ranges.resize(numMerged);
+
+        const size_t stride = GetStride(stream);
+        const uint8_t* encoded =
+            stream == Positions ? reinterpret_cast<const uint8_t*>(positions.data()) :
+            normalEncoding == NormalEncoding::Float32 ? reinterpret_cast<const uint8_t*>(normals.data()) :
+                                                        reinterpret_cast<const uint8_t*>(packedNormals.data());
+
+        for (const VertexRange& range : ranges)
+        {
+            Encode(stream, vertices, range);
+            backend.Upload(buffers[stream], stride * range.begin, encoded + stride * range.begin, stride * (range.end - range.begin));
+        }
+        ranges.clear();
+    }
+}
+
+void VertexStreams::Encode(Stream stream, const VertexSource& vertices, VertexRange range)
+{
+    if (stream == Positions)
+        EncodeFloat3(vertices, false, range, positions.data());
+    else if (normalEncoding == NormalEncoding::Float32)
+        EncodeFloat3(vertices, true, range, normals.data());
+    else
+        EncodeNormalsOctahedral(vertices, range, packedNormals.data());
+}
@@ -0,0 +1,68 @@
+//
+//  VertexStreams.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "Geometry.h"
+#include "UploadBackend.h"
+#include "VertexEncoding.h"
+
+#include <cstdint>
+#include <vector>
+
+enum class NormalEncoding
+{
+    Float32,        // 3 x 32-bit float
+    Octahedral16,   // 2 x 16-bit snorm, see PackNormalOctahedral
+};
+
+// The GPU side of a Geometry<Vertex, uint32_t>, split by how often it changes.
+// The indices are static and uploaded once by Create. Positions and normals
+// are separate dynamic streams, each with its own dirty ranges, re-encoded
+// from the vertices and uploaded only over those ranges by Flush. Takes the
+// vertices as a VertexSource, so it also runs headless against a
+// CPUUploadBackend (see Tools/CheckVertexStreams.cpp).
+class VertexStreams
+{
+public:
+    enum Stream
+    {
+        Positions,
+        Normals,
+        NumDynamicStreams
+    };
+
+    void Create(UploadBackend& backend, const VertexSource& vertices, uint32_t numVertices, const std::vector<uint32_t>& indices, NormalEncoding normalEncoding);
+
+    void MarkDirty(Stream stream, const std::vector<VertexRange>& ranges);
+    void MarkDirty(Stream stream);
+
+    void Flush(UploadBackend& backend, const VertexSource& vertices);
+
+    UploadBackend::BufferId GetBuffer(Stream stream) const { return buffers[stream]; }
+    UploadBackend::BufferId GetIndexBuffer() const { return indexBuffer; }
+    NormalEncoding GetNormalEncoding() const { return normalEncoding; }
+
+    // bytes per vertex
+    size_t GetStride(Stream stream) const;
+
+private:
+    void Encode(Stream stream, const VertexSource& vertices, VertexRange range);
+
+    uint32_t numVertices = 0;
+    NormalEncoding normalEncoding = NormalEncoding::Float32;
+
+    UploadBackend::BufferId indexBuffer = 0;
+    UploadBackend::BufferId buffers[NumDynamicStreams] = {};
+    std::vector<VertexRange> dirtyRanges[NumDynamicStreams];
+
+    // encoded streams, the source of the uploads: float3s, or packed normals
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<uint32_t> packedNormals;
+};
@@ -0,0 +1,50 @@
+//
+//  CacheFile.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+// Replaces path with what write(std::ofstream&) puts out. The file is written
+// next to the target under a per-process name and renamed over it, so a crash
+// or a concurrent writer never leaves a reader half a file. false with the
+// reason in error if anything failed, path is left as it was then.
+template<typename Write>
+bool WriteCacheFile(const std::string& path, std::string& error, const Write& write)
+{
+	const std::string tmpPath = path + ".tmp" + std::to_string(getpid());
+	{
+		std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!f.is_open())
+		{
+			error = "Failed to create " + tmpPath;
+			return false;
+		}
+
+		write(f);
+		f.close();
+		if (!f)
+		{
+			error = "Failed to write " + tmpPath;
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+	}
+
+	if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		error = "Failed to write " + path;
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
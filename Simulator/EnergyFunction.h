@@ -17,422 +17,355 @@ inline Vec9 Flatten(const Mat3& mat);
 
 const double sqrt2Inv = 1.0 / std::sqrt(2.0);
 
+// singular value pairs of the twist and flip modes
+constexpr int modePairs[3][2] = { { 0, 1 }, { 1, 2 }, { 0, 2 } };
 
-class EnergyFunction
-{
-protected:
-	double E, nu, lambda, mu;
-	Mat3 F;
-public:
-	EnergyFunction(double E = 1.0e6, double nu = 0.4)
-		: E{ E }, nu{ nu }
-	{
-		lambda = nu * E / ((1.0 + nu) * (1.0 - 2.0 * nu)); // from vega fem homogeneousNeoHookeanIsotropicMaterial.cpp
-		mu = E / (2.0 * (1.0 + nu));
-	}
-
-	virtual Mat3 GetPK1(const Mat3& F) = 0;
-
-	virtual Mat9 GetJacobian() = 0;
-};
-
-class Dirichlet : public EnergyFunction
+// F = U diag(Sigma) V^T with det(U) = det(V) = 1; for inverted elements the
+// reflection ends up as a negative smallest singular value
+inline void RotationVariantSVD(const Mat3& F, Mat3& U, Vec3& Sigma, Mat3& V)
 {
-public:
-	Dirichlet(double E = 1.0e6, double nu = 0.4) : EnergyFunction{ E, nu } {};
+	using namespace Eigen;
+	JacobiSVD<Mat3, NoQRPreconditioner> SVD(F, ComputeFullU | ComputeFullV);
+	U = SVD.matrixU();
+	V = SVD.matrixV();
+	Sigma = SVD.singularValues();
 
-	virtual Mat3 GetPK1(const Mat3& F) override
+	if (U.determinant() < 0.0)
 	{
-		return 2.0 * F;
+		U.col(2) *= -1.0;
+		Sigma(2) *= -1.0;
 	}
-
-	virtual Mat9 GetJacobian() override
+	if (V.determinant() < 0.0)
 	{
-		return 2.0 * Mat9::Identity();
+		V.col(2) *= -1.0;
+		Sigma(2) *= -1.0;
 	}
-};
+}
 
-class StVK : public EnergyFunction
+// Eigensystem of dP/dF for an isotropic energy (Smith et al., "Analytic
+// Eigensystems for Isotropic Distortion Energies", 2019). The nine modes are
+// three scaling modes (eigenvectors of d2Psi/dSigma2, stored as coefficients
+// of U e_i e_i^T V^T), three twists and three flips, one per modePairs entry.
+struct Eigensystem
 {
-public:
-	StVK(double E = 1.0e6, double nu = 0.4) : EnergyFunction{ E, nu } {};
-
-	virtual Mat3 GetPK1(const Mat3& F) override
-	{
-		this->F = F;
+	Mat3 U, V;
+	Vec3 Sigma;
 
-		Mat3 E = 0.5 * (F.transpose() * F - Mat3::Identity());
-		Mat3 P = mu * F * E + lambda * E.trace() * F;
+	Vec3 scaling;
+	Mat3 scalingModes;
+	double twist[3];
+	double flip[3];
 
-		return P;
+	// mode 0-2: scaling, 3-5: twist, 6-8: flip
+	double Eigenvalue(int mode) const
+	{
+		if (mode < 3)
+			return scaling(mode);
+		if (mode < 6)
+			return twist[mode - 3];
+		return flip[mode - 6];
 	}
 
-	virtual Mat9 GetJacobian() override 
-	{ 
-		//SVD, polar decomposition
-		using namespace Eigen;
-		Vec3 Sigma;
-		Mat3 U, V, SigMat, S;
+	Vec9 Eigenvector(int mode) const
+	{
+		Mat3 Q;
+		if (mode < 3)
 		{
-
-			JacobiSVD<Mat3> SVD(F, ComputeFullU | ComputeFullV);
-			Sigma = SVD.singularValues();
-			Mat3 U = SVD.matrixU();
-			Mat3 V = SVD.matrixV();
-
-			Mat3 L = Mat3::Identity();
-			L(2, 2) = (U * V.transpose()).determinant();
-		
-			if (U.determinant() < 0.0 && V.determinant() > 0.0)
-				U = U * L;
-
-			if (U.determinant() > 0.0 && V.determinant() < 0.0)
-				V = V * L;
-
-			Mat3 SigMat = Mat3::Zero();
-			for (int i = 0; i < 3; ++i)
-				SigMat(i, i) = Sigma(i);
-			
-			S = V * SigMat * V.transpose();
+			Q = U * scalingModes.col(mode).asDiagonal() * V.transpose();
 		}
-
-		// invariants
-		double I1 = S.trace();
-		double I2 = (F * F.transpose()).trace();
-		double I3 = F.determinant();
-
-		double eigenVal[9];
-		// probing a 3x3 matrix to get lambda_{0,1,2}
+		else
 		{
-
-			Mat3 A;
-			for (int i = 0; i < 3; ++i) {
-				for (int j = 0; j < 3; ++j) {
-					A(i, j) = lambda * Sigma(i) * Sigma(j);
-				}
-			}
-			for (int i = 0; i < 3; ++i) {
-				A(i,i) = -mu + (lambda / 2) * (I2 - 3.0) + (lambda + 3.0 * mu) * Sigma(i) * Sigma(i);
-			}
-
-			Vector3cd lambdaMat = A.eigenvalues();
-			for (int i = 0; i < 3; ++i)
-				eigenVal[i] = lambdaMat(i).real();
-
+			const int pair = (mode - 3) % 3;
+			const int j = modePairs[pair][0];
+			const int k = modePairs[pair][1];
+			const double sign = mode < 6 ? -1.0 : 1.0;
+			Q = sqrt2Inv * (U.col(j) * V.col(k).transpose() + sign * U.col(k) * V.col(j).transpose());
 		}
+		return Flatten(Q);
+	}
 
-		// other eigenvals
+	// projects dP/dF onto the positive semidefinite cone
+	void ClampToPSD()
+	{
+		scaling = scaling.cwiseMax(0.0);
+		for (int p = 0; p < 3; ++p)
 		{
-			eigenVal[3] = -mu + (lambda / 2) * (I2 - 3.0) + mu * ( Sigma(1)*Sigma(1) + Sigma(2)*Sigma(2) - Sigma(1)*Sigma(2) );
-			eigenVal[4] = -mu + (lambda / 2) * (I2 - 3.0) + mu * ( Sigma(0)*Sigma(0) + Sigma(2)*Sigma(2) - Sigma(0)*Sigma(2) );
-			eigenVal[5] = -mu + (lambda / 2) * (I2 - 3.0) + mu * ( Sigma(0)*Sigma(0) + Sigma(1)*Sigma(1) - Sigma(0)*Sigma(1) );
-			eigenVal[6] = -mu + (lambda / 2) * (I2 - 3.0) + mu * ( Sigma(1)*Sigma(1) + Sigma(2)*Sigma(2) + Sigma(1)*Sigma(2) );
-			eigenVal[7] = -mu + (lambda / 2) * (I2 - 3.0) + mu * ( Sigma(0)*Sigma(0) + Sigma(2)*Sigma(2) + Sigma(0)*Sigma(2) );
-			eigenVal[8] = -mu + (lambda / 2) * (I2 - 3.0) + mu * ( Sigma(0)*Sigma(0) + Sigma(1)*Sigma(1) + Sigma(0)*Sigma(1) );
-		}
-
-		// BC projection
-		for (int i = 0; i < 9; ++i) {
-			if (eigenVal[i] < 0.0) {
-				//eigenVal[i] = 0.0;
-			}
+			twist[p] = std::max(twist[p], 0.0);
+			flip[p] = std::max(flip[p], 0.0);
 		}
+	}
 
-		Vec9 Q[9];
-		// Q_{0,1,2}
+	Mat9 Assemble() const
+	{
+		Mat9 H = Mat9::Zero();
+		for (int mode = 0; mode < 9; ++mode)
 		{
-			Mat3 D[3];
-			for (int i = 0; i < 3; ++i) {
-				Mat3 S = Mat3::Zero();
-				S(i, i) = 1.0;
-				D[i] = U * S * V.transpose();
-			}
-
-
-			//scaling modes
-			Mat3 Q123[3];
-			for (int i = 0; i < 3; ++i) {
-				Q123[i].setZero();
-			}
-
-			for (int s = 0; s < 3; ++s)
-			{
-				double z[3];
-				z[0] = Sigma(0) * Sigma(2) + Sigma(1) * eigenVal[s];
-				z[1] = Sigma(1) * Sigma(2) + Sigma(0) * eigenVal[s];
-				z[2] = eigenVal[s] * eigenVal[s] - Sigma(2) * Sigma(2);
-
-				for (int i = 0; i < 3; ++i) {
-					Q123[s] += z[i] * D[i];
-				}
-			}
-
-			for (int i = 0; i < 3; ++i) {
-				Q[i] = Flatten(Q123[i]);
-			}
+			const double value = Eigenvalue(mode);
+			if (value == 0.0)
+				continue;
+
+			const Vec9 q = Eigenvector(mode);
+			H.noalias() += value * q * q.transpose();
 		}
+		return H;
+	}
 
-		// Q_{3...8}
+	// B^T dP/dF B in factored form, skipping modes that were clamped to zero;
+	// B is typically dF/dx
+	template<int N>
+	Eigen::Matrix<double, N, N> Sandwich(const Eigen::Matrix<double, 9, N>& B) const
+	{
+		Eigen::Matrix<double, N, N> H = Eigen::Matrix<double, N, N>::Zero();
+		for (int mode = 0; mode < 9; ++mode)
 		{
-			Mat3 T[6];
-			for (int i = 0; i < 6; ++i) {
-				T[i].setZero();
-			}
+			const double value = Eigenvalue(mode);
+			if (value == 0.0)
+				continue;
 
-			T[0](0, 1) = -1.0;
-			T[0](1, 0) = 1.0;
-
-			T[1](1, 2) = 1.0;
-			T[1](2, 1) = -1.0;
+			const Eigen::Matrix<double, N, 1> b = B.transpose() * Eigenvector(mode);
+			H.noalias() += value * b * b.transpose();
+		}
+		return H;
+	}
+};
 
-			T[2](0, 2) = 1.0;
-			T[2](2, 0) = -1.0;
+// Isotropic energies written as Psi(I1, I2, I3), with I1 = tr(S) (S being the
+// stretch of the polar decomposition), I2 = ||F||^2 and I3 = det(F). Derived
+// classes only provide Psi and its invariant derivatives; P and the
+// eigensystem of dP/dF follow in closed form.
+class EnergyFunction
+{
+protected:
+	double E, nu, lambda, mu;
+	Mat3 F;
+	Eigensystem eigensystem;
+public:
+	EnergyFunction(double E = 1.0e6, double nu = 0.4)
+		: E{ E }, nu{ nu }
+	{
+		lambda = nu * E / ((1.0 + nu) * (1.0 - 2.0 * nu)); // from vega fem homogeneousNeoHookeanIsotropicMaterial.cpp
+		mu = E / (2.0 * (1.0 + nu));
+	}
+	virtual ~EnergyFunction() = default;
 
-			T[3](0, 1) = 1.0;
-			T[3](1, 0) = 1.0;
+	virtual double	GetEnergy(const Vec3& I) const = 0;
+	virtual Vec3	GetEnergyGradient(const Vec3& I) const = 0;
+	virtual Mat3	GetEnergyHessian(const Vec3& I) const = 0;
 
-			T[4](1, 2) = 1.0;
-			T[4](2, 1) = 1.0;
+	// P at F = U diag(Sigma) V^T (rotation-variant SVD); if dPdF is given, it
+	// receives the unclamped eigensystem of dP/dF
+	Mat3 GetPK1(const Mat3& U, const Vec3& Sigma, const Mat3& V, Eigensystem* dPdF) const
+	{
+		const double s0 = Sigma(0);
+		const double s1 = Sigma(1);
+		const double s2 = Sigma(2);
 
-			T[5](0, 2) = 1.0;
-			T[5](2, 0) = 1.0;
+		const Vec3 I{ s0 + s1 + s2, Sigma.squaredNorm(), s0 * s1 * s2 };
+		const Vec3 dPsi = GetEnergyGradient(I);
 
+		// one row per invariant
+		Mat3 dIdSigma;
+		dIdSigma <<
+			1.0,		1.0,		1.0,
+			2.0 * s0,	2.0 * s1,	2.0 * s2,
+			s1 * s2,	s0 * s2,	s0 * s1;
 
-			for (int i = 0; i < 6; ++i) {
-				Q[i + 3] = Flatten(sqrt2Inv * U * T[i] * V.transpose());
-			}
+		const Vec3 dPsidSigma = dIdSigma.transpose() * dPsi;
+		const Mat3 P = U * dPsidSigma.asDiagonal() * V.transpose();
 
+		if (!dPdF)
+			return P;
 
-		}
+		dPdF->U = U;
+		dPdF->V = V;
+		dPdF->Sigma = Sigma;
 
-		Mat9 H = Mat9::Zero();
-		for (int i = 0; i < 9; ++i) {
-			H += eigenVal[i] * Q[i] * Q[i].transpose();
+		// scaling modes: d2Psi/dSigma2
+		{
+			Mat3 A = dIdSigma.transpose() * GetEnergyHessian(I) * dIdSigma;
+			A.diagonal().array() += 2.0 * dPsi(1);
+			A(0, 1) += dPsi(2) * s2;
+			A(1, 0) += dPsi(2) * s2;
+			A(0, 2) += dPsi(2) * s1;
+			A(2, 0) += dPsi(2) * s1;
+			A(1, 2) += dPsi(2) * s0;
+			A(2, 1) += dPsi(2) * s0;
+
+			Eigen::SelfAdjointEigenSolver<Mat3> eigenSolver;
+			eigenSolver.computeDirect(A);
+			dPdF->scaling = eigenSolver.eigenvalues();
+			dPdF->scalingModes = eigenSolver.eigenvectors();
 		}
 
-		return H;
-	};
-};
+		// twists and flips: d2R/dF2 only acts on twists, d2I3/dF2 on both
+		for (int p = 0; p < 3; ++p)
+		{
+			const int j = modePairs[p][0];
+			const int k = modePairs[p][1];
+			const double si = Sigma(3 - j - k);
 
-class NeoHookean : public EnergyFunction
-{
+			double sum = Sigma(j) + Sigma(k);
+			if (std::abs(sum) < 1.e-8)
+				sum = sum < 0.0 ? -1.e-8 : 1.e-8;
 
-	Vec3 f0, f1, f2;
-	Mat3 dJdF;
-	double J;
+			dPdF->twist[p] = 2.0 * dPsi(0) / sum + 2.0 * dPsi(1) + dPsi(2) * si;
+			dPdF->flip[p] = 2.0 * dPsi(1) - dPsi(2) * si;
+		}
 
-public:
-	NeoHookean(double E = 1.0e6, double nu = 0.4) : EnergyFunction{ E, nu } {};
+		return P;
+	}
 
-	virtual Mat3 GetPK1(const Mat3& F) override
+	Mat3 GetPK1(const Mat3& F)
 	{
 		this->F = F;
-		J = F.determinant();
 
-		f0 << F(0, 0), F(0, 1), F(0, 2);
-		f1 << F(1, 0), F(1, 1), F(1, 2);
-		f2 << F(2, 0), F(2, 1), F(2, 2);
+		Mat3 U, V;
+		Vec3 Sigma;
+		RotationVariantSVD(F, U, Sigma, V);
 
-		Vec3 dJdF_0 = f1.cross(f2);
-		Vec3 dJdF_1 = f2.cross(f0);
-		Vec3 dJdF_2 = f0.cross(f1);
+		return GetPK1(U, Sigma, V, &eigensystem);
+	}
 
-		dJdF <<
-			dJdF_0(0), dJdF_1(0), dJdF_2(0),
-			dJdF_0(1), dJdF_1(1), dJdF_2(1),
-			dJdF_0(2), dJdF_1(2), dJdF_2(2);
+	// PSD-projected dP/dF at the F of the last GetPK1 call
+	Mat9 GetJacobian()
+	{
+		Eigensystem clamped = eigensystem;
+		clamped.ClampToPSD();
+		return clamped.Assemble();
+	}
+};
 
-		Mat3 P = mu * (F - 1.0 / J * dJdF) + ((lambda * std::log(J)) / J) * dJdF;
+class Dirichlet : public EnergyFunction
+{
+public:
+	Dirichlet(double E = 1.0e6, double nu = 0.4) : EnergyFunction{ E, nu } {};
 
-		return P;
+	// Psi = ||F||^2
+	virtual double GetEnergy(const Vec3& I) const override
+	{
+		return I(1);
 	}
-	virtual Mat9 GetJacobian() override
+
+	virtual Vec3 GetEnergyGradient(const Vec3&) const override
 	{
-		Vec9 gJ = Flatten(dJdF);
+		return Vec3{ 0.0, 1.0, 0.0 };
+	}
 
-		Mat9 gJgJT = gJ * gJ.transpose();
+	virtual Mat3 GetEnergyHessian(const Vec3&) const override
+	{
+		return Mat3::Zero();
+	}
+};
 
-		Mat3 f0Hat, f1Hat, f2Hat;
-		f0Hat <<
-			0.0, -f0(2), f0(1),
-			f0(2), 0.0, -f0(0),
-			-f0(1), f0(0), 0.0;
+class StVK : public EnergyFunction
+{
+public:
+	StVK(double E = 1.0e6, double nu = 0.4) : EnergyFunction{ E, nu } {};
 
-		f1Hat <<
-			0.0, -f1(2), f1(1),
-			f1(2), 0.0, -f1(0),
-			-f1(1), f1(0), 0.0;
+	// Psi = mu ||E||^2 + lambda / 2 tr(E)^2, E = (F^T F - I) / 2, using
+	// ||F^T F||^2 = sum(sigma^4) = I2^2 - (I1^2 - I2)^2 / 2 + 4 I1 I3
+	virtual double GetEnergy(const Vec3& I) const override
+	{
+		const double q = I(0) * I(0) - I(1);
+		const double sumSigma4 = I(1) * I(1) - 0.5 * q * q + 4.0 * I(0) * I(2);
+		return 0.25 * mu * (sumSigma4 - 2.0 * I(1) + 3.0) + 0.125 * lambda * (I(1) - 3.0) * (I(1) - 3.0);
+	}
 
-		f2Hat <<
-			0.0, -f2(2), f2(1),
-			f2(2), 0.0, -f2(0),
-			-f2(1), f2(0), 0.0;
+	virtual Vec3 GetEnergyGradient(const Vec3& I) const override
+	{
+		const double q = I(0) * I(0) - I(1);
+		return Vec3{
+			0.25 * mu * (-2.0 * I(0) * q + 4.0 * I(2)),
+			0.25 * mu * (2.0 * I(1) + q - 2.0) + 0.25 * lambda * (I(1) - 3.0),
+			mu * I(0)
+		};
+	}
 
-		Mat9 HJ;
-		HJ <<
-			0.0, 0.0, 0.0, -f2Hat(0, 0), -f2Hat(0, 1), -f2Hat(0, 2), f1Hat(0, 0), f1Hat(0, 1), f1Hat(0, 2),
-			0.0, 0.0, 0.0, -f2Hat(1, 0), -f2Hat(1, 1), -f2Hat(1, 2), f1Hat(1, 0), f1Hat(1, 1), f1Hat(1, 2),
-			0.0, 0.0, 0.0, -f2Hat(2, 0), -f2Hat(2, 1), -f2Hat(2, 2), f1Hat(2, 0), f1Hat(2, 1), f1Hat(2, 2),
+	virtual Mat3 GetEnergyHessian(const Vec3& I) const override
+	{
+		const double q = I(0) * I(0) - I(1);
+		Mat3 H;
+		H <<
+			-2.0 * q - 4.0 * I(0) * I(0),	2.0 * I(0),	4.0,
+			2.0 * I(0),						1.0,		0.0,
+			4.0,							0.0,		0.0;
+		H *= 0.25 * mu;
+		H(1, 1) += 0.25 * lambda;
+		return H;
+	}
+};
 
-			f2Hat(0, 0), f2Hat(0, 1), f2Hat(0, 2), 0.0, 0.0, 0.0, -f0Hat(0, 0), -f0Hat(0, 1), -f0Hat(0, 2),
-			f2Hat(1, 0), f2Hat(1, 1), f2Hat(1, 2), 0.0, 0.0, 0.0, -f0Hat(1, 0), -f0Hat(1, 1), -f0Hat(1, 2),
-			f2Hat(2, 0), f2Hat(2, 1), f2Hat(2, 2), 0.0, 0.0, 0.0, -f0Hat(2, 0), -f0Hat(2, 1), -f0Hat(2, 2),
+class NeoHookean : public EnergyFunction
+{
+public:
+	NeoHookean(double E = 1.0e6, double nu = 0.4) : EnergyFunction{ E, nu } {};
 
-			-f1Hat(0, 0), -f1Hat(0, 1), -f1Hat(0, 2), f0Hat(0, 0), f0Hat(0, 1), f0Hat(0, 2), 0.0, 0.0, 0.0,
-			-f1Hat(1, 0), -f1Hat(1, 1), -f1Hat(1, 2), f0Hat(1, 0), f0Hat(1, 1), f0Hat(1, 2), 0.0, 0.0, 0.0,
-			-f1Hat(2, 0), -f1Hat(2, 1), -f1Hat(2, 2), f0Hat(2, 0), f0Hat(2, 1), f0Hat(2, 2), 0.0, 0.0, 0.0;
+	// Psi = mu / 2 (I2 - 3) - mu log(J) + lambda / 2 log(J)^2
+	virtual double GetEnergy(const Vec3& I) const override
+	{
+		const double logJ = std::log(I(2));
+		return 0.5 * mu * (I(1) - 3.0) - mu * logJ + 0.5 * lambda * logJ * logJ;
+	}
 
-		return
-			mu * Mat9::Identity() +
-			((mu + lambda * (1.0 - std::log(J))) / (J * J)) * gJgJT +
-			((lambda * std::log(J) - mu) / J) * HJ;
+	virtual Vec3 GetEnergyGradient(const Vec3& I) const override
+	{
+		const double J = I(2);
+		return Vec3{ 0.0, 0.5 * mu, (lambda * std::log(J) - mu) / J };
+	}
 
+	virtual Mat3 GetEnergyHessian(const Vec3& I) const override
+	{
+		const double J = I(2);
+		Mat3 H = Mat3::Zero();
+		H(2, 2) = (mu + lambda * (1.0 - std::log(J))) / (J * J);
+		return H;
 	}
 };
 
 class StableNeoHookean : public EnergyFunction
 {
-
-	Vec3 f0, f1, f2;
-	Mat3 dJdF;
-	double J;
-
 public:
 	StableNeoHookean(double E = 1.0e6, double nu = 0.4) : EnergyFunction{ E, nu } {};
 
-	virtual Mat3 GetPK1(const Mat3& F) override
+	// Psi = mu / 2 (I2 - 3) + lambda / 2 (J - 1)^2 - mu (J - 1)
+	virtual double GetEnergy(const Vec3& I) const override
 	{
-		this->F = F;
-		J = F.determinant();
-
-		f0 << F(0, 0), F(0, 1), F(0, 2);
-		f1 << F(1, 0), F(1, 1), F(1, 2);
-		f2 << F(2, 0), F(2, 1), F(2, 2);
-
-		Vec3 dJdF_0 = f1.cross(f2);
-		Vec3 dJdF_1 = f2.cross(f0);
-		Vec3 dJdF_2 = f0.cross(f1);
-
-		dJdF <<
-			dJdF_0(0), dJdF_1(0), dJdF_2(0),
-			dJdF_0(1), dJdF_1(1), dJdF_2(1),
-			dJdF_0(2), dJdF_1(2), dJdF_2(2);
-
-		Mat3 P = (mu / 2) * 2.0 * F + (lambda * (J - 1.0) - mu) * dJdF;
-		//Mat3 P = mu * (F - 1.0 / J * dJdF) + ((lambda * std::log(J)) / J) * dJdF;
-
-		return P;
+		const double J = I(2);
+		return 0.5 * mu * (I(1) - 3.0) + 0.5 * lambda * (J - 1.0) * (J - 1.0) - mu * (J - 1.0);
 	}
-	virtual Mat9 GetJacobian() override
-	{
-
-		Vec9 gJ = Flatten(dJdF);
-		Mat9 gJgJT = gJ * gJ.transpose();
 
-		Mat9 H2 = 2.0 * Mat9::Identity();
-
-		Mat3 f0Hat, f1Hat, f2Hat;
-		f0Hat <<
-			0.0, -f0(2), f0(1),
-			f0(2), 0.0, -f0(0),
-			-f0(1), f0(0), 0.0;
-
-		f1Hat <<
-			0.0, -f1(2), f1(1),
-			f1(2), 0.0, -f1(0),
-			-f1(1), f1(0), 0.0;
-
-		f2Hat <<
-			0.0, -f2(2), f2(1),
-			f2(2), 0.0, -f2(0),
-			-f2(1), f2(0), 0.0;
-
-		Mat9 HJ;
-		HJ <<
-			0.0, 0.0, 0.0, -f2Hat(0, 0), -f2Hat(0, 1), -f2Hat(0, 2), f1Hat(0, 0), f1Hat(0, 1), f1Hat(0, 2),
-			0.0, 0.0, 0.0, -f2Hat(1, 0), -f2Hat(1, 1), -f2Hat(1, 2), f1Hat(1, 0), f1Hat(1, 1), f1Hat(1, 2),
-			0.0, 0.0, 0.0, -f2Hat(2, 0), -f2Hat(2, 1), -f2Hat(2, 2), f1Hat(2, 0), f1Hat(2, 1), f1Hat(2, 2),
-
-			f2Hat(0, 0), f2Hat(0, 1), f2Hat(0, 2), 0.0, 0.0, 0.0, -f0Hat(0, 0), -f0Hat(0, 1), -f0Hat(0, 2),
-			f2Hat(1, 0), f2Hat(1, 1), f2Hat(1, 2), 0.0, 0.0, 0.0, -f0Hat(1, 0), -f0Hat(1, 1), -f0Hat(1, 2),
-			f2Hat(2, 0), f2Hat(2, 1), f2Hat(2, 2), 0.0, 0.0, 0.0, -f0Hat(2, 0), -f0Hat(2, 1), -f0Hat(2, 2),
-
-			-f1Hat(0, 0), -f1Hat(0, 1), -f1Hat(0, 2), f0Hat(0, 0), f0Hat(0, 1), f0Hat(0, 2), 0.0, 0.0, 0.0,
-			-f1Hat(1, 0), -f1Hat(1, 1), -f1Hat(1, 2), f0Hat(1, 0), f0Hat(1, 1), f0Hat(1, 2), 0.0, 0.0, 0.0,
-			-f1Hat(2, 0), -f1Hat(2, 1), -f1Hat(2, 2), f0Hat(2, 0), f0Hat(2, 1), f0Hat(2, 2), 0.0, 0.0, 0.0;
-
-		return
-			(mu / 2) * H2 +
-			lambda * gJgJT +
-			(lambda * (J - 1) - mu) * HJ;
+	virtual Vec3 GetEnergyGradient(const Vec3& I) const override
+	{
+		return Vec3{ 0.0, 0.5 * mu, lambda * (I(2) - 1.0) - mu };
+	}
 
+	virtual Mat3 GetEnergyHessian(const Vec3&) const override
+	{
+		Mat3 H = Mat3::Zero();
+		H(2, 2) = lambda;
+		return H;
 	}
 };
 
 class ARAP : public EnergyFunction
 {
-
-	Mat3 U, V, S, R;
-	Vec3 Sigma;
-
 public:
 	ARAP(double E = 1.0e6, double nu = 0.4) : EnergyFunction{ E, nu } {};
 
-	virtual Mat3 GetPK1(const Mat3& F) override
+	// Psi = mu / 2 ||F - R||^2 = mu / 2 (I2 - 2 I1 + 3)
+	virtual double GetEnergy(const Vec3& I) const override
 	{
-		this->F = F;
-		// P = mu(F - R);
-		using namespace Eigen;
-		JacobiSVD<Mat3> SVD(F, ComputeFullU | ComputeFullV);
-		Sigma = SVD.singularValues();
-		U = SVD.matrixU();
-		V = SVD.matrixV();
-
-		R = U * V.transpose();
-		return mu * (F - R);
+		return 0.5 * mu * (I(1) - 2.0 * I(0) + 3.0);
 	}
-	virtual Mat9 GetJacobian() override
-	{
-		double sq2inv = 1.0 / std::sqrt(2.0);
-
-		double eigenLambda[3];
-
-		eigenLambda[0] = 2.0 / (Sigma(0) + Sigma(1));
-		eigenLambda[1] = 2.0 / (Sigma(1) + Sigma(2));
-		eigenLambda[2] = 2.0 / (Sigma(0) + Sigma(2));
-
-		if (Sigma(0) + Sigma(1) < 2.0)
-			eigenLambda[0] = 1.0;
-
-		if (Sigma(1) + Sigma(2) < 2.0)
-			eigenLambda[1] = 1.0;
 
-		if (Sigma(0) + Sigma(2) < 2.0)
-			eigenLambda[2] = 1.0;
-
-		Vec9 Q[3];
-
-		Mat3 T1 = Mat3::Zero();
-		T1(0, 1) = -1.0;
-		T1(1, 0) = 1.0;
-		Q[0] = Flatten(sq2inv * U * T1 * V.transpose());
-
-		Mat3 T2 = Mat3::Zero();
-		T2(1, 2) = 1.0;
-		T2(2, 1) = -1.0;
-		Q[1] = Flatten(sq2inv * U * T2 * V.transpose());
-
-		Mat3 T3 = Mat3::Zero();
-		T3(0, 2) = 1.0;
-		T3(2, 0) = -1.0;
-		Q[2] = Flatten(sq2inv * U * T3 * V.transpose());
-
-		Mat9 H1 = Mat9::Identity();
-
-		for (int i = 0; i < 3; ++i)
-			H1 -= eigenLambda[i] * Q[i] * Q[i].transpose();
+	virtual Vec3 GetEnergyGradient(const Vec3&) const override
+	{
+		return Vec3{ -mu, 0.5 * mu, 0.0 };
+	}
 
-		return 2.0 * H1;
+	virtual Mat3 GetEnergyHessian(const Vec3&) const override
+	{
+		return Mat3::Zero();
 	}
 };
 
@@ -0,0 +1,48 @@
+//
+//  Hash.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// 64-bit content hash for cache keys. FNV-1a, but over 64-bit words (a byte
+// at a time would dominate a warm start): each word goes through murmur3's
+// finalizer first, since multiplying by the odd FNV prime alone never carries
+// a word's high bits down and e.g. flipped sign bits would cancel out.
+struct Hash
+{
+	uint64_t value = 14695981039346656037ull;
+
+	static uint64_t Mix(uint64_t word)
+	{
+		word ^= word >> 33;
+		word *= 0xFF51AFD7ED558CCDull;
+		word ^= word >> 33;
+		word *= 0xC4CEB9FE1A85EC53ull;
+		word ^= word >> 33;
+		return word;
+	}
+
+	void Add(const void* bytes, size_t size)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(bytes);
+		for (; size >= 8; p += 8, size -= 8)
+		{
+			uint64_t word;
+			memcpy(&word, p, 8);
+			value = (value ^ Mix(word)) * 1099511628211ull;
+		}
+		for (; size > 0; ++p, --size)
+			value = (value ^ *p) * 1099511628211ull;
+	}
+
+	template<class T>
+	void Add(const T& v) { Add(&v, sizeof(v)); }
+};
@@ -0,0 +1,93 @@
+//
+//  HexElement.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "EnergyFunction.h"
+
+using Mat24		= Eigen::Matrix<double, 24, 24>;
+using Mat9x24	= Eigen::Matrix<double, 9, 24>;
+using Mat3x8	= Eigen::Matrix<double, 3, 8>;
+using Mat8x3	= Eigen::Matrix<double, 8, 3>;
+
+using Vec24		= Eigen::Matrix<double, 24, 1>;
+
+// corner offsets in grid units, following vega's CUBIC vertex order (see cubicMesh.h)
+constexpr int hexCornerI[8] = { 0, 1, 1, 0, 0, 1, 1, 0 };
+constexpr int hexCornerJ[8] = { 0, 0, 1, 1, 0, 0, 1, 1 };
+constexpr int hexCornerK[8] = { 0, 0, 0, 0, 1, 1, 1, 1 };
+
+// Rest-shape derivatives of a trilinear 8-node hexahedron, shared by every
+// element of a CubicMesh. All voxels are axis-aligned and have the same
+// cubeSize, so the shape function gradients at the 2x2x2 Gauss points only
+// need to be computed once instead of storing a DmInv/dFdx per element.
+struct HexTemplate
+{
+	static constexpr int numCorners = 8;
+	static constexpr int numQuadraturePoints = 8;
+
+	double cubeSize;
+	double volume;
+	double quadratureWeight;
+
+	// dN_a/dX, one row per corner: F = X_el * dNdX
+	Mat8x3	dNdX[numQuadraturePoints];
+	Mat9x24	dFdx[numQuadraturePoints];
+
+	// gradients at the element center, used to pick one rotation per element
+	Mat8x3	dNdXCenter;
+
+	void Init(double size)
+	{
+		cubeSize = size;
+		volume = size * size * size;
+		quadratureWeight = volume / numQuadraturePoints;
+
+		const double g = 0.5 / std::sqrt(3.0);
+		const double gaussPoints[2] = { 0.5 - g, 0.5 + g };
+
+		for (int q = 0; q < numQuadraturePoints; ++q)
+		{
+			const double xi[3] = {
+				gaussPoints[hexCornerI[q]],
+				gaussPoints[hexCornerJ[q]],
+				gaussPoints[hexCornerK[q]]
+			};
+
+			for (int a = 0; a < numCorners; ++a)
+			{
+				const int offset[3] = { hexCornerI[a], hexCornerJ[a], hexCornerK[a] };
+
+				// N_a = prod_d (offset_d ? xi_d : 1 - xi_d)
+				double N[3], dN[3];
+				for (int d = 0; d < 3; ++d)
+				{
+					N[d]  = offset[d] ? xi[d] : 1.0 - xi[d];
+					dN[d] = offset[d] ? 1.0 : -1.0;
+				}
+
+				dNdX[q](a, 0) = dN[0] * N[1] * N[2] / size;
+				dNdX[q](a, 1) = N[0] * dN[1] * N[2] / size;
+				dNdX[q](a, 2) = N[0] * N[1] * dN[2] / size;
+			}
+
+			// Flatten() is column-major, so F(r, c) sits at 3 * c + r
+			dFdx[q].setZero();
+			for (int a = 0; a < numCorners; ++a)
+				for (int c = 0; c < 3; ++c)
+					for (int r = 0; r < 3; ++r)
+						dFdx[q](3 * c + r, 3 * a + r) = dNdX[q](a, c);
+		}
+
+		// trilinear gradients are affine in the other two coordinates, so the
+		// Gauss point average is exactly the value at the center
+		dNdXCenter.setZero();
+		for (int q = 0; q < numQuadraturePoints; ++q)
+			dNdXCenter += dNdX[q] / numQuadraturePoints;
+	}
+};
@@ -0,0 +1,460 @@
+//
+//  Kernels.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "Kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#define TARGET_AVX2		__attribute__((target("avx2,fma")))
+#define TARGET_AVX512	__attribute__((target("avx512f,avx512vl,avx2,fma")))
+#elif defined(__ARM_NEON)
+#define KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+	struct Table
+	{
+		void	(*spmv)(int, const int*, const int*, const double*, const double*, double*);
+		void	(*axpy)(int, double, const double*, double*);
+		void	(*xpay)(int, const double*, double, double*);
+		void	(*multiply)(int, const double*, const double*, double*);
+		double	(*dot)(int, const double*, const double*);
+		void	(*interpolate)(const double*, double*, int, int, const int*, const double*);
+	};
+
+	// scalar
+
+	void SpMVScalar(int numCols, const int* outer, const int* inner, const double* values, const double* x, double* y)
+	{
+		for (int j = 0; j < numCols; ++j)
+		{
+			double sum = 0.0;
+			for (int k = outer[j]; k < outer[j + 1]; ++k)
+				sum += values[k] * x[inner[k]];
+			y[j] = sum;
+		}
+	}
+
+	void AxpyScalar(int n, double a, const double* x, double* y)
+	{
+		for (int i = 0; i < n; ++i)
+			y[i] += a * x[i];
+	}
+
+	void XpayScalar(int n, const double* x, double a, double* y)
+	{
+		for (int i = 0; i < n; ++i)
+			y[i] = x[i] + a * y[i];
+	}
+
+	void MultiplyScalar(int n, const double* d, const double* r, double* z)
+	{
+		for (int i = 0; i < n; ++i)
+			z[i] = d[i] * r[i];
+	}
+
+	double DotScalar(int n, const double* x, const double* y)
+	{
+		double sum = 0.0;
+		for (int i = 0; i < n; ++i)
+			sum += x[i] * y[i];
+		return sum;
+	}
+
+	void InterpolateScalar(const double* u, double* uTarget, int numTargetLocations, int numElementVertices, const int* vertices, const double* weights)
+	{
+		for (int i = 0; i < numTargetLocations; ++i)
+		{
+			double defo[3] = { 0.0, 0.0, 0.0 };
+			for (int j = 0; j < numElementVertices; ++j)
+			{
+				const double* src = u + 3 * vertices[numElementVertices * i + j];
+				const double w = weights[numElementVertices * i + j];
+				defo[0] += w * src[0];
+				defo[1] += w * src[1];
+				defo[2] += w * src[2];
+			}
+			uTarget[3 * i + 0] = defo[0];
+			uTarget[3 * i + 1] = defo[1];
+			uTarget[3 * i + 2] = defo[2];
+		}
+	}
+
+	const Table scalarTable = { SpMVScalar, AxpyScalar, XpayScalar, MultiplyScalar, DotScalar, InterpolateScalar };
+
+#ifdef KERNELS_NEON
+
+	void SpMVNEON(int numCols, const int* outer, const int* inner, const double* values, const double* x, double* y)
+	{
+		for (int j = 0; j < numCols; ++j)
+		{
+			int k = outer[j];
+			const int end = outer[j + 1];
+
+			float64x2_t acc = vdupq_n_f64(0.0);
+			for (; k + 2 <= end; k += 2)
+			{
+				const float64x2_t xv = vcombine_f64(vld1_f64(x + inner[k]), vld1_f64(x + inner[k + 1]));
+				acc = vfmaq_f64(acc, vld1q_f64(values + k), xv);
+			}
+
+			double sum = vaddvq_f64(acc);
+			for (; k < end; ++k)
+				sum += values[k] * x[inner[k]];
+			y[j] = sum;
+		}
+	}
+
+	void AxpyNEON(int n, double a, const double* x, double* y)
+	{
+		int i = 0;
+		for (; i + 2 <= n; i += 2)
+			vst1q_f64(y + i, vfmaq_n_f64(vld1q_f64(y + i), vld1q_f64(x + i), a));
+		for (; i < n; ++i)
+			y[i] += a * x[i];
+	}
+
+	void XpayNEON(int n, const double* x, double a, double* y)
+	{
+		int i = 0;
+		for (; i + 2 <= n; i += 2)
+			vst1q_f64(y + i, vfmaq_n_f64(vld1q_f64(x + i), vld1q_f64(y + i), a));
+		for (; i < n; ++i)
+			y[i] = x[i] + a * y[i];
+	}
+
+	void MultiplyNEON(int n, const double* d, const double* r, double* z)
+	{
+		int i = 0;
+		for (; i + 2 <= n; i += 2)
+			vst1q_f64(z + i, vmulq_f64(vld1q_f64(d + i), vld1q_f64(r + i)));
+		for (; i < n; ++i)
+			z[i] = d[i] * r[i];
+	}
+
+	double DotNEON(int n, const double* x, const double* y)
+	{
+		float64x2_t acc0 = vdupq_n_f64(0.0);
+		float64x2_t acc1 = vdupq_n_f64(0.0);
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			acc0 = vfmaq_f64(acc0, vld1q_f64(x + i), vld1q_f64(y + i));
+			acc1 = vfmaq_f64(acc1, vld1q_f64(x + i + 2), vld1q_f64(y + i + 2));
+		}
+
+		double sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+		for (; i < n; ++i)
+			sum += x[i] * y[i];
+		return sum;
+	}
+
+	void InterpolateNEON(const double* u, double* uTarget, int numTargetLocations, int numElementVertices, const int* vertices, const double* weights)
+	{
+		for (int i = 0; i < numTargetLocations; ++i)
+		{
+			float64x2_t xy = vdupq_n_f64(0.0);
+			double z = 0.0;
+			for (int j = 0; j < numElementVertices; ++j)
+			{
+				const double* src = u + 3 * vertices[numElementVertices * i + j];
+				const double w = weights[numElementVertices * i + j];
+				xy = vfmaq_n_f64(xy, vld1q_f64(src), w);
+				z += w * src[2];
+			}
+			vst1q_f64(uTarget + 3 * i, xy);
+			uTarget[3 * i + 2] = z;
+		}
+	}
+
+	const Table neonTable = { SpMVNEON, AxpyNEON, XpayNEON, MultiplyNEON, DotNEON, InterpolateNEON };
+
+#endif
+
+#ifdef KERNELS_X86
+
+	TARGET_AVX2 inline double HorizontalSum(__m256d v)
+	{
+		__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+	}
+
+	// AVX2
+
+	TARGET_AVX2 void SpMVAVX2(int numCols, const int* outer, const int* inner, const double* values, const double* x, double* y)
+	{
+		for (int j = 0; j < numCols; ++j)
+		{
+			int k = outer[j];
+			const int end = outer[j + 1];
+
+			__m256d acc = _mm256_setzero_pd();
+			for (; k + 4 <= end; k += 4)
+			{
+				const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inner + k));
+				acc = _mm256_fmadd_pd(_mm256_loadu_pd(values + k), _mm256_i32gather_pd(x, index, 8), acc);
+			}
+
+			double sum = HorizontalSum(acc);
+			for (; k < end; ++k)
+				sum += values[k] * x[inner[k]];
+			y[j] = sum;
+		}
+	}
+
+	TARGET_AVX2 void AxpyAVX2(int n, double a, const double* x, double* y)
+	{
+		const __m256d av = _mm256_set1_pd(a);
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(y + i, _mm256_fmadd_pd(av, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		for (; i < n; ++i)
+			y[i] += a * x[i];
+	}
+
+	TARGET_AVX2 void XpayAVX2(int n, const double* x, double a, double* y)
+	{
+		const __m256d av = _mm256_set1_pd(a);
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(y + i, _mm256_fmadd_pd(av, _mm256_loadu_pd(y + i), _mm256_loadu_pd(x + i)));
+		for (; i < n; ++i)
+			y[i] = x[i] + a * y[i];
+	}
+
+	TARGET_AVX2 void MultiplyAVX2(int n, const double* d, const double* r, double* z)
+	{
+		int i = 0;
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(z + i, _mm256_mul_pd(_mm256_loadu_pd(d + i), _mm256_loadu_pd(r + i)));
+		for (; i < n; ++i)
+			z[i] = d[i] * r[i];
+	}
+
+	TARGET_AVX2 double DotAVX2(int n, const double* x, const double* y)
+	{
+		__m256d acc0 = _mm256_setzero_pd();
+		__m256d acc1 = _mm256_setzero_pd();
+		int i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), acc0);
+			acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), acc1);
+		}
+
+		double sum = HorizontalSum(_mm256_add_pd(acc0, acc1));
+		for (; i < n; ++i)
+			sum += x[i] * y[i];
+		return sum;
+	}
+
+	// one 3-vector per register, the fourth lane is masked off so the last
+	// vertex never reads past the end of u
+	TARGET_AVX2 void InterpolateAVX2(const double* u, double* uTarget, int numTargetLocations, int numElementVertices, const int* vertices, const double* weights)
+	{
+		const __m256i mask = _mm256_setr_epi64x(-1, -1, -1, 0);
+		for (int i = 0; i < numTargetLocations; ++i)
+		{
+			__m256d defo = _mm256_setzero_pd();
+			for (int j = 0; j < numElementVertices; ++j)
+			{
+				const double* src = u + 3 * vertices[numElementVertices * i + j];
+				const __m256d w = _mm256_set1_pd(weights[numElementVertices * i + j]);
+				defo = _mm256_fmadd_pd(w, _mm256_maskload_pd(src, mask), defo);
+			}
+			_mm256_maskstore_pd(uTarget + 3 * i, mask, defo);
+		}
+	}
+
+	const Table avx2Table = { SpMVAVX2, AxpyAVX2, XpayAVX2, MultiplyAVX2, DotAVX2, InterpolateAVX2 };
+
+	// AVX-512, tails are handled with masked loads and stores
+
+	TARGET_AVX512 inline __mmask8 TailMask(int count)
+	{
+		return static_cast<__mmask8>((1u << count) - 1u);
+	}
+
+	TARGET_AVX512 void SpMVAVX512(int numCols, const int* outer, const int* inner, const double* values, const double* x, double* y)
+	{
+		for (int j = 0; j < numCols; ++j)
+		{
+			int k = outer[j];
+			const int end = outer[j + 1];
+
+			__m512d acc = _mm512_setzero_pd();
+			for (; k + 8 <= end; k += 8)
+			{
+				const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inner + k));
+				acc = _mm512_fmadd_pd(_mm512_loadu_pd(values + k), _mm512_i32gather_pd(index, x, 8), acc);
+			}
+			if (k < end)
+			{
+				const __mmask8 m = TailMask(end - k);
+				const __m256i index = _mm256_maskz_loadu_epi32(m, inner + k);
+				const __m512d xv = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), m, index, x, 8);
+				acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, values + k), xv, acc);
+			}
+			y[j] = _mm512_reduce_add_pd(acc);
+		}
+	}
+
+	TARGET_AVX512 void AxpyAVX512(int n, double a, const double* x, double* y)
+	{
+		const __m512d av = _mm512_set1_pd(a);
+		for (int i = 0; i < n; i += 8)
+		{
+			const __mmask8 m = TailMask(n - i < 8 ? n - i : 8);
+			const __m512d yv = _mm512_fmadd_pd(av, _mm512_maskz_loadu_pd(m, x + i), _mm512_maskz_loadu_pd(m, y + i));
+			_mm512_mask_storeu_pd(y + i, m, yv);
+		}
+	}
+
+	TARGET_AVX512 void XpayAVX512(int n, const double* x, double a, double* y)
+	{
+		const __m512d av = _mm512_set1_pd(a);
+		for (int i = 0; i < n; i += 8)
+		{
+			const __mmask8 m = TailMask(n - i < 8 ? n - i : 8);
+			const __m512d yv = _mm512_fmadd_pd(av, _mm512_maskz_loadu_pd(m, y + i), _mm512_maskz_loadu_pd(m, x + i));
+			_mm512_mask_storeu_pd(y + i, m, yv);
+		}
+	}
+
+	TARGET_AVX512 void MultiplyAVX512(int n, const double* d, const double* r, double* z)
+	{
+		for (int i = 0; i < n; i += 8)
+		{
+			const __mmask8 m = TailMask(n - i < 8 ? n - i : 8);
+			_mm512_mask_storeu_pd(z + i, m, _mm512_mul_pd(_mm512_maskz_loadu_pd(m, d + i), _mm512_maskz_loadu_pd(m, r + i)));
+		}
+	}
+
+	TARGET_AVX512 double DotAVX512(int n, const double* x, const double* y)
+	{
+		__m512d acc = _mm512_setzero_pd();
+		for (int i = 0; i < n; i += 8)
+		{
+			const __mmask8 m = TailMask(n - i < 8 ? n - i : 8);
+			acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, x + i), _mm512_maskz_loadu_pd(m, y + i), acc);
+		}
+		return _mm512_reduce_add_pd(acc);
+	}
+
+	// 3-vectors don't fill more than 4 lanes, the AVX2 interpolation is reused
+	const Table avx512Table = { SpMVAVX512, AxpyAVX512, XpayAVX512, MultiplyAVX512, DotAVX512, InterpolateAVX2 };
+
+#endif
+
+	const Table* table = &scalarTable;
+	Kernels::ISA selected = Kernels::ISA::Scalar;
+}
+
+namespace Kernels
+{
+	bool IsSupported(ISA isa)
+	{
+		switch (isa)
+		{
+		case ISA::Scalar:
+			return true;
+#ifdef KERNELS_NEON
+		case ISA::NEON:
+			return true;
+#endif
+#ifdef KERNELS_X86
+		case ISA::AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		case ISA::AVX512:
+			__builtin_cpu_init();
+			return IsSupported(ISA::AVX2) && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl");
+#endif
+		default:
+			return false;
+		}
+	}
+
+	ISA Detect()
+	{
+		const ISA preferred[] = { ISA::AVX512, ISA::AVX2, ISA::NEON };
+		for (ISA isa : preferred)
+			if (IsSupported(isa))
+				return isa;
+		return ISA::Scalar;
+	}
+
+	const char* Name(ISA isa)
+	{
+		switch (isa)
+		{
+		case ISA::NEON:		return "NEON";
+		case ISA::AVX2:		return "AVX2";
+		case ISA::AVX512:	return "AVX-512";
+		case ISA::Scalar:
+		default:			return "scalar";
+		}
+	}
+
+	void Select(ISA isa)
+	{
+		if (!IsSupported(isa))
+			isa = ISA::Scalar;
+
+		switch (isa)
+		{
+#ifdef KERNELS_NEON
+		case ISA::NEON:		table = &neonTable;		break;
+#endif
+#ifdef KERNELS_X86
+		case ISA::AVX2:		table = &avx2Table;		break;
+		case ISA::AVX512:	table = &avx512Table;	break;
+#endif
+		default:			table = &scalarTable;	break;
+		}
+		selected = isa;
+	}
+
+	ISA Selected()
+	{
+		return selected;
+	}
+
+	void SpMV(int numCols, const int* outer, const int* inner, const double* values, const double* x, double* y)
+	{
+		table->spmv(numCols, outer, inner, values, x, y);
+	}
+
+	void Axpy(int n, double a, const double* x, double* y)
+	{
+		table->axpy(n, a, x, y);
+	}
+
+	void Xpay(int n, const double* x, double a, double* y)
+	{
+		table->xpay(n, x, a, y);
+	}
+
+	void Multiply(int n, const double* d, const double* r, double* z)
+	{
+		table->multiply(n, d, r, z);
+	}
+
+	double Dot(int n, const double* x, const double* y)
+	{
+		return table->dot(n, x, y);
+	}
+
+	void Interpolate(const double* u, double* uTarget, int numTargetLocations, int numElementVertices, const int* vertices, const double* weights)
+	{
+		table->interpolate(u, uTarget, numTargetLocations, numElementVertices, vertices, weights);
+	}
+}
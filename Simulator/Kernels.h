@@ -0,0 +1,41 @@
+//
+//  Kernels.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+// Hot loops of the solver and the surface interpolation, compiled once per
+// instruction set and picked at runtime. Eigen's own vectorization is fixed
+// at compile time, so these are written against raw arrays instead.
+namespace Kernels
+{
+	enum class ISA { Scalar, NEON, AVX2, AVX512 };
+
+	// best instruction set of the running CPU
+	ISA Detect();
+	bool IsSupported(ISA isa);
+	const char* Name(ISA isa);
+
+	// installs the variants of isa, which must be supported; Scalar until called
+	void Select(ISA isa);
+	ISA Selected();
+
+	// y = A x for a matrix in compressed row storage; also for a symmetric matrix in
+	// compressed column storage, which gives A^T x = A x
+	void SpMV(int numCols, const int* outer, const int* inner, const double* values, const double* x, double* y);
+
+	// y += a x
+	void Axpy(int n, double a, const double* x, double* y);
+	// y = x + a y
+	void Xpay(int n, const double* x, double a, double* y);
+	// z = d .* r
+	void Multiply(int n, const double* d, const double* r, double* z);
+	double Dot(int n, const double* x, const double* y);
+
+	// same as VolumetricMesh::interpolate
+	void Interpolate(const double* u, double* uTarget, int numTargetLocations, int numElementVertices, const int* vertices, const double* weights);
+}
@@ -0,0 +1,97 @@
+//
+//  LockFree.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Single-producer single-consumer ring buffer. TryPush/TryPop never block,
+// a full queue rejects the push.
+template<typename T, size_t Capacity>
+class SPSCQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+	bool TryPush(const T& value)
+	{
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) == Capacity)
+			return false;
+
+		slots[h & (Capacity - 1)] = value;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T& value)
+	{
+		const size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire))
+			return false;
+
+		value = slots[t & (Capacity - 1)];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T slots[Capacity];
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+};
+
+// Wait-free handoff of the latest value from one producer to one consumer.
+// The producer fills WriteBuffer() and publishes it, the consumer always
+// reads the most recently published one; neither side ever waits and no
+// buffer is touched by both at once.
+template<typename T>
+class TripleBuffer
+{
+public:
+	void Reset(const T& value)
+	{
+		for (T& buffer : buffers)
+			buffer = value;
+
+		writeIndex = 0;
+		middle.store(1, std::memory_order_relaxed);
+		readIndex = 2;
+	}
+
+	// producer side
+	T& WriteBuffer()
+	{
+		return buffers[writeIndex];
+	}
+
+	void Publish()
+	{
+		writeIndex = middle.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+	}
+
+	// consumer side; the reference stays valid until the next Read
+	const T& Read()
+	{
+		if (middle.load(std::memory_order_relaxed) & freshBit)
+			readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+
+		return buffers[readIndex];
+	}
+
+private:
+	static constexpr uint8_t indexMask = 3;
+	static constexpr uint8_t freshBit = 4;
+
+	T buffers[3];
+	uint8_t writeIndex = 0;
+	alignas(64) std::atomic<uint8_t> middle{ 1 };
+	alignas(64) uint8_t readIndex = 2;
+};
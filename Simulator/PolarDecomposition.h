@@ -0,0 +1,96 @@
+//
+//  PolarDecomposition.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "EnergyFunction.h"
+
+#include <Eigen/Geometry>
+
+// rotational part of F = R S via SVD, with reflections flipped onto the
+// smallest singular value so that det(R) = 1 even for inverted elements
+inline Mat3 PolarRotation(const Mat3& F)
+{
+	using namespace Eigen;
+	JacobiSVD<Mat3, NoQRPreconditioner> SVD(F, ComputeFullU | ComputeFullV);
+	Mat3 U = SVD.matrixU();
+	const Mat3 V = SVD.matrixV();
+
+	if ((U * V.transpose()).determinant() < 0.0)
+		U.col(2) *= -1.0;
+
+	return U * V.transpose();
+}
+
+// Mueller et al., "A Robust Method to Extract the Rotational Part of
+// Deformations", 2016, with the scalar step size replaced by the exact
+// Newton step (tr(G) I - G)^-1 whenever that system is well conditioned;
+// the plain Mueller step only removes ~2/3 of the error per iteration.
+// Starting from q (typically last frame's rotation), rotates q towards the
+// rotational part of F. returns true if the update fell below tolerance
+// within maxIterations
+inline bool RefineRotation(const Mat3& F, Eigen::Quaterniond& q, int maxIterations, double tolerance = 1.e-9)
+{
+	for (int iter = 0; iter < maxIterations; ++iter)
+	{
+		const Mat3 R = q.matrix();
+
+		const Vec3 torque =
+			R.col(0).cross(F.col(0)) +
+			R.col(1).cross(F.col(1)) +
+			R.col(2).cross(F.col(2));
+
+		// G = F R^T is symmetric at the solution, its eigenvalues are the singular values of F
+		const Mat3 G = F * R.transpose();
+		const Mat3 H = G.trace() * Mat3::Identity() - 0.5 * (G + G.transpose());
+		const double det = H.determinant();
+
+		Vec3 omega;
+		if (det > 1.e-6 * std::pow(std::abs(G.trace()), 3))
+			omega = H.inverse() * torque;
+		else
+			omega = torque / (std::abs(G.trace()) + 1.e-9);
+
+		const double w = omega.norm();
+		if (w > 0.0)
+		{
+			q = Eigen::Quaterniond(Eigen::AngleAxisd(w, omega / w)) * q;
+			q.normalize();
+		}
+
+		if (w < tolerance)
+			return true;
+	}
+	return false;
+}
+
+// F = U diag(Sigma) V^T with det(U) = det(V) = 1, reusing the rotation q of the previous step: after
+// refining q, R^T F is symmetric and only needs a closed-form 3x3 eigensolve.
+// returns false for inverted elements or when q did not converge, the caller
+// is expected to fall back to a full SVD and reseed q
+inline bool WarmStartedSVD(const Mat3& F, Eigen::Quaterniond& q, int maxIterations, Mat3& U, Vec3& Sigma, Mat3& V)
+{
+	if (F.determinant() <= 0.0)
+		return false;
+
+	if (!RefineRotation(F, q, maxIterations, 1.e-6))
+		return false;
+
+	const Mat3 R = q.matrix();
+	const Mat3 S = R.transpose() * F;
+
+	Eigen::SelfAdjointEigenSolver<Mat3> eigenSolver;
+	eigenSolver.computeDirect(0.5 * (S + S.transpose()));
+	Sigma = eigenSolver.eigenvalues();
+	V = eigenSolver.eigenvectors();
+	if (V.determinant() < 0.0)
+		V.col(2) *= -1.0;
+	U = R * V;
+
+	return true;
+}
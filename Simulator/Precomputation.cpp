@@ -0,0 +1,194 @@
+//
+//  Precomputation.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "Precomputation.h"
+#include "CacheFile.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	constexpr char magic[8] = { 'i', 'F', 'E', 'M', 'P', 'R', 'E', 'C' };
+	constexpr uint64_t alignment = 64;
+
+	uint64_t Align(uint64_t offset)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+}
+
+uint64_t Precomputation::ComputeKey(const SimulationMesh& mesh, const Config::Simulator& config)
+{
+	Hash hash;
+	hash.Add(version);
+
+	hash.Add(uint32_t(mesh.GetElementType()));
+	hash.Add(mesh.GetNumVertices());
+	hash.Add(mesh.GetNumElements());
+	hash.Add(mesh.GetCubeSize());
+	hash.Add(mesh.GetVertices(), 3 * sizeof(double) * mesh.GetNumVertices());
+	hash.Add(mesh.GetElements(), sizeof(int32_t) * mesh.GetNumElementVertices() * mesh.GetNumElements());
+
+	// the rest stiffnesses depend on E and nu, the masses on rho; the energy
+	// function is only evaluated per step
+	hash.Add(uint32_t(config.elementModel));
+	hash.Add(config.material.E);
+	hash.Add(config.material.nu);
+	hash.Add(config.material.rho);
+
+	return hash.value;
+}
+
+void Precomputation::Release()
+{
+	if (mapping)
+		munmap(mapping, mappingSize);
+	mapping = nullptr;
+	mappingSize = 0;
+
+	for (uint32_t s = 0; s < NumSections; ++s)
+	{
+		owned[s].reset();
+		data[s] = nullptr;
+		sizes[s] = 0;
+	}
+	key = 0;
+	structuredGrid = false;
+	gridRes[0] = gridRes[1] = gridRes[2] = 0;
+}
+
+void Precomputation::Reset(uint64_t newKey)
+{
+	Release();
+	key = newKey;
+}
+
+void* Precomputation::Allocate(Section s, size_t size)
+{
+	void* p = nullptr;
+	if (posix_memalign(&p, alignment, std::max<size_t>(size, 1)) != 0)
+		throw std::bad_alloc{};
+	memset(p, 0, size);
+
+	owned[s].reset(p);
+	data[s] = p;
+	sizes[s] = size;
+	return p;
+}
+
+void Precomputation::SetStructuredGrid(bool structured, const int res[3])
+{
+	structuredGrid = structured;
+	for (int d = 0; d < 3; ++d)
+		gridRes[d] = structured ? res[d] : 0;
+}
+
+bool Precomputation::Load(const std::string& path, uint64_t expectedKey, std::string& error)
+{
+	Release();
+
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		error = "Failed to open " + path;
+		return false;
+	}
+
+	// the key decides before anything is mapped
+	Header header;
+	struct stat st;
+	const bool current = fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header) &&
+		pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+		memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+		header.version == version && header.key == expectedKey;
+
+	void* mapped = MAP_FAILED;
+	if (current)
+		mapped = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (!current)
+	{
+		error = path + ": made for other inputs";
+		return false;
+	}
+	if (mapped == MAP_FAILED)
+	{
+		error = "Failed to map " + path;
+		return false;
+	}
+	mapping = mapped;
+	mappingSize = size_t(st.st_size);
+
+	for (uint32_t s = 0; s < NumSections; ++s)
+	{
+		const uint64_t offset = header.sections[s].offset;
+		const uint64_t size = header.sections[s].size;
+		if (size == 0)
+			continue;
+
+		if (offset % alignment != 0 || offset < sizeof(Header) || offset > mappingSize || size > mappingSize - offset)
+		{
+			error = path + ": truncated or corrupt";
+			Release();
+			return false;
+		}
+		data[s] = static_cast<const char*>(mapping) + offset;
+		sizes[s] = size;
+	}
+
+	key = header.key;
+	SetStructuredGrid(header.structuredGrid != 0, header.gridRes);
+	return true;
+}
+
+bool Precomputation::Save(const std::string& path, std::string& error) const
+{
+	Header header{};
+	memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.structuredGrid = structuredGrid;
+	header.key = key;
+	for (int d = 0; d < 3; ++d)
+		header.gridRes[d] = gridRes[d];
+
+	uint64_t offset = Align(sizeof(Header));
+	for (uint32_t s = 0; s < NumSections; ++s)
+	{
+		if (sizes[s] == 0)
+			continue;
+		header.sections[s].offset = offset;
+		header.sections[s].size = sizes[s];
+		offset = Align(offset + sizes[s]);
+	}
+
+	return WriteCacheFile(path, error, [&](std::ofstream& f)
+	{
+		const char padding[alignment] = {};
+		f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		uint64_t written = sizeof(header);
+		for (uint32_t s = 0; s < NumSections; ++s)
+		{
+			if (sizes[s] == 0)
+				continue;
+			f.write(padding, std::streamsize(header.sections[s].offset - written));
+			f.write(static_cast<const char*>(data[s]), std::streamsize(sizes[s]));
+			written = header.sections[s].offset + sizes[s];
+		}
+	});
+}
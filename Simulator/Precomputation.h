@@ -0,0 +1,105 @@
+//
+//  Precomputation.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "../State.h"
+#include "SimulationMesh.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+// What Solver::StartUp derives from the rest shape and the material before
+// the first step: the per-element rest-shape data, the lumped masses and the
+// sparsity pattern of Keff. Either built by the solver and owned, or
+// memory-mapped from the file an earlier run saved and used in place.
+//
+// The file is a Header followed by the sections at 64-byte aligned offsets.
+// It is only taken if its key matches, the key being a hash of the mesh and
+// of the Config::Simulator fields the sections depend on, so any change of
+// the inputs makes the solver build (and save) a new one.
+class Precomputation
+{
+public:
+	enum Section : uint32_t
+	{
+		TetVolumes,			// double per tet
+		DmInverses,			// Mat3 per tet
+		ShapeGradients,		// Mat9x12 dFdx per tet, nonlinear elements
+		RestStiffnesses,	// Mat12 per tet, corotational elements
+		Masses,				// lumped mass per DOF
+		ElementIndices,		// int32 DOF offset per element vertex, none on a structured grid
+		KeffOuter,			// int32 column starts of the compressed Keff, numDOFs + 1
+		KeffInner,			// int32 row indices of the compressed Keff
+		NumSections
+	};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t structuredGrid;
+		uint64_t key;
+		int32_t gridRes[3];
+		uint32_t reserved;
+		struct { uint64_t offset, size; } sections[NumSections];
+	};
+
+	static constexpr uint32_t version = 3;
+
+	Precomputation() = default;
+	~Precomputation() { Release(); }
+
+	Precomputation(const Precomputation&) = delete;
+	Precomputation& operator=(const Precomputation&) = delete;
+
+	// hash of the mesh, the element model and the material constants
+	static uint64_t ComputeKey(const SimulationMesh& mesh, const Config::Simulator& config);
+
+	// maps path if it was saved for key
+	bool Load(const std::string& path, uint64_t key, std::string& error);
+	bool Save(const std::string& path, std::string& error) const;
+
+	// starts an empty, owned set for key
+	void Reset(uint64_t key);
+	void Release();
+
+	bool IsMapped() const { return mapping != nullptr; }
+	uint64_t GetKey() const { return key; }
+
+	// owned sets only: count zeroed Ts for section s
+	template<class T>
+	T* Allocate(Section s, size_t count) { return static_cast<T*>(Allocate(s, count * sizeof(T))); }
+
+	template<class T>
+	const T* Get(Section s) const { return static_cast<const T*>(data[s]); }
+	template<class T>
+	size_t GetCount(Section s) const { return sizes[s] / sizeof(T); }
+
+	bool IsStructuredGrid() const { return structuredGrid; }
+	const int* GetGridRes() const { return gridRes; }
+	void SetStructuredGrid(bool structured, const int res[3]);
+
+private:
+	void* Allocate(Section s, size_t size);
+
+	uint64_t key = 0;
+	bool structuredGrid = false;
+	int gridRes[3] = { 0, 0, 0 };
+
+	const void* data[NumSections] = {};
+	uint64_t sizes[NumSections] = {};
+
+	// storage behind data: a read-only mapping, or one 64-byte aligned block per section
+	void* mapping = nullptr;
+	size_t mappingSize = 0;
+	struct Free { void operator()(void* p) const { free(p); } };
+	std::unique_ptr<void, Free> owned[NumSections];
+};
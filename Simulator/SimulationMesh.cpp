@@ -0,0 +1,256 @@
+//
+//  SimulationMesh.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "SimulationMesh.h"
+#include "CacheFile.h"
+
+#include "vega/volumetricMesh/volumetricMeshLoader.h"
+#include "vega/volumetricMesh/cubicMesh.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	constexpr char binaryMagic[8] = { 'i', 'F', 'E', 'M', 'M', 'E', 'S', 'H' };
+	constexpr uint64_t alignment = 64;
+
+	uint64_t Align(uint64_t offset)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	bool Stat(const std::string& path, uint64_t& size, int64_t& time)
+	{
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+			return false;
+		size = uint64_t(st.st_size);
+		time = int64_t(st.st_mtime);
+		return true;
+	}
+
+	// the header of a binary mesh file, if it is one
+	bool ReadHeader(const std::string& path, SimulationMesh::BinaryHeader& header)
+	{
+		std::ifstream f(path, std::ios::binary);
+		return f.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+			memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) == 0 &&
+			header.version == SimulationMesh::binaryVersion;
+	}
+}
+
+void SimulationMesh::Release()
+{
+	if (mapping)
+		munmap(mapping, mappingSize);
+	mapping = nullptr;
+	mappingSize = 0;
+
+	ownedVertices = {};
+	ownedElements = {};
+	vertices = nullptr;
+	elements = nullptr;
+	numVertices = numElements = numElementVertices = 0;
+	cubeSize = 0.0;
+}
+
+bool SimulationMesh::Load(const std::string& basePath, const std::string& cacheDirectory, std::string& error)
+{
+	const std::string asciiPath = basePath + ".veg";
+	const std::string name = basePath.substr(basePath.find_last_of('/') + 1);
+
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	const bool haveSource = Stat(asciiPath, sourceSize, sourceTime);
+
+	// shipped next to the .veg (or instead of it); the copy into the bundle
+	// doesn't keep the time, the size has to do
+	BinaryHeader header;
+	const std::string shippedPath = basePath + ".vegm";
+	if (ReadHeader(shippedPath, header) && (!haveSource || header.sourceSize == sourceSize) &&
+		LoadBinary(shippedPath, error))
+		return true;
+
+	const std::string cachedPath = cacheDirectory.empty() ? std::string{} : cacheDirectory + '/' + name + ".vegm";
+	if (!cachedPath.empty() && haveSource && ReadHeader(cachedPath, header) &&
+		header.sourceSize == sourceSize && header.sourceTime == sourceTime &&
+		LoadBinary(cachedPath, error))
+		return true;
+
+	if (!LoadASCII(asciiPath, error))
+		return false;
+
+	// a failed write only costs the fast path next time
+	std::string cacheError;
+	if (!cachedPath.empty())
+		SaveBinary(cachedPath, asciiPath, cacheError);
+	return true;
+}
+
+bool SimulationMesh::LoadBinary(const std::string& path, std::string& error)
+{
+	Release();
+
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		error = "Failed to open " + path;
+		return false;
+	}
+
+	struct stat st;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(BinaryHeader))
+		data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+	{
+		error = "Failed to map " + path;
+		return false;
+	}
+	mapping = data;
+	mappingSize = size_t(st.st_size);
+
+	const auto fail = [&](const char* message) {
+		error = path + ": " + message;
+		Release();
+		return false;
+	};
+
+	BinaryHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, binaryMagic, sizeof(binaryMagic)) != 0)
+		return fail("not a binary mesh");
+	if (header.version != binaryVersion)
+		return fail("unsupported version");
+
+	const uint32_t expectedElementVertices =
+		header.elementType == uint32_t(ElementType::Tet) ? 4 :
+		header.elementType == uint32_t(ElementType::Cubic) ? 8 : 0;
+	if (expectedElementVertices == 0 || header.numElementVertices != expectedElementVertices)
+		return fail("unknown element type");
+
+	if (header.numVertices > INT32_MAX || header.numElements > INT32_MAX / expectedElementVertices)
+		return fail("too many vertices or elements");
+
+	const uint64_t verticesSize = 3 * sizeof(double) * header.numVertices;
+	const uint64_t elementsSize = sizeof(int32_t) * header.numElementVertices * header.numElements;
+	// offset + size could wrap on a corrupt offset, so the sizes are compared against what is left
+	if (header.verticesOffset % alignment != 0 || header.elementsOffset % alignment != 0 ||
+		header.verticesOffset < sizeof(BinaryHeader) || header.elementsOffset < header.verticesOffset ||
+		header.elementsOffset - header.verticesOffset < verticesSize ||
+		header.elementsOffset > mappingSize || elementsSize > mappingSize - header.elementsOffset)
+		return fail("truncated or corrupt");
+
+	elementType = ElementType(header.elementType);
+	numVertices = uint32_t(header.numVertices);
+	numElements = uint32_t(header.numElements);
+	numElementVertices = header.numElementVertices;
+	cubeSize = header.cubeSize;
+
+	const char* bytes = static_cast<const char*>(mapping);
+	vertices = reinterpret_cast<const double*>(bytes + header.verticesOffset);
+	elements = reinterpret_cast<const int32_t*>(bytes + header.elementsOffset);
+
+	// one pass over the indices, far cheaper than trusting them
+	for (uint64_t i = 0; i < uint64_t(numElementVertices) * numElements; ++i)
+		if (elements[i] < 0 || uint32_t(elements[i]) >= numVertices)
+			return fail("element vertex out of range");
+
+	return true;
+}
+
+bool SimulationMesh::LoadASCII(const std::string& path, std::string& error)
+{
+	Release();
+
+	// vega reports parse errors by throwing
+	std::unique_ptr<VolumetricMesh> mesh;
+	try
+	{
+		mesh.reset(VolumetricMeshLoader::load(path.c_str()));
+	}
+	catch (...)
+	{
+	}
+	if (!mesh)
+	{
+		error = "Failed to load " + path;
+		return false;
+	}
+
+	switch (mesh->getElementType())
+	{
+	case VolumetricMesh::TET:
+		elementType = ElementType::Tet;
+		break;
+	case VolumetricMesh::CUBIC:
+		elementType = ElementType::Cubic;
+		cubeSize = static_cast<CubicMesh*>(mesh.get())->getCubeSize();
+		break;
+	default:
+		error = path + ": unknown element type";
+		return false;
+	}
+
+	numVertices = uint32_t(mesh->getNumVertices());
+	numElements = uint32_t(mesh->getNumElements());
+	numElementVertices = uint32_t(mesh->getNumElementVertices());
+
+	ownedVertices.resize(3 * size_t(numVertices));
+	for (uint32_t v = 0; v < numVertices; ++v)
+	{
+		const Vec3d& p = mesh->getVertex(v);
+		for (int d = 0; d < 3; ++d)
+			ownedVertices[3 * v + d] = p[d];
+	}
+
+	ownedElements.resize(size_t(numElementVertices) * numElements);
+	for (uint32_t e = 0; e < numElements; ++e)
+		for (uint32_t j = 0; j < numElementVertices; ++j)
+			ownedElements[numElementVertices * e + j] = mesh->getVertexIndex(e, j);
+
+	vertices = ownedVertices.data();
+	elements = ownedElements.data();
+	return true;
+}
+
+bool SimulationMesh::SaveBinary(const std::string& path, const std::string& sourcePath, std::string& error) const
+{
+	BinaryHeader header{};
+	memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+	header.version = binaryVersion;
+	header.elementType = uint32_t(elementType);
+	header.numElementVertices = numElementVertices;
+	header.numVertices = numVertices;
+	header.numElements = numElements;
+	header.cubeSize = cubeSize;
+	header.verticesOffset = Align(sizeof(BinaryHeader));
+	header.elementsOffset = Align(header.verticesOffset + 3 * sizeof(double) * numVertices);
+	if (!sourcePath.empty())
+		Stat(sourcePath, header.sourceSize, header.sourceTime);
+
+	return WriteCacheFile(path, error, [&](std::ofstream& f)
+	{
+		const char padding[alignment] = {};
+		f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		f.write(padding, std::streamsize(header.verticesOffset - sizeof(header)));
+		f.write(reinterpret_cast<const char*>(vertices), std::streamsize(3 * sizeof(double) * numVertices));
+		f.write(padding, std::streamsize(header.elementsOffset - header.verticesOffset - 3 * sizeof(double) * numVertices));
+		f.write(reinterpret_cast<const char*>(elements), std::streamsize(sizeof(int32_t) * numElementVertices * numElements));
+	});
+}
@@ -0,0 +1,97 @@
+//
+//  SimulationMesh.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include "vega/minivector/vec3d.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The volumetric mesh as the solver uses it: vertex positions and element
+// vertex indices. Either memory-mapped from a binary .vegm file and used in
+// place, or parsed from an ASCII .veg by vega and owned.
+//
+// Binary layout, little-endian: a BinaryHeader, then the vertices as
+// numVertices x 3 doubles and the elements as numElements x
+// numElementVertices int32s, both at 64-byte aligned offsets. Materials,
+// sets and regions are not stored; the solver takes its material from
+// Config. (vega's own binary format, .vegb, is read into heap arrays.)
+class SimulationMesh
+{
+public:
+	// same values as vega's VolumetricMesh::elementType
+	enum class ElementType : uint32_t { Tet = 1, Cubic = 2 };
+
+	struct BinaryHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t elementType;
+		uint32_t numElementVertices;
+		uint32_t reserved;
+		uint64_t numVertices, numElements;
+		double cubeSize;
+		uint64_t verticesOffset, elementsOffset;
+		// the .veg it was made from, to tell whether it is still current
+		uint64_t sourceSize;
+		int64_t sourceTime;
+	};
+
+	static constexpr uint32_t binaryVersion = 1;
+
+	SimulationMesh() = default;
+	~SimulationMesh() { Release(); }
+
+	SimulationMesh(const SimulationMesh&) = delete;
+	SimulationMesh& operator=(const SimulationMesh&) = delete;
+
+	// basePath without extension. Takes basePath.vegm if there is one,
+	// else cacheDirectory/<name>.vegm if it was made from the current
+	// basePath.veg, else parses basePath.veg, and then (cacheDirectory not
+	// empty) leaves the binary in the cache for the next time.
+	bool Load(const std::string& basePath, const std::string& cacheDirectory, std::string& error);
+
+	bool LoadBinary(const std::string& path, std::string& error);
+	bool LoadASCII(const std::string& path, std::string& error);
+	// sourcePath: the .veg to record as the origin, may be empty
+	bool SaveBinary(const std::string& path, const std::string& sourcePath, std::string& error) const;
+
+	void Release();
+
+	bool IsMapped() const { return mapping != nullptr; }
+
+	ElementType GetElementType() const { return elementType; }
+	uint32_t GetNumVertices() const { return numVertices; }
+	uint32_t GetNumElements() const { return numElements; }
+	uint32_t GetNumElementVertices() const { return numElementVertices; }
+	// edge length of the cubes, 0 for tets
+	double GetCubeSize() const { return cubeSize; }
+
+	const double* GetVertices() const { return vertices; }
+	const int32_t* GetElements() const { return elements; }
+
+	Vec3d GetVertex(int vertex) const { return Vec3d(&vertices[3 * vertex]); }
+	Vec3d GetVertex(int element, int j) const { return GetVertex(GetVertexIndex(element, j)); }
+	int GetVertexIndex(int element, int j) const { return elements[numElementVertices * element + j]; }
+
+private:
+	ElementType elementType = ElementType::Tet;
+	uint32_t numVertices = 0, numElements = 0, numElementVertices = 0;
+	double cubeSize = 0.0;
+
+	const double* vertices = nullptr;
+	const int32_t* elements = nullptr;
+
+	// storage behind the pointers: a read-only mapping, or these
+	void* mapping = nullptr;
+	size_t mappingSize = 0;
+	std::vector<double> ownedVertices;
+	std::vector<int32_t> ownedElements;
+};
@@ -8,28 +8,120 @@
 
 #include "Simulator.h"
 
+#include <iostream>
+
 void Simulator::StartUp(const Config& config)
 {
+    // pick the kernels before the solver sets up its element loop
+    {
+        using InstructionSet = Config::Simulator::InstructionSet;
+
+        const Kernels::ISA detected = Kernels::Detect();
+        Kernels::ISA isa = detected;
+        switch (config.simulator.instructionSet)
+        {
+        case InstructionSet::Scalar:    isa = Kernels::ISA::Scalar; break;
+        case InstructionSet::NEON:      isa = Kernels::ISA::NEON;   break;
+        case InstructionSet::AVX2:      isa = Kernels::ISA::AVX2;   break;
+        case InstructionSet::AVX512:    isa = Kernels::ISA::AVX512; break;
+        case InstructionSet::Auto:
+        default:                        break;
+        }
+
+        if (!Kernels::IsSupported(isa))
+        {
+            std::cout << Kernels::Name(isa) << " is not supported on this CPU; ";
+            isa = detected;
+        }
+
+        Kernels::Select(isa);
+        std::cout << "kernels: " << Kernels::Name(isa) << " (detected " << Kernels::Name(detected) << ")\n";
+    }
+
     gSolver.StartUp(config);
+
+    asynchronous = config.simulator.asynchronous;
+    stepRate = config.simulator.stepRate;
+
+    if (asynchronous)
+    {
+        // the renderer reads the rest shape until the first step is published
+        displacements.Reset(Vec::Zero(3 * gSolver.GetNumVertices()));
+
+        running.store(true, std::memory_order_release);
+        simThread = std::thread{ &Simulator::Run, this };
+    }
 }
 
 void Simulator::ShutDown()
 {
+    running.store(false, std::memory_order_release);
+    if (simThread.joinable())
+        simThread.join();
+}
+
+const Result& Simulator::Update(const State& state)
+{
+    if (!asynchronous)
+    {
+        result = Step(state);
+        return result;
+    }
+
+    // a full queue only drops a stale state, the next frame sends a fresh one
+    stateQueue.TryPush(state);
+
+    const Vec& u = displacements.Read();
+    result = Result{ u.data(), uint32_t(u.size() / 3) };
+    return result;
 }
 
 Result Simulator::Step(const State& state)
 {
     const Vec& u = gSolver.Step(state.selectedVert);
-    Result res;
-    res.u.reserve(u.size() / 3);
-    for (size_t i = 0; i < u.size() / 3; ++i)
+    return Result{ u.data(), uint32_t(u.size() / 3) };
+}
+
+// simulation thread: applies the newest State, steps, publishes, and keeps
+// to stepRate without ever waiting on the render thread
+void Simulator::Run()
+{
+    using clock = std::chrono::steady_clock;
+
+    State state;
+    bool hasState = false;
+    auto next = clock::now();
+
+    while (running.load(std::memory_order_acquire))
     {
-        res.u.emplace_back(simd_float3{
-            float(u(3 * i + 0)),
-            float(u(3 * i + 1)),
-            float(u(3 * i + 2))
-        });
-    }
+        State update;
+        while (stateQueue.TryPop(update))
+        {
+            state = update;
+            hasState = true;
+        }
+
+        // nothing to simulate before the first frame sends its state
+        if (!hasState)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
 
-    return res;
+        // same size every step, so this copies without reallocating
+        displacements.WriteBuffer() = gSolver.Step(state.selectedVert);
+        displacements.Publish();
+
+        if (stepRate > 0.0)
+        {
+            next += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / stepRate));
+
+            // fell behind: don't try to catch up with a burst of steps
+            const auto now = clock::now();
+            if (next < now)
+                next = now;
+            else
+                std::this_thread::sleep_until(next);
+        }
+    }
 }
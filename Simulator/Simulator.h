@@ -9,20 +9,40 @@
 #pragma once
 
 #include "Solver.h"
+#include "LockFree.h"
 
 #include <simd/simd.h>
 
+#include <atomic>
+#include <thread>
+
 class Simulator
 {
 public:
     Simulator() = default;
-    ~Simulator() = default;
+    ~Simulator() { ShutDown(); }
 
     void StartUp(const Config& config);
     void ShutDown();
 
+    // synchronous: steps right away. asynchronous: queues state for the
+    // simulation thread and returns the latest finished step without waiting;
+    // the reference stays valid until the next Update
+    const Result& Update(const State& state);
+
     Result Step(const State& state);
 
 private:
+    void Run();
+
     Solver gSolver;
+
+    bool asynchronous = false;
+    double stepRate;
+    std::thread simThread;
+    std::atomic<bool> running{ false };
+
+    SPSCQueue<State, 64> stateQueue;
+    TripleBuffer<Vec> displacements;
+    Result result;
 };
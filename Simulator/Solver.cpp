@@ -1,10 +1,42 @@
 #include "Solver.h"
 
-#include "vega/volumetricMesh/volumetricMeshLoader.h"
+#include "ThreadPool.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <iomanip>
+#include <iostream>
+#include <limits>
+
+// The element loop, cloned per Kernels::ISA. flatten pulls the whole call tree
+// of the element functions (SVD, energy, Hessian products) into each clone, so
+// Eigen's fixed-size math is compiled for that target as well. NEON is the
+// baseline of arm64, the plain loop already uses it.
+struct ElementLoop
+{
+	static void Scalar(Solver& solver)
+	{
+		for (uint32_t i = 0; i < solver.numElements; i++)
+			solver.ComputeElement(i);
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	__attribute__((target("avx2,fma"), flatten))
+	static void AVX2(Solver& solver)
+	{
+		for (uint32_t i = 0; i < solver.numElements; i++)
+			solver.ComputeElement(i);
+	}
+
+	__attribute__((target("avx512f,avx512vl,avx2,fma"), flatten))
+	static void AVX512(Solver& solver)
+	{
+		for (uint32_t i = 0; i < solver.numElements; i++)
+			solver.ComputeElement(i);
+	}
+#endif
+};
 
 
 void Solver::StartUp(const Config& config)
@@ -17,26 +49,30 @@ void Solver::StartUp(const Config& config)
         magicConstant   = simConfig.magicConstant;
         loadStep        = simConfig.loadStep;
         loadedVert      = simConfig.loadedVert;
+        currentLoad     = 0.f;
 
-		solver.setMaxIterations(simConfig.maxCGIteration);
-        solver.setTolerance(0.1);
+        corotational        = simConfig.elementModel == Config::Simulator::ElementModel::Corotational;
+        warmStartRotations  = simConfig.warmStartRotations;
+
+        maxCGIterations = simConfig.maxCGIteration;
+        cgTolerance     = 0.1;
 
         // load mesh
 		{
-			std::string meshPath = config.bundlePath + std::string{'/'} + config.simulator.modelName + ".veg";
-			std::cout << "loading mesh " << meshPath << '\n';
-
-			mesh = VolumetricMeshLoader::load(meshPath.c_str());
+			const std::string meshPath = config.bundlePath + std::string{'/'} + config.simulator.modelName;
+			std::cout << "loading mesh " << meshPath << ".veg\n";
 
-			if (!mesh)
+			std::string error;
+			if (!mesh.Load(meshPath, config.cachePath, error))
 			{
+				std::cout << error << '\n';
 				std::cout << "fail! terminating\n";
 				std::exit(420);
 			}
-            std::cout << "success! num elements: "
-                << mesh->getNumElements()
+            std::cout << "success! " << (mesh.IsMapped() ? "(binary) " : "") << "num elements: "
+                << mesh.GetNumElements()
                 << ";  num vertices: "
-                << mesh->getNumVertices() << ";\n";
+                << mesh.GetNumVertices() << ";\n";
 		}
 
 		// set material
@@ -44,31 +80,26 @@ void Solver::StartUp(const Config& config)
 			const double E = simConfig.material.E * 1.e6;
 			const double nu = simConfig.material.nu;
 
-            energyFunction = new ARAP{ E, nu };
+            using Model = Config::Simulator::Material::Model;
+            switch (simConfig.material.model)
+            {
+            case Model::StVK:               energyFunction = new StVK{ E, nu };             break;
+            case Model::NeoHookean:         energyFunction = new NeoHookean{ E, nu };       break;
+            case Model::StableNeoHookean:   energyFunction = new StableNeoHookean{ E, nu }; break;
+            case Model::ARAP:
+            default:                        energyFunction = new ARAP{ E, nu };             break;
+            }
             lambda = nu * E / ((1.0 + nu) * (1.0 - 2.0 * nu)); // from vega fem homogeneousNeoHookeanIsotropicMaterial.cpp
             mu = E / (2.0 * (1.0 + nu));
-
-            Twist[0].setZero();
-            Twist[0](0, 1) = -1.0;
-            Twist[0](1, 0) = 1.0;
-
-            Twist[1].setZero();
-            Twist[1](1, 2) = 1.0;
-            Twist[1](2, 1) = -1.0;
-
-            Twist[2].setZero();
-            Twist[2](0, 2) = 1.0;
-            Twist[2](2, 0) = -1.0;
-
-            sq2inv = 1.0 / std::sqrt(2.0);
+            hessianScale = 2.0 / mu;
 		}
 
         BCs = simConfig.BCs;
 	}
 
-    numVertices = mesh->getNumVertices();
+    numVertices = mesh.GetNumVertices();
 	numDOFs = 3 * numVertices;
-    numElements = mesh->getNumElements();
+    numElements = mesh.GetNumElements();
 
 	T = 0.0;
 
@@ -80,82 +111,369 @@ void Solver::StartUp(const Config& config)
 	z.setZero(numDOFs);
 	fExt.setZero(numDOFs);
     lastDu.setZero(numDOFs);
+    SystemVec.setZero(numDOFs);
+
+    cgInvDiag.setZero(numDOFs);
+    cgResidual.setZero(numDOFs);
+    cgP.setZero(numDOFs);
+    cgZ.setZero(numDOFs);
+    cgTmp.setZero(numDOFs);
+
+    computeElements = &ElementLoop::Scalar;
+#if defined(__x86_64__) || defined(__i386__)
+    if (Kernels::Selected() == Kernels::ISA::AVX2)
+        computeElements = &ElementLoop::AVX2;
+    else if (Kernels::Selected() == Kernels::ISA::AVX512)
+        computeElements = &ElementLoop::AVX512;
+#endif
+
+	hexMode = mesh.GetElementType() == SimulationMesh::ElementType::Cubic;
+	if (hexMode)
+		hexTemplate.Init(mesh.GetCubeSize());
+
+	if (hexMode && corotational)
+	{
+		const Mat9 C = LinearElasticityTensor();
+		hexRestK.setZero();
+		for (int q = 0; q < HexTemplate::numQuadraturePoints; ++q)
+		{
+			const Mat9x24& dFdx = hexTemplate.dFdx[q];
+			hexRestK.noalias() += hexTemplate.quadratureWeight * dFdx.transpose() * C * dFdx;
+		}
+	}
 
-	// DmInv, dFdx, mass
+	// DmInv, dFdx, mass, Keff's pattern: mapped from an earlier run if it was
+	// made for this mesh and material (shipped next to the mesh, or in the
+	// cache), else built and saved to the cache for the next one
 	{
-		DmInvs.reserve(numElements);
-		dFdxs.reserve(numElements);
-		tetVols.reserve(numElements);
+		const uint64_t key = Precomputation::ComputeKey(mesh, simConfig);
+		const std::string fileName = simConfig.modelName + ".precomp";
+		const std::string shippedPath = config.bundlePath + '/' + fileName;
+		const std::string cachedPath = config.cachePath.empty() ? std::string{} : config.cachePath + '/' + fileName;
 
-		M = SpMat(numDOFs, numDOFs);
+		std::string error;
+		const bool mapped =
+			(precomputation.Load(shippedPath, key, error) && UsePrecomputation()) ||
+			(!cachedPath.empty() && precomputation.Load(cachedPath, key, error) && UsePrecomputation());
 
-		const double rho = simConfig.material.rho;
-		for (int i = 0; i < numElements; ++i)
+		if (!mapped)
 		{
-			Mat3 Dm = ComputeDm(i);
+			Precompute(simConfig, key);
+			UsePrecomputation();
+
+			if (!cachedPath.empty() && !precomputation.Save(cachedPath, error))
+				std::cout << error << '\n';
+		}
+		std::cout << "precomputation " << (mapped ? "mapped" : "built") << ";\n";
+	}
+
+	if (hexMode)
+	{
+		std::cout << "hexahedral mesh, cube size: " << hexTemplate.cubeSize << ';';
+		if (structuredGrid)
+			std::cout << " structured grid " << gridRes[0] << 'x' << gridRes[1] << 'x' << gridRes[2] << ';';
+		std::cout << '\n';
+
+		hexFIntArray = std::vector<Vec24>{ numElements, Vec24::Zero() };
+		hexKelArray  = std::vector<Mat24>{ numElements, Mat24::Zero() };
+	}
+	else
+	{
+		fIntArray = std::vector<Vec12>{ numElements, Vec12::Zero() };
+		KelArray  = std::vector<Mat12>{ numElements, Mat12::Zero() };
+	}
 
-			Mat3 DmInv = Dm.inverse();
-			DmInvs.emplace_back(DmInv);
+    isConstrained.assign(numDOFs, false);
+    for (const auto& bc : BCs)
+        for (int d = 0; d < 3; ++d)
+            isConstrained[3 * bc + d] = true;
 
-			Mat9x12 dFdx = ComputedFdx(DmInv);
-			dFdxs.emplace_back(dFdx);
+    if (warmStartRotations)
+    {
+        const uint32_t rotationsPerElement = (hexMode && !corotational) ? HexTemplate::numQuadraturePoints : 1;
+        rotations = std::vector<Eigen::Quaterniond>{ rotationsPerElement * numElements, Eigen::Quaterniond::Identity() };
+    }
 
-			// tetVols, M mx.
+    for (uint32_t i = 0; i < mesh.GetNumVertices(); ++i)
+    {
+        Vec3d v = mesh.GetVertex(i);
+        x(3 * i + 0) = v[0];
+        x(3 * i + 1) = v[1];
+        x(3 * i + 2) = v[2];
+    }
+	x_0 = x;
+}
+
+void Solver::Precompute(const Config::Simulator& simConfig, uint64_t key)
+{
+	precomputation.Reset(key);
+
+	structuredGrid = hexMode && DetectStructuredGrid();
+	precomputation.SetStructuredGrid(structuredGrid, gridRes);
+
+	ThreadPool& pool = ThreadPool::Get();
+	const int numElementVertices = mesh.GetNumElementVertices();
+
+	// vertex -> incident elements, ascending; drives the race-free mass
+	// reduction and Keff's pattern
+	std::vector<int> elementOffsets(numVertices + 1, 0);
+	for (uint32_t i = 0; i < numElements; ++i)
+		for (int v = 0; v < numElementVertices; ++v)
+			++elementOffsets[mesh.GetVertexIndex(i, v) + 1];
+	for (uint32_t v = 0; v < numVertices; ++v)
+		elementOffsets[v + 1] += elementOffsets[v];
+
+	std::vector<int> vertexElements(elementOffsets.back());
+	{
+		std::vector<int> cursor(elementOffsets.begin(), elementOffsets.end() - 1);
+		for (uint32_t i = 0; i < numElements; ++i)
+			for (int v = 0; v < numElementVertices; ++v)
+				vertexElements[cursor[mesh.GetVertexIndex(i, v)]++] = i;
+	}
+
+	if (!structuredGrid)
+	{
+		int* indices = precomputation.Allocate<int>(Precomputation::ElementIndices, numElementVertices * size_t(numElements));
+		pool.ParallelFor(0, int(numElements), 4096, [&](int begin, int end) {
+			for (int i = begin; i < end; ++i)
+				for (int v = 0; v < numElementVertices; ++v)
+					indices[numElementVertices * i + v] = 3 * mesh.GetVertexIndex(i, v);
+		});
+	}
+
+	// element masses, lumped as GenerateMassMatrix::computeVertexMasses does
+	// (row sums of the consistent mass matrix): an equal share per vertex
+	std::vector<double> elementMasses;
+	if (hexMode)
+	{
+		elementMasses.assign(numElements, simConfig.material.rho * hexTemplate.volume);
+	}
+	else
+	{
+		double* vols = precomputation.Allocate<double>(Precomputation::TetVolumes, numElements);
+		Mat3* DmInverses = precomputation.Allocate<Mat3>(Precomputation::DmInverses, numElements);
+		Mat12* restStiffnesses = corotational ? precomputation.Allocate<Mat12>(Precomputation::RestStiffnesses, numElements) : nullptr;
+		Mat9x12* shapeGradients = corotational ? nullptr : precomputation.Allocate<Mat9x12>(Precomputation::ShapeGradients, numElements);
+
+		// rest shape checks, reported after the parallel pass
+		enum : uint8_t { Valid, Degenerate, Inverted };
+		std::vector<uint8_t> status(numElements, Valid);
+
+		elementMasses.resize(numElements);
+		const Mat9 C = LinearElasticityTensor();
+		const double rho = simConfig.material.rho;
+
+		pool.ParallelFor(0, int(numElements), 256, [&](int begin, int end) {
+			for (int i = begin; i < end; ++i)
 			{
-				double vol = std::abs((1.0 / 6) * Dm.determinant());
-				tetVols.emplace_back(vol);
-				double mass = rho * vol;
-				for (int v = 0; v < 4; ++v)
+				const Mat3 Dm = ComputeDm(i);
+				const double det = Dm.determinant();
+
+				// relative to the longest edge, a regular tet is at 0.7
+				double longestEdge2 = std::max({ Dm.col(0).squaredNorm(), Dm.col(1).squaredNorm(), Dm.col(2).squaredNorm(),
+					(Dm.col(1) - Dm.col(0)).squaredNorm(), (Dm.col(2) - Dm.col(0)).squaredNorm(), (Dm.col(2) - Dm.col(1)).squaredNorm() });
+				if (!(std::abs(det) > 1.e-10 * longestEdge2 * std::sqrt(longestEdge2)))
 				{
-                    int index = mesh->getVertexIndex(i, v);
-					M.coeffRef(3 * index + 0, 3 * index + 0) += mass;
-					M.coeffRef(3 * index + 1, 3 * index + 1) += mass;
-					M.coeffRef(3 * index + 2, 3 * index + 2) += mass;
+					// left out: no volume, so no mass, force or stiffness; the
+					// identity keeps its F finite
+					status[i] = Degenerate;
+					DmInverses[i].setIdentity();
+					continue;
 				}
+				if (det < 0.0)
+					status[i] = Inverted;
+
+				const Mat3 DmInv = Dm.inverse();
+				DmInverses[i] = DmInv;
+
+				const Mat9x12 dFdx = ComputedFdx(DmInv);
+
+				const double vol = std::abs((1.0 / 6) * det);
+				vols[i] = vol;
+
+				// the rest stiffness replaces dFdx for the rest of the run
+				if (corotational)
+					restStiffnesses[i] = vol * dFdx.transpose() * C * dFdx;
+				else
+					shapeGradients[i] = dFdx;
+
+				elementMasses[i] = rho * vol;
 			}
+		});
 
+		// F = Ds DmInv is I at rest whatever the orientation, inverted tets
+		// still simulate; degenerate ones would have put inf/NaN in DmInv
+		int numDegenerate = 0, numInverted = 0;
+		int firstDegenerate = -1, firstInverted = -1;
+		for (uint32_t i = 0; i < numElements; ++i)
+		{
+			if (status[i] == Degenerate && numDegenerate++ == 0)
+				firstDegenerate = i;
+			if (status[i] == Inverted && numInverted++ == 0)
+				firstInverted = i;
 		}
+		if (numDegenerate > 0)
+			std::cout << "warning: " << numDegenerate << " degenerate tets (first: " << firstDegenerate << "), left out;\n";
+		if (numInverted > 0)
+			std::cout << "warning: " << numInverted << " inverted tets (first: " << firstInverted << ");\n";
 	}
 
-	// create Keff, tbb arrays
+	// each vertex sums its incident elements in element order: no races, and
+	// the same result on any number of threads
+	double* masses = precomputation.Allocate<double>(Precomputation::Masses, numDOFs);
+	pool.ParallelFor(0, int(numVertices), 4096, [&](int begin, int end) {
+		for (int v = begin; v < end; ++v)
+		{
+			double mass = 0.0;
+			for (int k = elementOffsets[v]; k < elementOffsets[v + 1]; ++k)
+				mass += elementMasses[vertexElements[k]] / numElementVertices;
+			masses[3 * v + 0] = masses[3 * v + 1] = masses[3 * v + 2] = mass;
+		}
+	});
+
+	BuildKeffPattern(elementOffsets, vertexElements);
+}
+
+// Keff's compressed pattern straight from the vertex adjacency: DOF column
+// 3v + c holds the three rows of every vertex sharing an element with v, in
+// ascending order, the same pattern a coeffRef per element entry leaves
+// after makeCompressed. Counted, then filled, in parallel over the vertices.
+void Solver::BuildKeffPattern(const std::vector<int>& elementOffsets, const std::vector<int>& vertexElements)
+{
+	const int numElementVertices = mesh.GetNumElementVertices();
+	ThreadPool& pool = ThreadPool::Get();
+
+	const auto gatherNeighbors = [&](int v, std::vector<int>& neighbors) {
+		neighbors.clear();
+		for (int k = elementOffsets[v]; k < elementOffsets[v + 1]; ++k)
+			for (int j = 0; j < numElementVertices; ++j)
+				neighbors.push_back(mesh.GetVertexIndex(vertexElements[k], j));
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+	};
+
+	int* outer = precomputation.Allocate<int>(Precomputation::KeffOuter, numDOFs + 1);
+
+	// the column lengths of v, 3 per neighbor, go to its first column's slot
+	pool.ParallelFor(0, int(numVertices), 1024, [&](int begin, int end) {
+		std::vector<int> neighbors;
+		for (int v = begin; v < end; ++v)
+		{
+			gatherNeighbors(v, neighbors);
+			outer[3 * v + 1] = 3 * int(neighbors.size());
+		}
+	});
+
+	outer[0] = 0;
+	for (uint32_t v = 0; v < numVertices; ++v)
 	{
-		Keff = SpMat(numDOFs, numDOFs);
+		const int length = outer[3 * v + 1];
+		outer[3 * v + 1] = outer[3 * v] + length;
+		outer[3 * v + 2] = outer[3 * v + 1] + length;
+		outer[3 * v + 3] = outer[3 * v + 2] + length;
+	}
 
-		for (int i = 0; i < numElements; ++i)
+	int* inner = precomputation.Allocate<int>(Precomputation::KeffInner, outer[numDOFs]);
+	pool.ParallelFor(0, int(numVertices), 1024, [&](int begin, int end) {
+		std::vector<int> neighbors;
+		for (int v = begin; v < end; ++v)
 		{
+			gatherNeighbors(v, neighbors);
+			for (int c = 0; c < 3; ++c)
 			{
-				indexArray.push_back(3 * mesh->getVertexIndex(i, 0));
-				indexArray.push_back(3 * mesh->getVertexIndex(i, 1));
-				indexArray.push_back(3 * mesh->getVertexIndex(i, 2));
-				indexArray.push_back(3 * mesh->getVertexIndex(i, 3));
+				int* column = inner + outer[3 * v + c];
+				for (const int n : neighbors)
+				{
+					*column++ = 3 * n + 0;
+					*column++ = 3 * n + 1;
+					*column++ = 3 * n + 2;
+				}
 			}
-
-			Mat12 m;
-			m.setZero();
-
-			AddToKeff(m, i);
 		}
+	});
+}
 
-		fIntArray = std::vector<Vec12>{ numElements, Vec12::Zero() };
-		KelArray  = std::vector<Mat12>{ numElements, Mat12::Zero() };
+bool Solver::UsePrecomputation()
+{
+	using P = Precomputation;
+	const P& p = precomputation;
+
+	const size_t numElementVertices = hexMode ? HexTemplate::numCorners : 4;
+	const bool fits =
+		p.GetCount<double>(P::Masses) == numDOFs &&
+		p.GetCount<int>(P::ElementIndices) == (p.IsStructuredGrid() ? 0 : numElementVertices * numElements) &&
+		p.GetCount<int>(P::KeffOuter) == numDOFs + 1 &&
+		(hexMode ||
+		 (p.GetCount<double>(P::TetVolumes) == numElements &&
+		  p.GetCount<Mat3>(P::DmInverses) == numElements &&
+		  (corotational ? p.GetCount<Mat12>(P::RestStiffnesses) : p.GetCount<Mat9x12>(P::ShapeGradients)) == numElements));
+	if (!fits)
+		return false;
+
+	// the key vouches for the contents, this only guards the indexing against a damaged file
+	const int* outer = p.Get<int>(P::KeffOuter);
+	const int* inner = p.Get<int>(P::KeffInner);
+	const int nonZeros = outer[numDOFs];
+	if (outer[0] != 0 || nonZeros < 0 || size_t(nonZeros) != p.GetCount<int>(P::KeffInner))
+		return false;
+	for (uint32_t i = 0; i < numDOFs; ++i)
+		if (outer[i] > outer[i + 1])
+			return false;
+	for (int k = 0; k < nonZeros; ++k)
+		if (uint32_t(inner[k]) >= numDOFs)
+			return false;
+
+	const int* elementIndices = p.Get<int>(P::ElementIndices);
+	for (size_t k = 0; k < p.GetCount<int>(P::ElementIndices); ++k)
+		if (uint32_t(elementIndices[k]) > numDOFs - 3 || elementIndices[k] % 3 != 0)
+			return false;
+
+	tetVols = p.Get<double>(P::TetVolumes);
+	DmInvs = p.Get<Mat3>(P::DmInverses);
+	dFdxs = p.Get<Mat9x12>(P::ShapeGradients);
+	restKs = p.Get<Mat12>(P::RestStiffnesses);
+	indexArray = elementIndices;
+
+	structuredGrid = p.IsStructuredGrid();
+	for (int d = 0; d < 3; ++d)
+		gridRes[d] = p.GetGridRes()[d];
+
+	// lumped, so diagonal, written compressed in one pass
+	const double* masses = p.Get<double>(P::Masses);
+	M = SpMat(numDOFs, numDOFs);
+	M.resizeNonZeros(int(std::count_if(masses, masses + numDOFs, [](double m) { return m != 0.0; })));
+	{
+		int k = 0;
+		for (uint32_t i = 0; i < numDOFs; ++i)
+		{
+			M.outerIndexPtr()[i] = k;
+			if (masses[i] != 0.0)
+			{
+				M.innerIndexPtr()[k] = i;
+				M.valuePtr()[k++] = masses[i];
+			}
+		}
+		M.outerIndexPtr()[numDOFs] = k;
 	}
 
-    for (int i = 0; i < mesh->getNumVertices(); ++i)
-    {
-        Vec3d v = mesh->getVertex(i);
-        x(3 * i + 0) = v[0];
-        x(3 * i + 1) = v[1];
-        x(3 * i + 2) = v[2];
-    }
-	x_0 = x;
+	// the CG kernels work on the raw compressed arrays
+	Keff = SpMat(numDOFs, numDOFs);
+	Keff.resizeNonZeros(nonZeros);
+	std::copy(outer, outer + numDOFs + 1, Keff.outerIndexPtr());
+	std::copy(inner, inner + nonZeros, Keff.innerIndexPtr());
+	std::fill(Keff.valuePtr(), Keff.valuePtr() + nonZeros, 0.0);
+
+	return true;
 }
 
 void Solver::ShutDown()
 {
-	delete mesh;
+	delete energyFunction;
+	precomputation.Release();
+	mesh.Release();
 }
 
-Vec Solver::Step(uint32_t selectedVert)
+const Vec& Solver::Step(uint32_t selectedVert)
 {
 	T += h;
 
@@ -163,7 +481,6 @@ Vec Solver::Step(uint32_t selectedVert)
 
     if (selectedVert != 0xFFFFFFFF)
     {
-        static float currentLoad = 0.f;
         if (std::abs(currentLoad) < std::abs(20.f * loadStep))
             currentLoad += loadStep;
 
@@ -181,40 +498,40 @@ Vec Solver::Step(uint32_t selectedVert)
     // build Keff
     FTime = PTime = dPdxTime = 0.0;
 
-    for (int i = 0; i < numElements; i++)
-        ComputeElementJacobianAndHessian(i);
+    computeElements(*this);
 
-    // accumulating Keff and fInt
+    // accumulating Keff and fInt, side by side on the pool
+    ThreadPool::Get().ParallelFor(0, 2, 1, [this](int begin, int end)
     {
-        std::thread KeffThread{ &Solver::FillKeff, this };
-        std::thread FintThread{ &Solver::FillFint, this };
-
-        FintThread.join();
-        KeffThread.join();
-
-    }
-
-    Vec SystemVec =  -fInt + fExt;
+        for (int job = begin; job < end; ++job)
+        {
+            if (job == 0)
+                FillKeff();
+            else
+                FillFint();
+        }
+    });
+
+    SystemVec.noalias() = fExt - fInt;
+
+    // decouple the constrained DOFs: leaving their off-diagonal entries in
+    // place makes Keff unsymmetric, and CG turns chaotic on the result
+    for (int k = 0; k < Keff.outerSize(); ++k)
+        for (SpMat::InnerIterator it(Keff, k); it; ++it)
+            if (isConstrained[it.row()] || isConstrained[it.col()])
+                it.valueRef() = (it.row() == it.col()) ? 1.0 : 0.0;
 
     for (const auto& bc : BCs)
     {
         const int index = 3 * bc;
-        Keff.coeffRef(index + 0, index + 0) = 1.0;
-        Keff.coeffRef(index + 1, index + 1) = 1.0;
-        Keff.coeffRef(index + 2, index + 2) = 1.0;
-
         SystemVec(index + 0) = 0.0;
         SystemVec(index + 1) = 0.0;
         SystemVec(index + 2) = 0.0;
     }
 
-    auto start = std::chrono::steady_clock::now();
-
-    solver.compute(Keff);
-    Vec du = solver.solveWithGuess(SystemVec, lastDu);
-
-    auto end = std::chrono::steady_clock::now();
-    std::cout << "s: " << std::chrono::duration_cast<std::chrono::microseconds>(end-start).count() << " µs ";
+    // solved in place: the scaled du of the last step is the initial guess
+    Vec& du = lastDu;
+    SolveCG(SystemVec, du);
 
     const double constant = magicConstant * h;
     du *= constant;
@@ -222,52 +539,27 @@ Vec Solver::Step(uint32_t selectedVert)
     u.noalias() += du;
     x.noalias() += du;
 
-    lastDu = du;
-
     return u;
 }
 
-void Solver::ComputeElementJacobianAndHessian(int i)
+void Solver::ComputeElement(int i)
 {
-	const int* indices = &(indexArray[4 * i]);
-
-	Mat3 F;
-	{
-		Vec3 v0, v1, v2, v3;
-		{
-			v0 << x(indices[0] + 0), x(indices[0] + 1), x(indices[0] + 2);
-			v1 << x(indices[1] + 0), x(indices[1] + 1), x(indices[1] + 2);
-			v2 << x(indices[2] + 0), x(indices[2] + 1), x(indices[2] + 2);
-			v3 << x(indices[3] + 0), x(indices[3] + 1), x(indices[3] + 2);
-		}
-		const Vec3 ds1 = v1 - v0;
-		const Vec3 ds2 = v2 - v0;
-		const Vec3 ds3 = v3 - v0;
-
-		Mat3 Ds;
-		Ds <<
-			ds1[0], ds2[0], ds3[0],
-			ds1[1], ds2[1], ds3[1],
-			ds1[2], ds2[2], ds3[2];
-		const Mat3 DmInv = DmInvs[i];
-		F = Ds * DmInv;
-	}
+	if (hexMode && corotational)
+		ComputeCorotatedHexElementJacobianAndHessian(i);
+	else if (hexMode)
+		ComputeHexElementJacobianAndHessian(i);
+	else if (corotational)
+		ComputeCorotatedElementJacobianAndHessian(i);
+	else
+		ComputeElementJacobianAndHessian(i);
+}
 
-	Mat3 P;
-	// ARAP
-	Mat3 U, VT, R;
-	Vec3 Sigma;
-	{
-		using namespace Eigen;
-		JacobiSVD<Mat3, NoQRPreconditioner> SVD(F, ComputeFullU | ComputeFullV);
-		Sigma = SVD.singularValues();
-		U = SVD.matrixU();
-		VT = SVD.matrixV();
-		VT.transposeInPlace();
+void Solver::ComputeElementJacobianAndHessian(int i)
+{
+	const Mat3 F = ComputeF(i);
 
-		R = U * VT;
-		P = mu * (F - R);
-	}
+	Eigensystem dPdF;
+	const Mat3 P = ComputeStress(F, warmStartRotations ? &rotations[i] : nullptr, dPdF);
 
 	const Mat9x12 dFdx = dFdxs[i];
 	const Mat12x9 minusTetVolxdFdxT = -tetVols[i] * dFdx.transpose();
@@ -280,43 +572,177 @@ void Solver::ComputeElementJacobianAndHessian(int i)
 		fIntArray[i] = fEl;
 	}
 
-	Mat9 dPdF;
-	//ARAP
+	const Mat12 dPdx = -tetVols[i] * hessianScale * dPdF.Sandwich(dFdx);
+
+	KelArray[i] = dPdx;
+
+}
+
+void Solver::ComputeHexElementJacobianAndHessian(int i)
+{
+	int indices[HexTemplate::numCorners];
+	GetHexIndices(i, indices);
+
+	Mat3x8 X;
+	for (int v = 0; v < HexTemplate::numCorners; ++v)
+		X.col(v) << x(indices[v] + 0), x(indices[v] + 1), x(indices[v] + 2);
+
+	const double w = hexTemplate.quadratureWeight;
+
+	Vec24 fEl = Vec24::Zero();
+	Mat24 dPdx = Mat24::Zero();
+
+	for (int q = 0; q < HexTemplate::numQuadraturePoints; ++q)
+	{
+		const Mat3 F = X * hexTemplate.dNdX[q];
+
+		Eigensystem dPdF;
+		Eigen::Quaterniond* rotation = warmStartRotations ? &rotations[HexTemplate::numQuadraturePoints * i + q] : nullptr;
+		const Mat3 P = ComputeStress(F, rotation, dPdF);
+
+		// same as -w * dFdx^T * vec(P), without touching the zeros of dFdx
+		Eigen::Map<Mat3x8>(fEl.data()).noalias() -= w * P * hexTemplate.dNdX[q].transpose();
+
+		const Mat9x24& dFdx = hexTemplate.dFdx[q];
+		dPdx.noalias() -= w * hessianScale * dPdF.Sandwich(dFdx);
+	}
+
+	hexFIntArray[i] = fEl;
+	hexKelArray[i] = dPdx;
+}
+
+void Solver::ComputeCorotatedElementJacobianAndHessian(int i)
+{
+	const int* indices = &(indexArray[4 * i]);
+
+	const Mat3 R = ExtractRotation(ComputeF(i), i);
+	const Mat12& K0 = restKs[i];
+
+	// rotate the element back to its rest frame: R^T x - X
+	Vec12 localDisp;
+	for (int v = 0; v < 4; ++v)
+	{
+		const Vec3 xv = x.segment<3>(indices[v]);
+		localDisp.segment<3>(3 * v) = R.transpose() * xv - x_0.segment<3>(indices[v]);
+	}
+
+	const Vec12 localForce = K0 * localDisp;
+
+	Vec12 fEl;
+	Mat12 dPdx;
+	for (int a = 0; a < 4; ++a)
 	{
-		double I[3];
-		I[0] = Sigma(0) + Sigma(1);
-		I[1] = Sigma(1) + Sigma(2);
-		I[2] = Sigma(0) + Sigma(2);
+		fEl.segment<3>(3 * a) = -R * localForce.segment<3>(3 * a);
+		for (int b = 0; b < 4; ++b)
+			dPdx.block<3, 3>(3 * a, 3 * b) = -hessianScale * R * K0.block<3, 3>(3 * a, 3 * b) * R.transpose();
+	}
 
-		double lambda[3];
-		for (int i = 0; i < 3; ++i)
-			(I[i] >= 2.0) ? lambda[i] = 2.0 / I[i] : lambda[i] = 1.0;
+	fIntArray[i] = fEl;
+	KelArray[i] = dPdx;
+}
 
-		dPdF.setIdentity();
-		for (int el = 0; el < 3; ++el)
-		{
-			Mat3 Q = sq2inv * U * Twist[el] * VT;
+void Solver::ComputeCorotatedHexElementJacobianAndHessian(int i)
+{
+	int indices[HexTemplate::numCorners];
+	GetHexIndices(i, indices);
+
+	Mat3x8 X;
+	for (int v = 0; v < HexTemplate::numCorners; ++v)
+		X.col(v) = x.segment<3>(indices[v]);
 
-			Vec9 q = Flatten(Q);
-			Mat9 H = lambda[el] * q * q.transpose();
-			dPdF -= H;
+	const Mat3 R = ExtractRotation(X * hexTemplate.dNdXCenter, i);
+
+	Vec24 localDisp;
+	for (int v = 0; v < HexTemplate::numCorners; ++v)
+		localDisp.segment<3>(3 * v) = R.transpose() * X.col(v) - x_0.segment<3>(indices[v]);
+
+	const Vec24 localForce = hexRestK * localDisp;
+
+	Vec24& fEl = hexFIntArray[i];
+	Mat24& dPdx = hexKelArray[i];
+	for (int a = 0; a < HexTemplate::numCorners; ++a)
+	{
+		fEl.segment<3>(3 * a) = -R * localForce.segment<3>(3 * a);
+		for (int b = 0; b < HexTemplate::numCorners; ++b)
+			dPdx.block<3, 3>(3 * a, 3 * b) = -hessianScale * R * hexRestK.block<3, 3>(3 * a, 3 * b) * R.transpose();
+	}
+}
+
+// dP/dF of linear elasticity, P = mu (F + F^T - 2I) + lambda tr(F - I) I
+Mat9 Solver::LinearElasticityTensor() const
+{
+	Mat9 C = Mat9::Zero();
+	for (int c = 0; c < 3; ++c)
+	{
+		for (int r = 0; r < 3; ++r)
+		{
+			C(3 * c + r, 3 * c + r) += mu;
+			C(3 * c + r, 3 * r + c) += mu;
 		}
-		dPdF *= 2.0;
+	}
+	for (int a = 0; a < 3; ++a)
+		for (int b = 0; b < 3; ++b)
+			C(4 * a, 4 * b) += lambda;
 
+	return C;
+}
+
+Mat3 Solver::ExtractRotation(const Mat3& F, int elem)
+{
+	if (!warmStartRotations)
+		return PolarRotation(F);
 
+	// rotations barely change between steps, a couple of iterations from
+	// last step's result are usually enough
+	Eigen::Quaterniond& q = rotations[elem];
+	if (F.determinant() <= 0.0 || !RefineRotation(F, q, maxRotationIterations, 1.e-6))
+	{
+		const Mat3 R = PolarRotation(F);
+		q = Eigen::Quaterniond(R);
+		return R;
 	}
+	return q.matrix();
+}
+
+// P and the PSD-projected eigensystem of dP/dF of the configured energy
+Mat3 Solver::ComputeStress(const Mat3& F, Eigen::Quaterniond* rotation, Eigensystem& dPdF)
+{
+	Mat3 U, V;
+	Vec3 Sigma;
+	if (!rotation || !WarmStartedSVD(F, *rotation, maxRotationIterations, U, Sigma, V))
+	{
+		RotationVariantSVD(F, U, Sigma, V);
 
-	const Mat12 dPdx = minusTetVolxdFdxT * dPdF * dFdx;
+		// reseed the warm start
+		if (rotation)
+			*rotation = Eigen::Quaterniond(Mat3(U * V.transpose()));
+	}
 
-	KelArray[i] = dPdx;
+	const Mat3 P = energyFunction->GetPK1(U, Sigma, V, &dPdF);
+	dPdF.ClampToPSD();
 
+	return P;
 }
 
 void Solver::FillFint()
 {
-	for (int i = 0; i < numElements; ++i)
+	if (hexMode)
 	{
-		int* indices = &(indexArray[4 * i]);
+		for (uint32_t i = 0; i < numElements; ++i)
+		{
+			int indices[HexTemplate::numCorners];
+			GetHexIndices(i, indices);
+
+			for (int el = 0; el < HexTemplate::numCorners; ++el)
+				for (int incr = 0; incr < 3; ++incr)
+					fInt(indices[el] + incr) += hexFIntArray[i](3 * el + incr);
+		}
+		return;
+	}
+
+	for (uint32_t i = 0; i < numElements; ++i)
+	{
+		const int* indices = &(indexArray[4 * i]);
 
 		for (int el = 0; el < 4; ++el)
 			for (int incr = 0; incr < 3; ++incr)
@@ -326,9 +752,16 @@ void Solver::FillFint()
 
 void Solver::FillKeff()
 {
-	for (int i = 0; i < numElements; ++i)
+	if (hexMode)
 	{
-		int* indices = &(indexArray[4 * i]);
+		for (uint32_t i = 0; i < numElements; ++i)
+			AddToKeff(hexKelArray[i], i);
+		return;
+	}
+
+	for (uint32_t i = 0; i < numElements; ++i)
+	{
+		const int* indices = &(indexArray[4 * i]);
 
 		for (int y = 0; y < 4; ++y)
 			for (int x = 0; x < 4; ++x)
@@ -339,9 +772,60 @@ void Solver::FillKeff()
 	}
 }
 
+// same iteration and stopping rule as Eigen::ConjugateGradient with its
+// default diagonal preconditioner; x holds the initial guess
+void Solver::SolveCG(const Vec& b, Vec& x)
+{
+	const int n = numDOFs;
+	const int* outer = Keff.outerIndexPtr();
+	const int* inner = Keff.innerIndexPtr();
+	const double* values = Keff.valuePtr();
+
+	cgInvDiag = Keff.diagonal();
+	for (int i = 0; i < n; ++i)
+		cgInvDiag(i) = cgInvDiag(i) != 0.0 ? 1.0 / cgInvDiag(i) : 1.0;
+
+	const double rhsNorm2 = Kernels::Dot(n, b.data(), b.data());
+	if (rhsNorm2 == 0.0)
+	{
+		x.setZero();
+		return;
+	}
+	const double threshold = std::max(cgTolerance * cgTolerance * rhsNorm2, std::numeric_limits<double>::min());
+
+	Kernels::SpMV(n, outer, inner, values, x.data(), cgTmp.data());
+	cgResidual = b - cgTmp;
+
+	double residualNorm2 = Kernels::Dot(n, cgResidual.data(), cgResidual.data());
+	if (residualNorm2 < threshold)
+		return;
+
+	Kernels::Multiply(n, cgInvDiag.data(), cgResidual.data(), cgP.data());
+	double absNew = Kernels::Dot(n, cgResidual.data(), cgP.data());
+
+	for (int iter = 0; iter < maxCGIterations; ++iter)
+	{
+		Kernels::SpMV(n, outer, inner, values, cgP.data(), cgTmp.data());
+
+		const double alpha = absNew / Kernels::Dot(n, cgP.data(), cgTmp.data());
+		Kernels::Axpy(n, alpha, cgP.data(), x.data());
+		Kernels::Axpy(n, -alpha, cgTmp.data(), cgResidual.data());
+
+		residualNorm2 = Kernels::Dot(n, cgResidual.data(), cgResidual.data());
+		if (residualNorm2 < threshold)
+			break;
+
+		Kernels::Multiply(n, cgInvDiag.data(), cgResidual.data(), cgZ.data());
+
+		const double absOld = absNew;
+		absNew = Kernels::Dot(n, cgResidual.data(), cgZ.data());
+		Kernels::Xpay(n, cgZ.data(), absNew / absOld, cgP.data());
+	}
+}
+
 void Solver::AddToKeff(const Mat12& dPdx, int elem)
 {
-	int* indices = &(indexArray[4*elem]);
+	const int* indices = &(indexArray[4*elem]);
 	for (int y = 0; y < 4; ++y)
 		for (int x = 0; x < 4; ++x)
 			for (int innerX = 0; innerX < 3; ++innerX)
@@ -349,12 +833,139 @@ void Solver::AddToKeff(const Mat12& dPdx, int elem)
 					Keff.coeffRef(indices[x] + innerX, indices[y] + innerY) += dPdx(3 * x + innerX, 3 * y + innerY);
 }
 
+void Solver::AddToKeff(const Mat24& dPdx, int elem)
+{
+	int indices[HexTemplate::numCorners];
+	GetHexIndices(elem, indices);
+
+	for (int y = 0; y < HexTemplate::numCorners; ++y)
+		for (int x = 0; x < HexTemplate::numCorners; ++x)
+			for (int innerX = 0; innerX < 3; ++innerX)
+				for (int innerY = 0; innerY < 3; ++innerY)
+					Keff.coeffRef(indices[x] + innerX, indices[y] + innerY) += dPdx(3 * x + innerX, 3 * y + innerY);
+}
+
+// returns the DOF offsets (3 * vertex index) of the element's corners
+void Solver::GetHexIndices(int elem, int* indices) const
+{
+	if (!structuredGrid)
+	{
+		for (int v = 0; v < HexTemplate::numCorners; ++v)
+			indices[v] = indexArray[HexTemplate::numCorners * elem + v];
+		return;
+	}
+
+	// same lexicographic (i, j, k) order as CubicMesh::createFromUniformGrid
+	const int k = elem % gridRes[2];
+	const int j = (elem / gridRes[2]) % gridRes[1];
+	const int i = elem / (gridRes[2] * gridRes[1]);
+
+	for (int v = 0; v < HexTemplate::numCorners; ++v)
+	{
+		const int I = i + hexCornerI[v];
+		const int J = j + hexCornerJ[v];
+		const int K = k + hexCornerK[v];
+		indices[v] = 3 * ((I * (gridRes[1] + 1) + J) * (gridRes[2] + 1) + K);
+	}
+}
+
+// checks whether the voxels fill a dense box with vertices and elements in
+// lexicographic order, in which case element indices can be computed on the fly
+bool Solver::DetectStructuredGrid()
+{
+	const double cubeSize = hexTemplate.cubeSize;
+
+	Vec3d minCorner = mesh.GetVertex(0);
+	for (uint32_t v = 1; v < numVertices; ++v)
+	{
+		const Vec3d& p = mesh.GetVertex(v);
+		for (int d = 0; d < 3; ++d)
+			minCorner[d] = std::min(minCorner[d], p[d]);
+	}
+
+	std::vector<int> gridCoords(3 * numVertices);
+	int maxCoord[3] = { 0, 0, 0 };
+	for (uint32_t v = 0; v < numVertices; ++v)
+	{
+		const Vec3d& p = mesh.GetVertex(v);
+		for (int d = 0; d < 3; ++d)
+		{
+			const double c = (p[d] - minCorner[d]) / cubeSize;
+			const int rounded = int(std::lround(c));
+			if (std::abs(c - rounded) > 1.e-6)
+				return false;
+			gridCoords[3 * v + d] = rounded;
+			maxCoord[d] = std::max(maxCoord[d], rounded);
+		}
+	}
+
+	for (int d = 0; d < 3; ++d)
+		gridRes[d] = maxCoord[d];
+
+	if (numVertices != uint32_t((gridRes[0] + 1) * (gridRes[1] + 1) * (gridRes[2] + 1)) ||
+		numElements != uint32_t(gridRes[0] * gridRes[1] * gridRes[2]))
+		return false;
+
+	for (uint32_t v = 0; v < numVertices; ++v)
+	{
+		const int* c = &gridCoords[3 * v];
+		if ((c[0] * (gridRes[1] + 1) + c[1]) * (gridRes[2] + 1) + c[2] != int(v))
+			return false;
+	}
+
+	// GetHexIndices reads gridRes; temporarily claim the structured layout to compare
+	structuredGrid = true;
+	for (uint32_t i = 0; i < numElements; ++i)
+	{
+		int indices[HexTemplate::numCorners];
+		GetHexIndices(i, indices);
+		for (int v = 0; v < HexTemplate::numCorners; ++v)
+		{
+			if (indices[v] != 3 * mesh.GetVertexIndex(i, v))
+			{
+				structuredGrid = false;
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+Mat3 Solver::ComputeF(int i)
+{
+	const int* indices = &(indexArray[4 * i]);
+
+	Mat3 F;
+	{
+		Vec3 v0, v1, v2, v3;
+		{
+			v0 << x(indices[0] + 0), x(indices[0] + 1), x(indices[0] + 2);
+			v1 << x(indices[1] + 0), x(indices[1] + 1), x(indices[1] + 2);
+			v2 << x(indices[2] + 0), x(indices[2] + 1), x(indices[2] + 2);
+			v3 << x(indices[3] + 0), x(indices[3] + 1), x(indices[3] + 2);
+		}
+		const Vec3 ds1 = v1 - v0;
+		const Vec3 ds2 = v2 - v0;
+		const Vec3 ds3 = v3 - v0;
+
+		Mat3 Ds;
+		Ds <<
+			ds1[0], ds2[0], ds3[0],
+			ds1[1], ds2[1], ds3[1],
+			ds1[2], ds2[2], ds3[2];
+		const Mat3 DmInv = DmInvs[i];
+		F = Ds * DmInv;
+	}
+	return F;
+}
+
 Mat3 Solver::ComputeDm(int i)
 {
-    Vec3d v0 = mesh->getVertex(i, 0);
-    Vec3d v1 = mesh->getVertex(i, 1);
-    Vec3d v2 = mesh->getVertex(i, 2);
-    Vec3d v3 = mesh->getVertex(i, 3);
+    Vec3d v0 = mesh.GetVertex(i, 0);
+    Vec3d v1 = mesh.GetVertex(i, 1);
+    Vec3d v2 = mesh.GetVertex(i, 2);
+    Vec3d v3 = mesh.GetVertex(i, 3);
 
 	Vec3d dm1 = v1 - v0;
 	Vec3d dm2 = v2 - v0;
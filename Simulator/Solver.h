@@ -12,9 +12,13 @@
 
 #pragma GCC diagnostic pop
 
-#include "vega/volumetricMesh/volumetricMesh.h"
+#include "SimulationMesh.h"
+#include "Precomputation.h"
 
 #include "EnergyFunction.h"
+#include "HexElement.h"
+#include "PolarDecomposition.h"
+#include "Kernels.h"
 
 #include <future>
 
@@ -29,15 +33,16 @@ struct loadVal
 
 class Solver
 {
-	VolumetricMesh* mesh;
+	SimulationMesh mesh;
 	uint32_t numDOFs, numElements, numVertices;
 
     EnergyFunction* energyFunction;
 
     double lambda, mu;
 
-    Mat3 Twist[3];
-    double sq2inv;
+    // Keff is assembled in units of 2 / mu, which keeps magicConstant and
+    // the BC rows independent of the material
+    double hessianScale;
 
     // time integration variables
     double T, h, h2, magicConstant;
@@ -45,28 +50,59 @@ class Solver
 
     // boundary conditions
     double loadStep;
+    // the load on the selected vertex, ramped up by loadStep per step
+    float currentLoad;
     std::vector<uint32_t> BCs;
+    std::vector<bool> isConstrained;
     int loadedVert;
 	SpMat S;
 	
 	// matrices and vectors
 	SpMat Keff, M, spI;
 	Vec x_0, u, x, v, a, z, fInt, fExt;
-    Vec lastDu;
-
-	// precomputed stuff
-	std::vector<double> tetVols;
-	std::vector<Mat3> DmInvs;
-	std::vector<Mat9x12> dFdxs;
+    Vec lastDu, SystemVec;
+
+	// precomputed stuff, views of precomputation's sections
+	Precomputation precomputation;
+	const double* tetVols;
+	const Mat3* DmInvs;
+	const Mat9x12* dFdxs;
+
+	// corotational linear FEM: rest stiffness per tet (or one shared for voxels)
+	bool corotational;
+	const Mat12* restKs;
+	Mat24 hexRestK;
+
+	// rotations of the last step, one per element (per quadrature point for
+	// ARAP voxels), refined instead of recomputing a full SVD every step
+	bool warmStartRotations;
+	std::vector<Eigen::Quaterniond> rotations;
+	static constexpr int maxRotationIterations = 4;
+
+	// voxel (CubicMesh) path: every element shares one rest-shape template
+	bool hexMode;
+	HexTemplate hexTemplate;
+
+	// structured grid: element vertex indices follow from the element index,
+	// so no indexArray is stored
+	bool structuredGrid;
+	int gridRes[3];
 
 	// for parallel Keff building
-	std::vector<int> indexArray;
+	const int* indexArray;
 	std::vector<Vec12>	fIntArray;
 	std::vector<Mat12>	KelArray;
+	std::vector<Vec24>	hexFIntArray;
+	std::vector<Mat24>	hexKelArray;
+
+	// linear solver: Jacobi-preconditioned CG on the Kernels SpMV/axpy
+	int maxCGIterations;
+	double cgTolerance;
+	Vec cgInvDiag, cgResidual, cgP, cgZ, cgTmp;
 
-	// linear solver objects
-	Eigen::ConjugateGradient<SpMat, Eigen::Lower> solver;
-	//Eigen::PardisoLU<SpMat> solver;
+	// element loop clone of the selected Kernels::ISA
+	friend struct ElementLoop;
+	void (*computeElements)(Solver&);
 
 	double FTime, PTime, dPdxTime;
 
@@ -77,17 +113,41 @@ public:
 	void StartUp(const Config& config);
 	void ShutDown();
 
-	Vec Step(uint32_t selectedVert);
+	// the returned displacements stay valid until the next Step
+	const Vec& Step(uint32_t selectedVert);
+
+	uint32_t GetNumVertices() const { return numVertices; }
 
 //	void ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
 private:
+	void ComputeElement(int i);
 	void ComputeElementJacobianAndHessian(int i);
+	void ComputeHexElementJacobianAndHessian(int i);
+	void ComputeCorotatedElementJacobianAndHessian(int i);
+	void ComputeCorotatedHexElementJacobianAndHessian(int i);
+	Mat3 ComputeStress(const Mat3& F, Eigen::Quaterniond* rotation, Eigensystem& dPdF);
+	Mat9 LinearElasticityTensor() const;
+	Mat3 ExtractRotation(const Mat3& F, int elem);
+
 	void AddToKeff(const Mat12& dPdx, int elem);
+	void AddToKeff(const Mat24& dPdx, int elem);
+
+	void GetHexIndices(int elem, int* indices) const;
+	bool DetectStructuredGrid();
+
+	// fills precomputation from scratch, in parallel; UsePrecomputation sets
+	// the solver up from a filled or mapped one, false if it doesn't fit the mesh
+	void Precompute(const Config::Simulator& simConfig, uint64_t key);
+	void BuildKeffPattern(const std::vector<int>& elementOffsets, const std::vector<int>& vertexElements);
+	bool UsePrecomputation();
 
 	void FillFint();
 	void FillKeff();
 
+	void SolveCG(const Vec& b, Vec& x);
+
+	Mat3	ComputeF(int i);
 	Mat3	ComputeDm(int i);
 	Mat9x12 ComputedFdx(Mat3 DmInv);
 
@@ -0,0 +1,118 @@
+//
+//  ThreadPool.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace
+{
+	// set while the thread runs chunks of a job, so that a nested ParallelFor runs
+	// inline instead of locking runMutex, which the job's caller already owns
+	thread_local bool inJob = false;
+}
+
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool::ThreadPool()
+{
+	const unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned i = 1; i < numThreads; ++i)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::Run(int begin, int end, int minChunk, Function function, const void* context)
+{
+	const int count = end - begin;
+	if (count <= 0)
+		return;
+
+	if (workers.empty() || count <= minChunk || inJob)
+	{
+		function(context, begin, end);
+		return;
+	}
+
+	std::unique_lock<std::mutex> busy(runMutex, std::try_to_lock);
+	if (!busy.owns_lock())
+	{
+		function(context, begin, end);
+		return;
+	}
+
+	// a few chunks per thread evens out uneven chunk costs
+	const int chunk = std::max(minChunk, (count + 4 * GetNumThreads() - 1) / (4 * GetNumThreads()));
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = Job{ function, context, end, chunk };
+		next.store(begin, std::memory_order_relaxed);
+		activeWorkers = int(workers.size());
+		++generation;
+	}
+	wake.notify_all();
+
+	Work(job);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return activeWorkers == 0; });
+}
+
+void ThreadPool::Work(const Job& job)
+{
+	inJob = true;
+	for (;;)
+	{
+		const int chunkBegin = next.fetch_add(job.chunk, std::memory_order_relaxed);
+		if (chunkBegin >= job.end)
+			break;
+
+		job.function(job.context, chunkBegin, std::min(chunkBegin + job.chunk, job.end));
+	}
+	inJob = false;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	uint64_t seen = 0;
+	for (;;)
+	{
+		Job current;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stop || generation != seen; });
+			if (stop)
+				return;
+
+			seen = generation;
+			current = job;
+		}
+
+		Work(current);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--activeWorkers == 0)
+			done.notify_one();
+	}
+}
@@ -0,0 +1,72 @@
+//
+//  ThreadPool.h
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent workers for data-parallel loops. Jobs don't allocate, so the
+// pool can be used from the per-frame paths. One job runs at a time: a
+// ParallelFor issued while another is in flight (from the other thread, or
+// nested inside a job) simply runs inline on the calling thread.
+class ThreadPool
+{
+public:
+	static ThreadPool& Get();
+
+	~ThreadPool();
+
+	int GetNumThreads() const { return int(workers.size()) + 1; }
+
+	// body(chunkBegin, chunkEnd) over [begin, end), in chunks of at least minChunk
+	template<typename Body>
+	void ParallelFor(int begin, int end, int minChunk, const Body& body)
+	{
+		Run(begin, end, minChunk, &Invoke<Body>, &body);
+	}
+
+private:
+	using Function = void (*)(const void*, int, int);
+
+	struct Job
+	{
+		Function function;
+		const void* context;
+		int end, chunk;
+	};
+
+	ThreadPool();
+
+	template<typename Body>
+	static void Invoke(const void* context, int chunkBegin, int chunkEnd)
+	{
+		(*static_cast<const Body*>(context))(chunkBegin, chunkEnd);
+	}
+
+	void Run(int begin, int end, int minChunk, Function function, const void* context);
+	void Work(const Job& job);
+	void WorkerLoop();
+
+	std::vector<std::thread> workers;
+
+	std::mutex runMutex;
+
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	uint64_t generation = 0;
+	int activeWorkers = 0;
+	bool stop = false;
+
+	Job job;
+	std::atomic<int> next{ 0 };
+};
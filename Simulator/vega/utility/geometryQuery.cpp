@@ -41,14 +41,14 @@ double getTriangleAngle(const Vec3d & v0, const Vec3d & v1, const Vec3d & v2)
 
   Vec3d e1 = v1 - v0, e2 = v2 - v0;
   double cosAngle = dot(e1, e2) / (len(e1) * len(e2));
-  cosAngle = clamp(cosAngle, -1.0, 1.0);
+  cosAngle = ::clamp(cosAngle, -1.0, 1.0);
   return acos(cosAngle);
 }
 
 double getVectorAngle(const Vec3d & vec1, const Vec3d vec2)
 {
   double cosAngle = dot(vec1, vec2) / sqrt(len2(vec1) * len2(vec2));
-  cosAngle = clamp(cosAngle, -1.0, 1.0);
+  cosAngle = ::clamp(cosAngle, -1.0, 1.0);
   return acos(cosAngle);
 }
 
@@ -61,7 +61,7 @@ double getTriangleAngleRobust(const Vec3d & v0, const Vec3d & v1, const Vec3d &
   if (l2e1 > 0 && l2e2 > 0)
   {
     double cosAlpha = dot(e1,e2) / sqrt(l2e1 * l2e2);
-    cosAlpha = clamp(cosAlpha, -1.0, 1.0);
+    cosAlpha = ::clamp(cosAlpha, -1.0, 1.0);
     alpha = acos(cosAlpha);
   }
   else if (l2e1 == 0 && l2e2 == 0)
@@ -37,14 +37,65 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <queue>
+#include <random>
 #include "matrixIO.h"
 #include "graph.h"
+#include "../../ThreadPool.h"
 using namespace std;
 
+namespace
+{
+  // Builds compressed rows from (row, column) pairs; forEachPair(emit) must call emit(row, column) for every pair,
+  // the same way both times it is called. Each row ends up sorted, without duplicates.
+  template<typename ForEachPair>
+  void BuildRows(int numRows, const ForEachPair & forEachPair, vector<int> & starts, vector<int> & columns)
+  {
+    // counting sort by row
+    starts.assign(numRows + 1, 0);
+    forEachPair([&](int row, int) { starts[row+1]++; });
+    for(int row=0; row<numRows; row++)
+      starts[row+1] += starts[row];
+
+    columns.resize(starts[numRows]);
+    vector<int> fill(starts.begin(), starts.end() - 1);
+    forEachPair([&](int row, int column) { columns[fill[row]++] = column; });
+
+    // sort each row and drop its duplicates, then close the gaps
+    vector<int> rowSizes(numRows);
+    ThreadPool::Get().ParallelFor(0, numRows, 4096, [&](int begin, int end)
+    {
+      for(int row=begin; row<end; row++)
+      {
+        int * first = columns.data() + starts[row];
+        int * last = columns.data() + starts[row+1];
+        if (!is_sorted(first, last))
+          sort(first, last);
+        rowSizes[row] = (int)(unique(first, last) - first);
+      }
+    });
+
+    int size = 0;
+    for(int row=0; row<numRows; row++)
+    {
+      int rowStart = starts[row];
+      starts[row] = size;
+      if (rowStart != size)
+        copy(columns.begin() + rowStart, columns.begin() + rowStart + rowSizes[row], columns.begin() + size);
+      size += rowSizes[row];
+    }
+    starts[numRows] = size;
+    columns.resize(size);
+  }
+}
+
 Graph::Graph() 
 { 
   numVertices = 0; 
   numEdges = 0; 
+  neighborStarts.assign(1, 0);
 }
 
 Graph::Graph(const Graph & graph) 
@@ -57,8 +108,8 @@ Graph & Graph::operator=(const Graph & graph)
   numVertices = graph.numVertices;
   numEdges = graph.numEdges;
   edges = graph.edges;
-  vertexNeighbors = graph.vertexNeighbors;
-  vertexNeighborsVector = graph.vertexNeighborsVector;
+  neighborStarts = graph.neighborStarts;
+  neighbors = graph.neighbors;
   return *this;
 }
 
@@ -69,17 +120,34 @@ Graph::~Graph()
 Graph::Graph(int numVertices_, int numEdges_, const int * edges_, int sortEdgeVertices): numVertices(numVertices_), numEdges(numEdges_)
 {
   //printf("num vertices: %d\n", numVertices);
+  vector<pair<int, int> > edgeList(numEdges);
   for(int i=0; i<numEdges; i++)
   {
     //printf("Edge: %d %d\n", edges_[2*i+0], edges_[2*i+1]);
     const int * edge = edges_ + 2*i;
     if (sortEdgeVertices && (edge[0] > edge[1])) // keep the two indices in each edge sorted
-      edges.insert(make_pair(edge[1], edge[0])); 
+      edgeList[i] = make_pair(edge[1], edge[0]); 
     else
-      edges.insert(make_pair(edge[0], edge[1])); 
+      edgeList[i] = make_pair(edge[0], edge[1]); 
   }
 
-  BuildVertexNeighbors();
+  SetEdges(edgeList);
+}
+
+Graph::Graph(int numVertices_, const vector<pair<int, int> > & edges_, int sortEdgeVertices): numVertices(numVertices_)
+{
+  if (sortEdgeVertices)
+  {
+    vector<pair<int, int> > edgeList(edges_);
+    for(size_t i=0; i<edgeList.size(); i++)
+      if (edgeList[i].first > edgeList[i].second) // keep the two indices in each edge sorted
+        swap(edgeList[i].first, edgeList[i].second);
+    SetEdges(edgeList);
+  }
+  else
+    SetEdges(edges_);
+
+  numEdges = edges.size();
 }
 
 Graph::Graph(const char * filename, int sortEdgeVertices)
@@ -91,6 +159,7 @@ Graph::Graph(const char * filename, int sortEdgeVertices)
     throw 1;
 
   //printf("num vertices: %d\n", numVertices);
+  vector<pair<int, int> > edgeList(numEdges);
   for(int i=0; i<numEdges; i++)
   {
     int vtxA, vtxB;
@@ -101,19 +170,20 @@ Graph::Graph(const char * filename, int sortEdgeVertices)
     //printf("Edge: %d %d\n", vtxA, vtxB);
     // keep the two indices in each edge sorted
     if (sortEdgeVertices && (vtxA > vtxB))
-      edges.insert(make_pair(vtxB, vtxA));
+      edgeList[i] = make_pair(vtxB, vtxA);
     else
-      edges.insert(make_pair(vtxA, vtxB));
+      edgeList[i] = make_pair(vtxA, vtxB);
   }
 
   fclose(fin);
 
-  BuildVertexNeighbors();
+  SetEdges(edgeList);
 }
 
 Graph::Graph(const SparseMatrix * matrix)
 {
   numVertices = matrix->GetNumRows();
+  vector<pair<int, int> > edgeList;
   for(int row = 0; row < matrix->GetNumRows(); row++)
   {
     int rowLen = matrix->GetRowLength(row);
@@ -121,14 +191,13 @@ Graph::Graph(const SparseMatrix * matrix)
     {
       int col = matrix->GetColumnIndex(row, j);
       if (row < col)
-        edges.insert(make_pair(row, col));
+        edgeList.push_back(make_pair(row, col));
       else
-        edges.insert(make_pair(col, row));
+        edgeList.push_back(make_pair(col, row));
     }
   }
+  SetEdges(edgeList);
   numEdges = edges.size();
-
-  BuildVertexNeighbors();
 }
 
 void Graph::Save(const char * filename) const
@@ -137,7 +206,7 @@ void Graph::Save(const char * filename) const
   OpenFile_(filename, &fout, "w");
   fprintf(fout, "%d %d\n", numVertices, numEdges);
 
-  for(set<pair<int, int> > :: iterator iter = edges.begin(); iter != edges.end(); iter++)
+  for(vector<pair<int, int> > :: const_iterator iter = edges.begin(); iter != edges.end(); iter++)
   {
     int vtxA = iter->first;
     int vtxB = iter->second;
@@ -147,46 +216,42 @@ void Graph::Save(const char * filename) const
   fclose(fout);
 }
 
-void Graph::BuildVertexNeighbors()
+void Graph::SetEdges(const vector<pair<int, int> > & edgeList)
 {
-  vertexNeighbors.assign(numVertices, map<int, int>());
-
-  for(set<pair<int,int> > :: iterator iter = edges.begin(); iter != edges.end(); iter++)
+  // rows by the first vertex, read back in order
+  vector<int> starts, columns;
+  BuildRows(numVertices, [&](const auto & emit)
   {
-    vertexNeighbors[iter->first].insert(make_pair(iter->second,0)); 
-    vertexNeighbors[iter->second].insert(make_pair(iter->first,0)); 
-  }
+    for(size_t i=0; i<edgeList.size(); i++)
+      emit(edgeList[i].first, edgeList[i].second);
+  }, starts, columns);
 
-  // number the neighbors
-  for(int i=0; i<numVertices; i++)
-  {
-    int count = 0;
-    for(map<int,int> :: iterator iter = vertexNeighbors[i].begin(); iter != vertexNeighbors[i].end(); iter++)
-    {
-      iter->second = count;
-      count++;
-    }
-  }
+  edges.resize(columns.size());
+  for(int vtx=0; vtx<numVertices; vtx++)
+    for(int k=starts[vtx]; k<starts[vtx+1]; k++)
+      edges[k] = make_pair(vtx, columns[k]);
 
-  BuildVertexNeighborsVector();
+  BuildVertexNeighbors();
 }
 
-void Graph::BuildVertexNeighborsVector()
+void Graph::BuildVertexNeighbors()
 {
-  vertexNeighborsVector.assign(numVertices, vector<int>());
-
-  // create a copy of the data (in a vector), so that can access ith element fast
-  for(int i=0; i<numVertices; i++)
-    for(map<int,int> :: iterator iter = vertexNeighbors[i].begin(); iter != vertexNeighbors[i].end(); iter++)
-      vertexNeighborsVector[i].push_back(iter->first);
+  BuildRows(numVertices, [&](const auto & emit)
+  {
+    for(size_t i=0; i<edges.size(); i++)
+    {
+      emit(edges[i].first, edges[i].second);
+      emit(edges[i].second, edges[i].first);
+    }
+  }, neighborStarts, neighbors);
 }
 
 int Graph::GetMaxDegree() const
 {
   int maxDegree = 0;
   for(int vtx=0; vtx<numVertices; vtx++)
-    if ((int)vertexNeighbors[vtx].size() > maxDegree)
-      maxDegree = vertexNeighbors[vtx].size();
+    if (GetNumNeighbors(vtx) > maxDegree)
+      maxDegree = GetNumNeighbors(vtx);
   return maxDegree;
 }
 
@@ -194,8 +259,8 @@ int Graph::GetMinDegree() const
 {
   int minDegree = INT_MAX;
   for(int vtx=0; vtx<numVertices; vtx++)
-    if ((int)vertexNeighbors[vtx].size() < minDegree)
-      minDegree = vertexNeighbors[vtx].size();
+    if (GetNumNeighbors(vtx) < minDegree)
+      minDegree = GetNumNeighbors(vtx);
   return minDegree;
 }
 
@@ -203,7 +268,7 @@ double Graph::GetAvgDegree() const
 {
   double avgDegree = 0;
   for(int vtx=0; vtx<numVertices; vtx++)
-    avgDegree += vertexNeighbors[vtx].size();
+    avgDegree += GetNumNeighbors(vtx);
   return avgDegree / numVertices;
 }
 
@@ -212,17 +277,19 @@ double Graph::GetStdevDegree() const
   double avgDegree_ = GetAvgDegree();
   double std = 0;
   for(int vtx=0; vtx<numVertices; vtx++)
-    std += (vertexNeighbors[vtx].size() - avgDegree_) * (vertexNeighbors[vtx].size() - avgDegree_);
+    std += (GetNumNeighbors(vtx) - avgDegree_) * (GetNumNeighbors(vtx) - avgDegree_);
   return sqrt(std / numVertices);
 }
 
 int Graph::IsNeighbor(int vtx1, int vtx2) const
 {
-  map<int,int> :: const_iterator iter = vertexNeighbors[vtx1].find(vtx2);
-  if (iter == vertexNeighbors[vtx1].end())
+  const int * first = neighbors.data() + neighborStarts[vtx1];
+  const int * last = neighbors.data() + neighborStarts[vtx1+1];
+  const int * iter = lower_bound(first, last, vtx2);
+  if ((iter == last) || (*iter != vtx2))
     return 0;
   else
-    return iter->second + 1;
+    return (int)(iter - first) + 1;
 }
 
 std::map<int,int> Graph::GetNeighborhoodWithDistance(int vertex, int neighborhoodSize)
@@ -269,30 +336,46 @@ std::map<int,int> Graph::GetNeighborhoodWithDistance(const std::set<int> & seedV
 
 void Graph::ExpandNeighbors()
 {
-  // over all edges:
-  // insert neigbors of every vtx into the edges
-
-  set<pair<int, int> > expandedEdges = edges;
-
-  for(set<pair<int, int> > :: iterator iter = edges.begin(); iter != edges.end(); iter++)
+  // the new edges (A, B), A < B, connect every vertex A to the neighbors B of its neighbors;
+  // each chunk of vertices A collects its edges separately, in order
+  const int verticesPerChunk = 4096;
+  int numChunks = (numVertices + verticesPerChunk - 1) / verticesPerChunk;
+  vector<vector<pair<int, int> > > chunkEdges(numChunks);
+  ThreadPool::Get().ParallelFor(0, numChunks, 1, [&](int chunkBegin, int chunkEnd)
   {
-    int vtxA = iter->first; 
-    int vtxB = iter->second; 
-
-    // connect all neighbors of A to B
-    for(map<int,int> :: iterator mapIter = vertexNeighbors[vtxA].begin(); mapIter != vertexNeighbors[vtxA].end(); mapIter++)
+    vector<int> row;
+    for(int c=chunkBegin; c<chunkEnd; c++)
     {
-      if (vtxB < mapIter->first)
-        expandedEdges.insert(make_pair(vtxB, mapIter->first)); 
+      int vtxEnd = min(numVertices, (c + 1) * verticesPerChunk);
+      for(int vtxA = c * verticesPerChunk; vtxA < vtxEnd; vtxA++)
+      {
+        row.clear();
+        for(int j=neighborStarts[vtxA]; j<neighborStarts[vtxA+1]; j++)
+        {
+          int neighbor = neighbors[j];
+          for(int k=neighborStarts[neighbor]; k<neighborStarts[neighbor+1]; k++)
+            if (vtxA < neighbors[k])
+              row.push_back(neighbors[k]);
+        }
+        sort(row.begin(), row.end());
+        row.erase(unique(row.begin(), row.end()), row.end());
+
+        for(size_t k=0; k<row.size(); k++)
+          chunkEdges[c].push_back(make_pair(vtxA, row[k]));
+      }
     }
+  });
 
-    // connect all neigbhors of B to A
-    for(map<int,int> :: iterator mapIter = vertexNeighbors[vtxB].begin(); mapIter != vertexNeighbors[vtxB].end(); mapIter++)
-      if (vtxA < mapIter->first)
-        expandedEdges.insert(make_pair(vtxA, mapIter->first)); 
-  }
+  vector<pair<int, int> > newEdges;
+  for(int c=0; c<numChunks; c++)
+    newEdges.insert(newEdges.end(), chunkEdges[c].begin(), chunkEdges[c].end());
+
+  // both lists are sorted and without duplicates
+  vector<pair<int, int> > expandedEdges;
+  expandedEdges.reserve(edges.size() + newEdges.size());
+  set_union(edges.begin(), edges.end(), newEdges.begin(), newEdges.end(), back_inserter(expandedEdges));
  
-  edges = expandedEdges;
+  edges.swap(expandedEdges);
   numEdges = edges.size();
   BuildVertexNeighbors();
 }
@@ -312,7 +395,7 @@ void Graph::GetLaplacian(SparseMatrix ** L, int scaleRows) const
   SparseMatrixOutline outline(3*numVertices);
   for(int i=0; i<numVertices; i++)
   {
-    int numNeighbors = (int)vertexNeighborsVector[i].size();
+    int numNeighbors = GetNumNeighbors(i);
     if (numNeighbors == 0)
       continue;
 
@@ -327,7 +410,7 @@ void Graph::GetLaplacian(SparseMatrix ** L, int scaleRows) const
 
     for(int j=0; j<numNeighbors; j++)
       for(int k=0; k<3; k++)
-        outline.AddEntry(3 * i + k, 3 * vertexNeighborsVector[i][j] + k, weight);
+        outline.AddEntry(3 * i + k, 3 * GetNeighbor(i, j) + k, weight);
   }
 
   *L = new SparseMatrix(&outline);
@@ -348,23 +431,22 @@ Graph * Graph::CartesianProduct(Graph & graph2) const
     for(int i=0; i<numVertices; i++)
     {
       // connect every vertex of graph1 to its neighbors
-      //std::vector< std::vector<int> > vertexNeighborsVector;
-      for(int k=0; k<(int)vertexNeighborsVector[i].size(); k++)
+      for(int k=0; k<GetNumNeighbors(i); k++)
       {  
-        if (i > vertexNeighborsVector[i][k])
+        if (i > GetNeighbor(i, k))
         {
           productEdges[2*edge+0] = GetCartesianProductVertexIndex(i, j);
-          productEdges[2*edge+1] = GetCartesianProductVertexIndex(vertexNeighborsVector[i][k], j);
+          productEdges[2*edge+1] = GetCartesianProductVertexIndex(GetNeighbor(i, k), j);
           edge++;
         }
       }
       // connect every vertex of graph2 to its neighbors
-      for(int k=0; k<(int)(graph2.vertexNeighborsVector[j].size()); k++)
+      for(int k=0; k<graph2.GetNumNeighbors(j); k++)
       {  
-        if (j > graph2.vertexNeighborsVector[j][k])
+        if (j > graph2.GetNeighbor(j, k))
         {
           productEdges[2*edge+0] = GetCartesianProductVertexIndex(i, j);
-          productEdges[2*edge+1] = GetCartesianProductVertexIndex(i, graph2.vertexNeighborsVector[j][k]);
+          productEdges[2*edge+1] = GetCartesianProductVertexIndex(i, graph2.GetNeighbor(j, k));
           edge++;
         }
       }
@@ -402,9 +484,9 @@ void Graph::Cluster(const set<int> & vertices, vector<set<int> > & clusters) con
       for(size_t i = 0; i < oldFront.size(); i++)
       {
         int node = oldFront[i];
-        for(size_t j = 0; j < vertexNeighborsVector[node].size(); j++)
+        for(int j = neighborStarts[node]; j < neighborStarts[node+1]; j++)
         {
-          int neighbor = vertexNeighborsVector[node][j];
+          int neighbor = neighbors[j];
           if (remainingVertices.find(neighbor) != remainingVertices.end())
           {
             front.push_back(neighbor);
@@ -431,37 +513,126 @@ void Graph::GetCartesianProductVertexIndexComponents(int productVertex, int * ve
 
 void Graph::ShortestDistance(const std::set<int> & seedVertices, std::vector<int> & distances) const
 {
-  distances.assign(numVertices, INT_MAX);
-  for(set<int> :: const_iterator iter = seedVertices.begin(); iter != seedVertices.end(); iter++)
-    distances[*iter] = 0;
+  ShortestDistance(vector<int>(seedVertices.begin(), seedVertices.end()), distances);
+}
 
-  int distance = 0;
-  vector<int> oldFront, front;
-  oldFront.reserve(numVertices);
-  front.reserve(numVertices);
-  oldFront.insert(oldFront.end(), seedVertices.begin(), seedVertices.end());
-  while (oldFront.size() > 0)
+void Graph::ShortestDistance(const std::vector<int> & seedVertices, std::vector<int> & distances) const
+{
+  // the search runs on atomics, so that the parallel steps can claim vertices
+  unique_ptr<atomic<int>[]> level(new atomic<int>[numVertices]);
+  ThreadPool::Get().ParallelFor(0, numVertices, 16384, [&](int begin, int end)
   {
-    distance++;
+    for(int vtx=begin; vtx<end; vtx++)
+      level[vtx].store(INT_MAX, memory_order_relaxed);
+  });
 
-    // create the front
-    front.clear();
-    for(size_t i = 0; i < oldFront.size(); i++)
+  vector<int> front;
+  for(size_t i=0; i<seedVertices.size(); i++)
+  {
+    int seed = seedVertices[i];
+    if (level[seed].load(memory_order_relaxed) != 0)
     {
-      int node = oldFront[i];
-      for(size_t j = 0; j < vertexNeighborsVector[node].size(); j++)
+      level[seed].store(0, memory_order_relaxed);
+      front.push_back(seed);
+    }
+  }
+
+  // switch to bottom-up once the front has more edges than 1/alpha of the unvisited vertices, back to
+  // top-down once it has fewer than 1/beta of all vertices (Beamer et al. 2012); a bottom-up step scans
+  // all vertices, so smaller fronts (as in meshes, which have a large diameter) always go top-down
+  const long long alpha = 14, beta = 24;
+  long long unvisitedEdges = neighbors.size();
+  for(size_t i=0; i<front.size(); i++)
+    unvisitedEdges -= GetNumNeighbors(front[i]);
+  bool bottomUp = false;
+
+  // each chunk collects the vertices it discovers separately
+  const int verticesPerChunk = 4096, frontPerChunk = 256;
+  vector<vector<int> > chunkFronts;
+
+  for(int distance = 1; front.size() > 0; distance++)
+  {
+    long long frontEdges = 0;
+    for(size_t i=0; i<front.size(); i++)
+      frontEdges += GetNumNeighbors(front[i]);
+
+    bool largeFront = ((long long)front.size() >= numVertices / beta);
+    if (!bottomUp && largeFront && (frontEdges > unvisitedEdges / alpha))
+      bottomUp = true;
+    else if (bottomUp && !largeFront)
+      bottomUp = false;
+
+    int numChunks;
+    if (bottomUp)
+    {
+      // every unvisited vertex looks for a neighbor in the front
+      numChunks = (numVertices + verticesPerChunk - 1) / verticesPerChunk;
+      if ((int)chunkFronts.size() < numChunks)
+        chunkFronts.resize(numChunks);
+      ThreadPool::Get().ParallelFor(0, numChunks, 1, [&](int chunkBegin, int chunkEnd)
       {
-        int neighbor = vertexNeighborsVector[node][j];
-        if (distances[neighbor] == INT_MAX)
+        for(int c=chunkBegin; c<chunkEnd; c++)
         {
-          front.push_back(neighbor);
-          distances[neighbor] = distance;
+          chunkFronts[c].clear();
+          int vtxEnd = min(numVertices, (c + 1) * verticesPerChunk);
+          for(int vtx = c * verticesPerChunk; vtx < vtxEnd; vtx++)
+          {
+            if (level[vtx].load(memory_order_relaxed) != INT_MAX)
+              continue;
+            for(int j=neighborStarts[vtx]; j<neighborStarts[vtx+1]; j++)
+            {
+              if (level[neighbors[j]].load(memory_order_relaxed) == distance - 1)
+              {
+                level[vtx].store(distance, memory_order_relaxed);
+                chunkFronts[c].push_back(vtx);
+                break;
+              }
+            }
+          }
         }
-      }
+      });
+    }
+    else
+    {
+      // every front vertex claims its unvisited neighbors
+      numChunks = ((int)front.size() + frontPerChunk - 1) / frontPerChunk;
+      if ((int)chunkFronts.size() < numChunks)
+        chunkFronts.resize(numChunks);
+      ThreadPool::Get().ParallelFor(0, numChunks, 1, [&](int chunkBegin, int chunkEnd)
+      {
+        for(int c=chunkBegin; c<chunkEnd; c++)
+        {
+          chunkFronts[c].clear();
+          int frontEnd = min((int)front.size(), (c + 1) * frontPerChunk);
+          for(int i = c * frontPerChunk; i < frontEnd; i++)
+          {
+            int node = front[i];
+            for(int j=neighborStarts[node]; j<neighborStarts[node+1]; j++)
+            {
+              int neighbor = neighbors[j];
+              int unvisited = INT_MAX;
+              if ((level[neighbor].load(memory_order_relaxed) == INT_MAX) &&
+                  level[neighbor].compare_exchange_strong(unvisited, distance, memory_order_relaxed))
+                chunkFronts[c].push_back(neighbor);
+            }
+          }
+        }
+      });
     }
 
-    oldFront = front; 
+    front.clear();
+    for(int c=0; c<numChunks; c++)
+      front.insert(front.end(), chunkFronts[c].begin(), chunkFronts[c].end());
+    for(size_t i=0; i<front.size(); i++)
+      unvisitedEdges -= GetNumNeighbors(front[i]);
   }
+
+  distances.resize(numVertices);
+  ThreadPool::Get().ParallelFor(0, numVertices, 16384, [&](int begin, int end)
+  {
+    for(int vtx=begin; vtx<end; vtx++)
+      distances[vtx] = level[vtx].load(memory_order_relaxed);
+  });
 }
 
 bool Graph::FindShortestPath(const std::set<int> & seedVertices, const std::set<int> & destinationVertices, std::vector<int> * path) const
@@ -492,9 +663,9 @@ bool Graph::FindShortestPath(const std::set<int> & seedVertices, const std::set<
     for(size_t i = 0; i < oldFront.size(); i++)
     {
       int node = oldFront[i];
-      for(size_t j = 0; j < vertexNeighborsVector[node].size(); j++)
+      for(int j = neighborStarts[node]; j < neighborStarts[node+1]; j++)
       {
-        int neighbor = vertexNeighborsVector[node][j];
+        int neighbor = neighbors[j];
         if (parentNode.find(neighbor) == parentNode.end())
         {
           front.push_back(neighbor);
@@ -555,9 +726,9 @@ bool Graph::FindLocalShortestPath(const std::set<int> & localVertices, const std
     for(size_t i = 0; i < oldFront.size(); i++)
     {
       int node = oldFront[i];
-      for(size_t j = 0; j < vertexNeighborsVector[node].size(); j++)
+      for(int j = neighborStarts[node]; j < neighborStarts[node+1]; j++)
       {
-        int neighbor = vertexNeighborsVector[node][j];
+        int neighbor = neighbors[j];
         if (localVertices.find(neighbor) == localVertices.end())
           continue;
         if (parentNode.find(neighbor) == parentNode.end())
@@ -592,25 +763,590 @@ bool Graph::FindLocalShortestPath(const std::set<int> & localVertices, const std
 
 void Graph::GetConnectedComponent(int vtx, std::set<int> &connectedVertices) const
 {
-  std::vector<int> Q;
-  std::set<int> visited;
-  size_t start = 0;
+  vector<int> distances;
+  ShortestDistance(vector<int>(1, vtx), distances);
+
+  // ascending, so each insertion is at the end
+  connectedVertices.clear();
+  for (int v = 0; v < numVertices; v++)
+    if (distances[v] != INT_MAX)
+      connectedVertices.insert(connectedVertices.end(), v);
+}
+
+// === partitioning ===
+
+namespace
+{
+  // a graph with vertex and edge weights, in compressed rows (unsorted), for the multilevel partitioner
+  struct WeightedGraph
+  {
+    int numVertices;
+    vector<int> starts, adjacency, edgeWeights, vertexWeights;
+    long long totalWeight;
+    int maxVertexWeight;
+  };
+
+  void SetWeightTotals(WeightedGraph & graph)
+  {
+    graph.totalWeight = 0;
+    graph.maxVertexWeight = 0;
+    for(int v=0; v<graph.numVertices; v++)
+    {
+      graph.totalWeight += graph.vertexWeights[v];
+      graph.maxVertexWeight = max(graph.maxVertexWeight, graph.vertexWeights[v]);
+    }
+  }
+
+  // Heavy-edge matching: each vertex, in random order, is merged with the unmatched neighbor it shares the heaviest
+  // edge with, unless the merged weight would exceed maxVertexWeight. coarseVertex[v] = the vertex of coarse containing v.
+  void Coarsen(const WeightedGraph & fine, int maxVertexWeight, mt19937 & rng, WeightedGraph & coarse, vector<int> & coarseVertex)
+  {
+    int n = fine.numVertices;
+    vector<int> order(n);
+    for(int v=0; v<n; v++)
+      order[v] = v;
+    shuffle(order.begin(), order.end(), rng);
+
+    vector<int> match(n, -1);
+    for(int k=0; k<n; k++)
+    {
+      int u = order[k];
+      if (match[u] >= 0)
+        continue;
+
+      int mate = u, mateEdgeWeight = 0;
+      for(int j=fine.starts[u]; j<fine.starts[u+1]; j++)
+      {
+        int v = fine.adjacency[j];
+        if ((match[v] < 0) && (fine.edgeWeights[j] > mateEdgeWeight) && (fine.vertexWeights[u] + fine.vertexWeights[v] <= maxVertexWeight))
+        {
+          mate = v;
+          mateEdgeWeight = fine.edgeWeights[j];
+        }
+      }
+      match[u] = mate;
+      match[mate] = u;
+    }
+
+    // number the pairs, then merge their rows: the edge inside a pair is dropped, parallel edges add up
+    coarseVertex.assign(n, -1);
+    vector<int> members;
+    for(int u=0; u<n; u++)
+    {
+      if (coarseVertex[u] >= 0)
+        continue;
+      coarseVertex[u] = coarseVertex[match[u]] = (int)(members.size() / 2);
+      members.push_back(u);
+      members.push_back(match[u]);
+    }
+
+    coarse.numVertices = (int)(members.size() / 2);
+    coarse.starts.assign(coarse.numVertices + 1, 0);
+    coarse.vertexWeights.assign(coarse.numVertices, 0);
+    coarse.adjacency.clear();
+    coarse.edgeWeights.clear();
+    vector<int> position(coarse.numVertices, -1);
+    for(int c=0; c<coarse.numVertices; c++)
+    {
+      int rowStart = (int) coarse.adjacency.size();
+      for(int m=0; m<2; m++)
+      {
+        int u = members[2*c+m];
+        if ((m == 1) && (u == members[2*c]))
+          break;
+        coarse.vertexWeights[c] += fine.vertexWeights[u];
+        for(int j=fine.starts[u]; j<fine.starts[u+1]; j++)
+        {
+          int cv = coarseVertex[fine.adjacency[j]];
+          if (cv == c)
+            continue;
+          // positions before rowStart are left over from earlier rows
+          if ((position[cv] >= rowStart) && (coarse.adjacency[position[cv]] == cv))
+            coarse.edgeWeights[position[cv]] += fine.edgeWeights[j];
+          else
+          {
+            position[cv] = (int) coarse.adjacency.size();
+            coarse.adjacency.push_back(cv);
+            coarse.edgeWeights.push_back(fine.edgeWeights[j]);
+          }
+        }
+      }
+      coarse.starts[c+1] = (int) coarse.adjacency.size();
+    }
+    SetWeightTotals(coarse);
+  }
+
+  long long ComputeCut(const WeightedGraph & graph, const vector<char> & side)
+  {
+    long long cut = 0;
+    for(int v=0; v<graph.numVertices; v++)
+      for(int j=graph.starts[v]; j<graph.starts[v+1]; j++)
+        if (side[v] != side[graph.adjacency[j]])
+          cut += graph.edgeWeights[j];
+    return cut / 2;
+  }
+
+  // how far the two sides are over their maximum weights
+  long long Overweight(const long long weights[2], const long long maxWeights[2])
+  {
+    return max(weights[0] - maxWeights[0], 0LL) + max(weights[1] - maxWeights[1], 0LL);
+  }
+
+  // Fiduccia-Mattheyses: each pass moves the unlocked vertex with the largest cut reduction (gain) that the balance
+  // allows, locks it, and in the end keeps the best prefix of the moves (least overweight, then least cut);
+  // within a pass, a side may go over its maximum by one vertex (which the next move then has to take back), so that
+  // tightly balanced bisections can still swap vertices
+  void RefineBisection(const WeightedGraph & graph, vector<char> & side, long long weights[2], const long long maxWeights[2])
+  {
+    int n = graph.numVertices;
+    const int maxPasses = 8;
+    const int maxFruitlessMoves = max(25, n / 100);
+
+    vector<int> gain(n);
+    vector<char> locked(n);
+    vector<int> moves;
+    long long cut = ComputeCut(graph, side);
+
+    for(int pass=0; pass<maxPasses; pass++)
+    {
+      // the candidates of each side, with lazy deletion: an entry is stale if its gain is not the current one
+      priority_queue<pair<int,int> > candidates[2];
+      for(int v=0; v<n; v++)
+      {
+        gain[v] = 0;
+        bool boundary = false;
+        for(int j=graph.starts[v]; j<graph.starts[v+1]; j++)
+        {
+          bool external = (side[graph.adjacency[j]] != side[v]);
+          gain[v] += external ? graph.edgeWeights[j] : -graph.edgeWeights[j];
+          boundary = boundary || external;
+        }
+        if (boundary)
+          candidates[(int)side[v]].push(make_pair(gain[v], v));
+      }
+      fill(locked.begin(), locked.end(), 0);
+      moves.clear();
+
+      long long bestOverweight = Overweight(weights, maxWeights), bestCut = cut;
+      int bestMoves = 0, fruitlessMoves = 0;
+      while (fruitlessMoves < maxFruitlessMoves)
+      {
+        // the top valid candidate of each side that (nearly) fits the other side
+        int top[2] = { -1, -1 };
+        for(int s=0; s<2; s++)
+        {
+          while (!candidates[s].empty())
+          {
+            int v = candidates[s].top().second;
+            if (locked[v] || (side[v] != s) || (candidates[s].top().first != gain[v]))
+              candidates[s].pop();
+            else
+              break;
+          }
+          if (!candidates[s].empty())
+          {
+            int v = candidates[s].top().second;
+            if (weights[1-s] + graph.vertexWeights[v] <= maxWeights[1-s] + graph.maxVertexWeight)
+              top[s] = v;
+          }
+        }
+
+        // an overweight side has to give, else the larger gain goes
+        int from;
+        if (weights[0] > maxWeights[0])
+          from = 0;
+        else if (weights[1] > maxWeights[1])
+          from = 1;
+        else if ((top[0] >= 0) && (top[1] >= 0))
+          from = (gain[top[0]] >= gain[top[1]]) ? 0 : 1;
+        else
+          from = (top[0] >= 0) ? 0 : 1;
+
+        int v = top[from];
+        if ((v < 0) && (weights[from] > maxWeights[from]) && !candidates[from].empty())
+          v = candidates[from].top().second; // does not fit, but reduces the excess
+        if (v < 0)
+          break;
+        candidates[from].pop();
+
+        side[v] = (char)(1 - from);
+        weights[from] -= graph.vertexWeights[v];
+        weights[1-from] += graph.vertexWeights[v];
+        cut -= gain[v];
+        gain[v] = -gain[v];
+        locked[v] = 1;
+        moves.push_back(v);
+
+        for(int j=graph.starts[v]; j<graph.starts[v+1]; j++)
+        {
+          int u = graph.adjacency[j];
+          gain[u] += (side[u] == side[v]) ? -2 * graph.edgeWeights[j] : 2 * graph.edgeWeights[j];
+          if (!locked[u])
+            candidates[(int)side[u]].push(make_pair(gain[u], u));
+        }
+
+        long long overweight = Overweight(weights, maxWeights);
+        if ((overweight < bestOverweight) || ((overweight == bestOverweight) && (cut < bestCut)))
+        {
+          bestOverweight = overweight;
+          bestCut = cut;
+          bestMoves = (int) moves.size();
+          fruitlessMoves = 0;
+        }
+        else
+          fruitlessMoves++;
+      }
+
+      // undo the moves after the best prefix
+      for(int k=(int)moves.size()-1; k>=bestMoves; k--)
+      {
+        int v = moves[k];
+        int from = side[v];
+        side[v] = (char)(1 - from);
+        weights[from] -= graph.vertexWeights[v];
+        weights[1-from] += graph.vertexWeights[v];
+      }
+      cut = bestCut;
+
+      if (bestMoves == 0)
+        break;
+    }
+  }
+
+  // grows side 0 breadth-first from a random vertex until it reaches target0; side 1 is the rest
+  void GrowBisection(const WeightedGraph & graph, double target0, mt19937 & rng, vector<char> & side, long long weights[2])
+  {
+    int n = graph.numVertices;
+    side.assign(n, 1);
+    weights[0] = 0;
+    weights[1] = graph.totalWeight;
+
+    vector<char> queued(n, 0);
+    vector<int> queue;
+    size_t head = 0;
+    int next = (int)(rng() % n);
+    while (weights[0] < target0)
+    {
+      if (head == queue.size())
+      {
+        if (queue.size() == (size_t) n)
+          break;
+        // start (or, for a disconnected graph, restart) from an unvisited vertex
+        while (queued[next])
+          next = (next + 1) % n;
+        queue.push_back(next);
+        queued[next] = 1;
+      }
+      int v = queue[head++];
+      if (weights[0] + graph.vertexWeights[v] > target0 + graph.maxVertexWeight / 2)
+        continue;
+      side[v] = 0;
+      weights[0] += graph.vertexWeights[v];
+      weights[1] -= graph.vertexWeights[v];
+      for(int j=graph.starts[v]; j<graph.starts[v+1]; j++)
+      {
+        int u = graph.adjacency[j];
+        if (!queued[u])
+        {
+          queued[u] = 1;
+          queue.push_back(u);
+        }
+      }
+    }
+  }
+
+  // a side may exceed its target by the ratio imbalance, or (on the coarse levels, where vertices are heavy)
+  // by less than the largest vertex weight
+  void GetMaxWeights(const WeightedGraph & graph, long long total, double target0, double imbalance, long long maxWeights[2])
+  {
+    double targets[2] = { target0, total - target0 };
+    for(int s=0; s<2; s++)
+      maxWeights[s] = max((long long)((1.0 + imbalance) * targets[s]), (long long) ceil(targets[s]) + graph.maxVertexWeight - 1);
+  }
+
+  // multilevel bisection into side 0 of weight ~target0 and side 1 with the rest
+  void Bisect(const WeightedGraph & graph, double target0, double imbalance, mt19937 & rng, vector<char> & side)
+  {
+    const int coarsestSize = 100;
+    const int numInitialTries = 8;
+
+    // coarsen until small, or until matching stops shrinking the graph
+    vector<WeightedGraph> levels;
+    vector<vector<int> > coarseVertices;
+    int maxVertexWeight = max(1, (int)(1.5 * graph.totalWeight / coarsestSize));
+    const WeightedGraph * current = &graph;
+    while (current->numVertices > coarsestSize)
+    {
+      WeightedGraph coarse;
+      vector<int> coarseVertex;
+      Coarsen(*current, maxVertexWeight, rng, coarse, coarseVertex);
+      if (coarse.numVertices > 0.95 * current->numVertices)
+        break;
+      levels.push_back(coarse);
+      coarseVertices.push_back(coarseVertex);
+      current = &levels.back();
+    }
+
+    // the best of several grown and refined bisections of the coarsest graph
+    long long weights[2], maxWeights[2];
+    GetMaxWeights(*current, graph.totalWeight, target0, imbalance, maxWeights);
+    long long bestOverweight = LLONG_MAX, bestCut = LLONG_MAX;
+    vector<char> trySide;
+    for(int t=0; t<numInitialTries; t++)
+    {
+      GrowBisection(*current, target0, rng, trySide, weights);
+      RefineBisection(*current, trySide, weights, maxWeights);
+      long long overweight = Overweight(weights, maxWeights);
+      long long cut = ComputeCut(*current, trySide);
+      if ((overweight < bestOverweight) || ((overweight == bestOverweight) && (cut < bestCut)))
+      {
+        bestOverweight = overweight;
+        bestCut = cut;
+        side = trySide;
+      }
+    }
+
+    // project back up, refining on every level
+    for(int level=(int)levels.size()-1; level>=0; level--)
+    {
+      const WeightedGraph & fine = (level > 0) ? levels[level-1] : graph;
+      const vector<int> & coarseVertex = coarseVertices[level];
+      vector<char> fineSide(fine.numVertices);
+      weights[0] = weights[1] = 0;
+      for(int v=0; v<fine.numVertices; v++)
+      {
+        fineSide[v] = side[coarseVertex[v]];
+        weights[(int)fineSide[v]] += fine.vertexWeights[v];
+      }
+      side.swap(fineSide);
+      GetMaxWeights(fine, graph.totalWeight, target0, imbalance, maxWeights);
+      RefineBisection(fine, side, weights, maxWeights);
+    }
+  }
+
+  // the subgraph induced by the vertices on the given side; ids maps its vertices to the original graph
+  void ExtractSide(const WeightedGraph & graph, const vector<int> & ids, const vector<char> & side, char s, WeightedGraph & sub, vector<int> & subIds)
+  {
+    vector<int> local(graph.numVertices, -1);
+    subIds.clear();
+    for(int v=0; v<graph.numVertices; v++)
+      if (side[v] == s)
+      {
+        local[v] = (int) subIds.size();
+        subIds.push_back(ids[v]);
+      }
+
+    sub.numVertices = (int) subIds.size();
+    sub.starts.assign(1, 0);
+    sub.adjacency.clear();
+    sub.edgeWeights.clear();
+    sub.vertexWeights.clear();
+    for(int v=0; v<graph.numVertices; v++)
+    {
+      if (side[v] != s)
+        continue;
+      sub.vertexWeights.push_back(graph.vertexWeights[v]);
+      for(int j=graph.starts[v]; j<graph.starts[v+1]; j++)
+        if (local[graph.adjacency[j]] >= 0)
+        {
+          sub.adjacency.push_back(local[graph.adjacency[j]]);
+          sub.edgeWeights.push_back(graph.edgeWeights[j]);
+        }
+      sub.starts.push_back((int) sub.adjacency.size());
+    }
+    SetWeightTotals(sub);
+  }
+
+  // a part of the graph still to be split into parts firstPart, ..., firstPart + numParts - 1
+  struct Subproblem
+  {
+    const WeightedGraph * graph;
+    const vector<int> * ids;
+    int firstPart;
+    int numParts;
+    unsigned int seed;
+  };
+
+  // splits the graph into numParts parts by recursive bisection, one level of the recursion at a time;
+  // all subproblems of a level are bisected in parallel
+  void PartitionRecursively(const WeightedGraph & graph, const vector<int> & ids, int numParts, double imbalance, unsigned int seed, vector<int> & vertexParts)
+  {
+    vector<Subproblem> pending(1, Subproblem{ &graph, &ids, 0, numParts, seed });
+    // the subgraphs the pending subproblems point into (empty on the first level)
+    vector<WeightedGraph> subgraphs;
+    vector<vector<int> > subIds;
+    while (!pending.empty())
+    {
+      int numPending = (int) pending.size();
+      vector<WeightedGraph> nextSubgraphs(2 * numPending);
+      vector<vector<int> > nextSubIds(2 * numPending);
+      ThreadPool::Get().ParallelFor(0, numPending, 1, [&](int begin, int end)
+      {
+        for(int i=begin; i<end; i++)
+        {
+          const Subproblem & sub = pending[i];
+          if ((sub.numParts == 1) || (sub.graph->numVertices == 0))
+          {
+            for(int v=0; v<sub.graph->numVertices; v++)
+              vertexParts[(*sub.ids)[v]] = sub.firstPart;
+            continue;
+          }
+
+          double target0 = (double) sub.graph->totalWeight * (sub.numParts / 2) / sub.numParts;
+          mt19937 rng(sub.seed);
+          vector<char> side;
+          Bisect(*sub.graph, target0, imbalance, rng, side);
+          for(int s=0; s<2; s++)
+            ExtractSide(*sub.graph, *sub.ids, side, (char) s, nextSubgraphs[2*i+s], nextSubIds[2*i+s]);
+        }
+      });
+
+      vector<Subproblem> next;
+      for(int i=0; i<numPending; i++)
+      {
+        const Subproblem & sub = pending[i];
+        if ((sub.numParts == 1) || (sub.graph->numVertices == 0))
+          continue;
+        int numParts0 = sub.numParts / 2;
+        next.push_back(Subproblem{ &nextSubgraphs[2*i], &nextSubIds[2*i], sub.firstPart, numParts0, 2 * sub.seed + 1 });
+        next.push_back(Subproblem{ &nextSubgraphs[2*i+1], &nextSubIds[2*i+1], sub.firstPart + numParts0, sub.numParts - numParts0, 2 * sub.seed + 2 });
+      }
+
+      // swapping keeps the elements in place, so next still points into them
+      pending.swap(next);
+      subgraphs.swap(nextSubgraphs);
+      subIds.swap(nextSubIds);
+    }
+  }
+}
+
+int Graph::Partition(int numParts, std::vector<int> & vertexParts, const std::vector<int> * vertexWeights, double imbalance, unsigned int seed) const
+{
+  vertexParts.assign(numVertices, 0);
+  if ((numParts <= 1) || (numVertices == 0))
+    return 0;
+
+  // unit edge weights, self loops dropped
+  WeightedGraph graph;
+  graph.numVertices = numVertices;
+  graph.starts.assign(1, 0);
+  for(int v=0; v<numVertices; v++)
+  {
+    for(int j=neighborStarts[v]; j<neighborStarts[v+1]; j++)
+      if (neighbors[j] != v)
+        graph.adjacency.push_back(neighbors[j]);
+    graph.starts.push_back((int) graph.adjacency.size());
+  }
+  graph.edgeWeights.assign(graph.adjacency.size(), 1);
+  if (vertexWeights != NULL)
+    graph.vertexWeights = *vertexWeights;
+  else
+    graph.vertexWeights.assign(numVertices, 1);
+  SetWeightTotals(graph);
+
+  vector<int> ids(numVertices);
+  for(int v=0; v<numVertices; v++)
+    ids[v] = v;
+
+  // the allowed excess compounds over the levels of bisection
+  int depth = 0;
+  while ((1 << depth) < numParts)
+    depth++;
+  double bisectionImbalance = pow(1.0 + imbalance, 1.0 / depth) - 1.0;
+  PartitionRecursively(graph, ids, numParts, bisectionImbalance, seed, vertexParts);
+
+  // k-way refinement: boundary vertices greedily move to the neighboring part they have the most edges to,
+  // if that cuts fewer edges and keeps the part within its maximum weight; vertices of a part over its maximum
+  // weight (the slack of the bisections adds up) move to the best neighboring part with room, even if that cuts more
+  vector<long long> partWeights(numParts, 0);
+  for(int v=0; v<numVertices; v++)
+    partWeights[vertexParts[v]] += graph.vertexWeights[v];
+  double averageWeight = (double) graph.totalWeight / numParts;
+  long long maxPartWeight = max((long long)((1.0 + imbalance) * averageWeight), (long long) ceil(averageWeight) + graph.maxVertexWeight - 1);
+
+  const int maxPasses = 8;
+  vector<int> connection(numParts, 0);
+  vector<int> touchedParts;
+  for(int pass=0; pass<maxPasses; pass++)
+  {
+    int numMoves = 0;
+    for(int v=0; v<numVertices; v++)
+    {
+      int part = vertexParts[v];
+      touchedParts.clear();
+      for(int j=graph.starts[v]; j<graph.starts[v+1]; j++)
+      {
+        int neighborPart = vertexParts[graph.adjacency[j]];
+        if (connection[neighborPart] == 0)
+          touchedParts.push_back(neighborPart);
+        connection[neighborPart]++;
+      }
+
+      bool overweight = (partWeights[part] > maxPartWeight);
+      int bestPart = part;
+      for(size_t k=0; k<touchedParts.size(); k++)
+      {
+        int p = touchedParts[k];
+        if ((p == part) || (partWeights[p] + graph.vertexWeights[v] > maxPartWeight))
+          continue;
+        if ((connection[p] > connection[bestPart]) || ((bestPart == part) && overweight))
+          bestPart = p;
+      }
+      for(size_t k=0; k<touchedParts.size(); k++)
+        connection[touchedParts[k]] = 0;
 
-  Q.push_back(vtx);
-  visited.insert(vtx);
+      if (bestPart != part)
+      {
+        partWeights[part] -= graph.vertexWeights[v];
+        partWeights[bestPart] += graph.vertexWeights[v];
+        vertexParts[v] = bestPart;
+        numMoves++;
+      }
+    }
+    if (numMoves == 0)
+      break;
+  }
 
-  while (Q.size() - start > 0) {
-    int v = Q[start];
-    start++;
+  return GetEdgeCut(vertexParts);
+}
 
-    for (int i = 0; i < (int)vertexNeighborsVector[v].size(); i++) {
-      int c = vertexNeighborsVector[v][i];
-      if (visited.find(c) == visited.end()) {
-        Q.push_back(c);
-        visited.insert(c);
+int Graph::GetEdgeCut(const std::vector<int> & vertexParts) const
+{
+  int cut = 0;
+  for(vector<pair<int, int> > :: const_iterator iter = edges.begin(); iter != edges.end(); iter++)
+    if (vertexParts[iter->first] != vertexParts[iter->second])
+      cut++;
+  return cut;
+}
+
+void Graph::GetPartInterfaces(int numParts, const std::vector<int> & vertexParts, std::vector<int> & interfaceStarts, std::vector<int> & interfaceVertices, std::vector<int> & haloStarts, std::vector<int> & haloVertices) const
+{
+  // (part, vertex) pairs, put into rows per part
+  vector<pair<int, int> > interfacePairs, haloPairs;
+  for(int v=0; v<numVertices; v++)
+  {
+    bool isInterface = false;
+    for(int j=neighborStarts[v]; j<neighborStarts[v+1]; j++)
+    {
+      int neighborPart = vertexParts[neighbors[j]];
+      if (neighborPart != vertexParts[v])
+      {
+        isInterface = true;
+        haloPairs.push_back(make_pair(neighborPart, v));
       }
     }
+    if (isInterface)
+      interfacePairs.push_back(make_pair(vertexParts[v], v));
   }
 
-  connectedVertices = visited;
+  BuildRows(numParts, [&](const auto & emit)
+  {
+    for(size_t i=0; i<interfacePairs.size(); i++)
+      emit(interfacePairs[i].first, interfacePairs[i].second);
+  }, interfaceStarts, interfaceVertices);
+  BuildRows(numParts, [&](const auto & emit)
+  {
+    for(size_t i=0; i<haloPairs.size(); i++)
+      emit(haloPairs[i].first, haloPairs[i].second);
+  }, haloStarts, haloVertices);
 }
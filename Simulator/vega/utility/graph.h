@@ -40,6 +40,11 @@
 
 /*
   A class to store an undirected graph (nodes connected with edges).
+
+  The neighbors are stored in compressed rows: the (ascending) neighbors of
+  vertex v are neighbors[neighborStarts[v]], ..., neighbors[neighborStarts[v+1]-1].
+  The traversals that cover the whole graph (ShortestDistance,
+  GetConnectedComponent) use a parallel breadth-first search.
 */
 
 class Graph
@@ -54,6 +59,8 @@ public:
   // if sortEdgeVertices=1, each edge (v0, v1) in edges will be sorted to ensure v0 < v1 
   // before added into internal data
   Graph(int numVertices, int numEdges, const int * edges, int sortEdgeVertices=1);
+  // same, with the edges as pairs; duplicates are removed (numEdges is the number of distinct edges)
+  Graph(int numVertices, const std::vector<std::pair<int,int> > & edges, int sortEdgeVertices=1);
 
   // convert a matrix into a graph; numVertices = matrix->GetNumRows()
   // two vtx (v0, v1) share an edge if they have sparse entries at matrix(v0,v1) or matrix(v1,v0)
@@ -103,8 +110,12 @@ public:
 
   // computes the shortest distance from the given seed vertices (distance of zero) to all the graph vertices
   // input: seed vertices
-  // output: distance to the set of seed vertices, for each mesh vertex
+  // output: distance to the set of seed vertices, for each mesh vertex (INT_MAX if not reachable)
   void ShortestDistance(const std::set<int> & seedVertices, std::vector<int> & distances) const;
+  // same, seeds given in any order (duplicates allowed)
+  // a direction-optimizing breadth-first search: large fronts are expanded bottom-up (each unvisited vertex
+  // looks for a neighbor in the front), small ones top-down; both in parallel
+  void ShortestDistance(const std::vector<int> & seedVertices, std::vector<int> & distances) const;
 
   // computes one of the shortest path from seedVertices to one of the destinationVertices
   // return whether the path exists.
@@ -118,15 +129,34 @@ public:
   // find the connected component of vtx
   void GetConnectedComponent(int vtx, std::set<int> & connectedVertices) const;
 
+  // === partitioning ===
+
+  // splits the vertices into numParts parts of about equal weight with few edges between them, by multilevel
+  // recursive bisection: each bisection coarsens the graph by heavy-edge matching, grows a bisection of the
+  // coarsest graph and refines it with Fiduccia-Mattheyses on every level back up; a final greedy k-way pass
+  // moves boundary vertices to the neighboring part they are best connected to
+  // vertexWeights: one positive weight per vertex, NULL = all 1
+  // imbalance: how much a part's weight may exceed the average, relatively (or by less than the largest vertex weight, if that is more)
+  // output: the part of each vertex; returns the number of cut edges
+  // the result only depends on the seed, not on the number of threads
+  int Partition(int numParts, std::vector<int> & vertexParts, const std::vector<int> * vertexWeights = NULL, double imbalance = 0.03, unsigned int seed = 0) const;
+  // the number of edges between different parts
+  int GetEdgeCut(const std::vector<int> & vertexParts) const;
+  // for each part p: the interface, the vertices of p with a neighbor in another part, and the halo, the vertices
+  // of other parts with a neighbor in p; ascending, in compressed rows: the interface of part p is
+  // interfaceVertices[interfaceStarts[p]], ..., interfaceVertices[interfaceStarts[p+1]-1], the halo likewise
+  void GetPartInterfaces(int numParts, const std::vector<int> & vertexParts, std::vector<int> & interfaceStarts, std::vector<int> & interfaceVertices,
+                         std::vector<int> & haloStarts, std::vector<int> & haloVertices) const;
+
 protected:
   int numVertices, numEdges; // num vertices, num edges
-  std::set< std::pair<int, int> > edges;
-  // for each vtx, mapping: vtx index of neighbor [0, numVertices) -> neighbor index [0, #neighbor)
-  std::vector< std::map<int, int> > vertexNeighbors;
-  std::vector< std::vector<int> > vertexNeighborsVector;
+  // the distinct edges, in ascending order
+  std::vector< std::pair<int, int> > edges;
+  // for each vtx, its neighbors in ascending order (see above); neighbor index = position in the row
+  std::vector<int> neighborStarts, neighbors;
 
+  void SetEdges(const std::vector<std::pair<int, int> > & edges); // sorts and removes duplicates, then calls BuildVertexNeighbors
   void BuildVertexNeighbors();
-  void BuildVertexNeighborsVector();
 };
 
 inline int Graph::GetNumVertices() const
@@ -141,12 +171,12 @@ inline int Graph::GetNumEdges() const
 
 inline int Graph::GetNumNeighbors(int vertex) const
 {
-  return (int) vertexNeighborsVector[vertex].size();
+  return neighborStarts[vertex+1] - neighborStarts[vertex];
 }
 
 inline int Graph::GetNeighbor(int vertex, int i) const
 {
-  return vertexNeighborsVector[vertex][i];
+  return neighbors[neighborStarts[vertex] + i];
 }
 
 #endif
@@ -39,8 +39,11 @@
 #include <cmath>
 #include <cassert>
 #include <limits>
+#include <algorithm>
 #include "sparseMatrix.h"
 #include "../utility/constrainedDOFs.h"
+#include "../../ThreadPool.h"
+#include "../../Kernels.h"
 
 using namespace std;
 
@@ -276,22 +279,29 @@ SparseMatrix::SparseMatrix(const char * filename)
   InitFromOutline(&sparseMatrixOutline);
 }
 
-SparseMatrix::SparseMatrix(SparseMatrixOutline * sparseMatrixOutline)
+SparseMatrix::SparseMatrix(SparseMatrixOutline * sparseMatrixOutline, int contiguous)
 {
-  InitFromOutline(sparseMatrixOutline);
+  InitFromOutline(sparseMatrixOutline, contiguous);
 }
 
 // construct matrix from the outline
-void SparseMatrix::InitFromOutline(SparseMatrixOutline * sparseMatrixOutline)
+void SparseMatrix::InitFromOutline(SparseMatrixOutline * sparseMatrixOutline, int contiguous)
 {
   numRows = sparseMatrixOutline->GetNumRows();
   Allocate();
 
   for(int i=0; i<numRows; i++)
-  {
     rowLength[i] = (int)(sparseMatrixOutline->columnEntries[i].size());
-    columnIndices[i] = (int*) malloc (sizeof(int) * rowLength[i]);
-    columnEntries[i] = (double*) malloc (sizeof(double) * rowLength[i]);
+  if (contiguous)
+    AllocateContiguousRows();
+
+  for(int i=0; i<numRows; i++)
+  {
+    if (!contiguous)
+    {
+      columnIndices[i] = (int*) malloc (sizeof(int) * rowLength[i]);
+      columnEntries[i] = (double*) malloc (sizeof(double) * rowLength[i]);
+    }
 
     map<int,double>::iterator pos;
     int j = 0;
@@ -325,6 +335,9 @@ SparseMatrix::SparseMatrix(int numRows_, int * rowLength_, int ** columnIndices_
     superRows = NULL;
     diagonalIndices = NULL;
     transposedIndices = NULL;
+    rowStarts = NULL;
+    contiguousColumnIndices = NULL;
+    contiguousEntries = NULL;
     return;
   }
 
@@ -383,16 +396,96 @@ void SparseMatrix::Allocate()
   superRows = NULL;
   diagonalIndices = NULL;
   transposedIndices = NULL;
+  rowStarts = NULL;
+  contiguousColumnIndices = NULL;
+  contiguousEntries = NULL;
 }
 
-// destructor
-SparseMatrix::~SparseMatrix()
+void SparseMatrix::AllocateContiguousRows()
 {
+  rowStarts = (int*) malloc(sizeof(int) * (numRows + 1));
+  rowStarts[0] = 0;
+  for(int i=0; i<numRows; i++)
+    rowStarts[i+1] = rowStarts[i] + rowLength[i];
+
+  contiguousColumnIndices = (int*) malloc(sizeof(int) * rowStarts[numRows]);
+  contiguousEntries = (double*) malloc(sizeof(double) * rowStarts[numRows]);
+  for(int i=0; i<numRows; i++)
+  {
+    columnIndices[i] = contiguousColumnIndices + rowStarts[i];
+    columnEntries[i] = contiguousEntries + rowStarts[i];
+  }
+}
+
+void SparseMatrix::FreeRows()
+{
+  if (rowStarts != NULL)
+  {
+    free(rowStarts);
+    free(contiguousColumnIndices);
+    free(contiguousEntries);
+    rowStarts = NULL;
+    contiguousColumnIndices = NULL;
+    contiguousEntries = NULL;
+    return;
+  }
+
   for(int i=0; i<numRows; i++)
   {
     free(columnIndices[i]);
     free(columnEntries[i]);
   }
+}
+
+void SparseMatrix::MakeContiguous()
+{
+  if (rowStarts != NULL)
+    return;
+
+  int ** separateColumnIndices = columnIndices;
+  double ** separateColumnEntries = columnEntries;
+  columnIndices = (int**) malloc(sizeof(int*) * numRows);
+  columnEntries = (double**) malloc(sizeof(double*) * numRows);
+  AllocateContiguousRows();
+
+  for(int i=0; i<numRows; i++)
+  {
+    memcpy(columnIndices[i], separateColumnIndices[i], sizeof(int) * rowLength[i]);
+    memcpy(columnEntries[i], separateColumnEntries[i], sizeof(double) * rowLength[i]);
+    free(separateColumnIndices[i]);
+    free(separateColumnEntries[i]);
+  }
+  free(separateColumnIndices);
+  free(separateColumnEntries);
+}
+
+void SparseMatrix::MakeSeparate()
+{
+  if (rowStarts == NULL)
+    return;
+
+  for(int i=0; i<numRows; i++)
+  {
+    int * rowIndices = (int*) malloc(sizeof(int) * rowLength[i]);
+    double * rowEntries = (double*) malloc(sizeof(double) * rowLength[i]);
+    memcpy(rowIndices, columnIndices[i], sizeof(int) * rowLength[i]);
+    memcpy(rowEntries, columnEntries[i], sizeof(double) * rowLength[i]);
+    columnIndices[i] = rowIndices;
+    columnEntries[i] = rowEntries;
+  }
+
+  free(rowStarts);
+  free(contiguousColumnIndices);
+  free(contiguousEntries);
+  rowStarts = NULL;
+  contiguousColumnIndices = NULL;
+  contiguousEntries = NULL;
+}
+
+// destructor
+SparseMatrix::~SparseMatrix()
+{
+  FreeRows();
 
   if (subMatrixIndices != NULL)
   {
@@ -435,12 +528,23 @@ SparseMatrix::SparseMatrix(const SparseMatrix & source)
   rowLength = (int*) malloc(sizeof(int) * numRows);
   columnIndices = (int**) malloc(sizeof(int*) * numRows);
   columnEntries = (double**) malloc(sizeof(double*) * numRows);
+  rowStarts = NULL;
+  contiguousColumnIndices = NULL;
+  contiguousEntries = NULL;
 
+  // same layout as the source
   for(int i=0; i<numRows; i++)
-  {
     rowLength[i] = source.rowLength[i];
-    columnIndices[i] = (int*) malloc (sizeof(int) * rowLength[i]);
-    columnEntries[i] = (double*) malloc (sizeof(double) * rowLength[i]);
+  if (source.rowStarts != NULL)
+    AllocateContiguousRows();
+
+  for(int i=0; i<numRows; i++)
+  {
+    if (source.rowStarts == NULL)
+    {
+      columnIndices[i] = (int*) malloc (sizeof(int) * rowLength[i]);
+      columnEntries[i] = (double*) malloc (sizeof(double) * rowLength[i]);
+    }
 
     for(int j=0; j < rowLength[i]; j++)
     {
@@ -522,41 +626,89 @@ SparseMatrix::SparseMatrix(const SparseMatrix & source)
   }
 }
 
+// the parallel products split the rows into chunks of (at least) this many rows
+static const int rowChunkSize = 1024;
+
 void SparseMatrix::MultiplyVector(int startRow, int endRow, const double * vector, double * result) const // result = A(startRow:endRow-1,:) * vector
 {
-  for(int i=startRow; i<endRow; i++)
+  ThreadPool::Get().ParallelFor(startRow, endRow, rowChunkSize, [&](int begin, int end)
   {
-    result[i-startRow] = 0.0;
-    for(int j=0; j < rowLength[i]; j++)
-      result[i-startRow] += vector[columnIndices[i][j]] * columnEntries[i][j];
-  }
+    if (rowStarts != NULL)
+    {
+      Kernels::SpMV(end - begin, rowStarts + begin, contiguousColumnIndices, contiguousEntries, vector, result + (begin - startRow));
+      return;
+    }
+
+    for(int i=begin; i<end; i++)
+    {
+      double sum = 0.0;
+      for(int j=0; j < rowLength[i]; j++)
+        sum += vector[columnIndices[i][j]] * columnEntries[i][j];
+      result[i-startRow] = sum;
+    }
+  });
 }
 
 void SparseMatrix::MultiplyVector(const double * vector, double * result) const
 {
-  for(int i=0; i<numRows; i++)
-  {
-    result[i] = 0.0;
-    for(int j=0; j < rowLength[i]; j++)
-      result[i] += vector[columnIndices[i][j]] * columnEntries[i][j];
-  }
+  MultiplyVector(0, numRows, vector, result);
 }
 
 void SparseMatrix::MultiplyVectorAdd(const double * vector, double * result) const
 {
-  for(int i=0; i<numRows; i++)
-    for(int j=0; j < rowLength[i]; j++)
-      result[i] += vector[columnIndices[i][j]] * columnEntries[i][j];
+  ThreadPool::Get().ParallelFor(0, numRows, rowChunkSize, [&](int begin, int end)
+  {
+    if (rowStarts != NULL)
+    {
+      // the products of (at most) rowChunkSize rows at a time, then added to the result
+      double rowProducts[rowChunkSize];
+      for(int blockBegin=begin; blockBegin<end; blockBegin+=rowChunkSize)
+      {
+        int blockSize = min(rowChunkSize, end - blockBegin);
+        Kernels::SpMV(blockSize, rowStarts + blockBegin, contiguousColumnIndices, contiguousEntries, vector, rowProducts);
+        Kernels::Axpy(blockSize, 1.0, rowProducts, result + blockBegin);
+      }
+      return;
+    }
+
+    for(int i=begin; i<end; i++)
+      for(int j=0; j < rowLength[i]; j++)
+        result[i] += vector[columnIndices[i][j]] * columnEntries[i][j];
+  });
 }
 
 void SparseMatrix::TransposeMultiplyVector(const double * vector, int resultLength, double * result) const
 {
-  for(int i=0; i<resultLength; i++)
-    result[i] = 0;
+  // the rows are split into a fixed number of blocks (independent of the number of threads, and so are the sums);
+  // the first block scatters into the result, the others into buffers that are then added to it
+  const int maxNumBlocks = 8;
+  int numBlocks = min(maxNumBlocks, max(1, numRows / (4 * rowChunkSize)));
+  double * buffers = (double*) calloc((size_t) (numBlocks - 1) * resultLength, sizeof(double));
 
-  for(int i=0; i<numRows; i++)
-    for(int j=0; j < rowLength[i]; j++)
-      result[columnIndices[i][j]] += vector[i] * columnEntries[i][j];
+  ThreadPool::Get().ParallelFor(0, numBlocks, 1, [&](int blockBegin, int blockEnd)
+  {
+    for(int block=blockBegin; block<blockEnd; block++)
+    {
+      double * blockResult = (block == 0) ? result : buffers + (size_t) (block - 1) * resultLength;
+      if (block == 0)
+        memset(result, 0, sizeof(double) * resultLength);
+
+      int rowEnd = (int) ((long long) numRows * (block + 1) / numBlocks);
+      for(int i=(int) ((long long) numRows * block / numBlocks); i<rowEnd; i++)
+        for(int j=0; j < rowLength[i]; j++)
+          blockResult[columnIndices[i][j]] += vector[i] * columnEntries[i][j];
+    }
+  });
+
+  if (numBlocks > 1)
+  {
+    ThreadPool::Get().ParallelFor(0, resultLength, 4 * rowChunkSize, [&](int begin, int end)
+    {
+      for(int block=1; block<numBlocks; block++)
+        Kernels::Axpy(end - begin, 1.0, buffers + (size_t) (block - 1) * resultLength + begin, result + begin);
+    });
+  }
+  free(buffers);
 }
 
 void SparseMatrix::TransposeMultiplyVectorAdd(const double * vector, double * result) const
@@ -595,20 +747,36 @@ void SparseMatrix::MultiplyMatrixTranspose(int numDenseColumns, const double * d
 
 double SparseMatrix::QuadraticForm(const double * vector) const
 {
-  double result = 0;
-  for(int i=0; i<numRows; i++)
+  // per-chunk sums, added up in order (so the result does not depend on the number of threads)
+  int numChunks = (numRows + rowChunkSize - 1) / rowChunkSize;
+  double * chunkResults = (double*) malloc(sizeof(double) * numChunks);
+  ThreadPool::Get().ParallelFor(0, numChunks, 1, [&](int chunkBegin, int chunkEnd)
   {
-    for(int j=0; j < rowLength[i]; j++)
+    for(int chunk=chunkBegin; chunk<chunkEnd; chunk++)
     {
-      int index = columnIndices[i][j];
-      if (index < i)
-        continue;
-      if (index == i)
-        result += columnEntries[i][j] * vector[i] * vector[index];
-      else
-        result += 2.0 * columnEntries[i][j] * vector[i] * vector[index];
+      double chunkResult = 0;
+      int rowEnd = min(numRows, (chunk + 1) * rowChunkSize);
+      for(int i=chunk*rowChunkSize; i<rowEnd; i++)
+      {
+        for(int j=0; j < rowLength[i]; j++)
+        {
+          int index = columnIndices[i][j];
+          if (index < i)
+            continue;
+          if (index == i)
+            chunkResult += columnEntries[i][j] * vector[i] * vector[index];
+          else
+            chunkResult += 2.0 * columnEntries[i][j] * vector[i] * vector[index];
+        }
+      }
+      chunkResults[chunk] = chunkResult;
     }
-  }
+  });
+
+  double result = 0;
+  for(int chunk=0; chunk<numChunks; chunk++)
+    result += chunkResults[chunk];
+  free(chunkResults);
 
   return result;
 }
@@ -1507,6 +1675,7 @@ int SparseMatrix::SaveToMatlabFormat(const char * filename) const
 void SparseMatrix::RemoveRowColumn(int index)
 {
   FreeAuxiliaryData();
+  MakeSeparate();
   // remove row 'index'
   free(columnEntries[index]);
   free(columnIndices[index]);
@@ -1560,6 +1729,7 @@ void SparseMatrix::RemoveRowsColumnsSlow(int numRemovedRowsColumns, const int *
 void SparseMatrix::RemoveRowsColumns(int numRemovedRowsColumns, const int * removedRowsColumns, int oneIndexed)
 {
   FreeAuxiliaryData();
+  MakeSeparate();
   // the removed dofs must be pre-sorted
   // build a map from old dofs to new ones
   vector<int> oldToNew(numRows);
@@ -1624,6 +1794,7 @@ void SparseMatrix::RemoveRowsColumns(int numRemovedRowsColumns, const int * remo
 void SparseMatrix::RemoveColumn(int index)
 {
   FreeAuxiliaryData();
+  MakeSeparate();
   // remove column 'index'
   for(int i=0; i<numRows; i++)
   {
@@ -1658,6 +1829,7 @@ void SparseMatrix::RemoveColumn(int index)
 void SparseMatrix::RemoveColumns(int numRemovedColumns, const int * removedColumns, int oneIndexed)
 {
   FreeAuxiliaryData();
+  MakeSeparate();
   // the removed dofs must be pre-sorted
   // build a map from old dofs to new ones
   int numColumns = GetNumColumns();
@@ -1722,6 +1894,7 @@ void SparseMatrix::RemoveColumnsSlow(int numColumns, const int * columns, int on
 void SparseMatrix::RemoveRow(int index)
 {
   FreeAuxiliaryData();
+  MakeSeparate();
   // remove row 'index'
   free(columnEntries[index]);
   free(columnIndices[index]);
@@ -1745,6 +1918,7 @@ void SparseMatrix::RemoveRowsSlow(int numRows, const int * rows, int oneIndexed)
 void SparseMatrix::RemoveRows(int numRemovedRows, const int * removedRows, int oneIndexed)
 {
   FreeAuxiliaryData();
+  MakeSeparate();
   // the removed dofs must be pre-sorted
   // build a map from old dofs to new ones
   vector<int> oldToNew(numRows);
@@ -1925,6 +2099,7 @@ int SparseMatrix::GetNumColumns() const
 void SparseMatrix::IncreaseNumRows(int numAddedRows)
 {
   FreeAuxiliaryData();
+  MakeSeparate();
   int newn = numRows + numAddedRows;
 
   rowLength = (int*) realloc (rowLength, sizeof(int) * newn);
@@ -2115,6 +2290,7 @@ void SparseMatrix::AssignTransposedMatrix(SparseMatrix & AT)
 void SparseMatrix::SetRows(const SparseMatrix * source, int startRow, int startColumn)
 {
   FreeAuxiliaryData();
+  MakeSeparate();
   for(int i=0; i<source->GetNumRows(); i++)
   {
     int row = startRow + i;
@@ -166,7 +166,7 @@ class SparseMatrix
 public:
 
   SparseMatrix(const char * filename); // load from text file (same text file format as SparseMatrixOutline)
-  SparseMatrix(SparseMatrixOutline * sparseMatrixOutline); // create it from the outline
+  SparseMatrix(SparseMatrixOutline * sparseMatrixOutline, int contiguous=0); // create it from the outline; contiguous: see MakeContiguous
   // create it by specifying all entries: number of rows, length of each row, indices of columns of non-zero entries in each row, values of non-zero entries in each row
   // column indices in each row must be sorted (ascending)
   // if shallowCopy=1, the class will not allocate its own internal buffers, but will assume ownership of the input rowLength, columnIndices and columnEntries parameters
@@ -237,6 +237,8 @@ public:
   void MultiplyRow(int row, double scalar); // multiplies all elements in row 'row' with scalar 'scalar'
 
   // multiplies the sparse matrix with the given vector/matrix
+  // MultiplyVector, MultiplyVectorAdd, TransposeMultiplyVector and QuadraticForm run in parallel; with contiguous storage,
+  // the first two also use the SIMD kernels (see MakeContiguous)
   void MultiplyVector(const double * vector, double * result) const; // result = A * vector
   void MultiplyVectorAdd(const double * vector, double * result) const; // result += A * vector
   void MultiplyVector(int startRow, int endRow, const double * vector, double * result) const; // result = A(startRow:endRow-1,:) * vector
@@ -391,6 +393,21 @@ public:
   // passing a buffer (length of n) will avoid a malloc/free pair to generate scratch space for the residual
   double CheckLinearSystemSolution(const double * x, const double * b, int verbose=1, double * buffer=NULL) const;
 
+  // storage layout
+  // by default, each row is allocated separately; MakeContiguous moves all rows into single arrays of column indices and
+  // entries, with an array of row starts (compressed sparse row format); the row pointers (GetEntries, GetRowHandle, etc.)
+  // then point into these arrays, so the rest of the API is unchanged
+  // routines that change the non-zero structure (RemoveRows, SetRows, IncreaseNumRows, etc.) go back to separate rows
+  void MakeContiguous();
+  void MakeSeparate();
+  inline bool IsContiguous() const { return rowStarts != NULL; }
+  // zero-copy views of the contiguous storage, for external solvers (NULL if the rows are separate):
+  // row i occupies positions rowStarts[i], ..., rowStarts[i+1]-1 of the column index and entry arrays
+  // the views stay valid until the non-zero structure changes or the matrix is deleted
+  inline const int * GetRowStarts() const { return rowStarts; }
+  inline int * GetContiguousColumnIndices() const { return contiguousColumnIndices; }
+  inline double * GetContiguousEntries() const { return contiguousEntries; }
+
   // below are low-level routines which are rarely used
   inline double ** GetDataHandle() const { return columnEntries; }
   inline double * GetRowHandle(int row) const { return columnEntries[row]; }
@@ -406,6 +423,11 @@ protected:
   int ** columnIndices; // indices of columns of non-zero entries in each row
   double ** columnEntries; // values of non-zero entries in each row
 
+  // contiguous storage, NULL if each row is allocated separately; the row pointers above then point into it
+  int * rowStarts; // numRows + 1
+  int * contiguousColumnIndices;
+  double * contiguousEntries;
+
   int * diagonalIndices;
   int ** transposedIndices;
 
@@ -424,8 +446,10 @@ protected:
   int ** superMatrixIndices;
   int * superRows;
 
-  void InitFromOutline(SparseMatrixOutline * sparseMatrixOutline);
+  void InitFromOutline(SparseMatrixOutline * sparseMatrixOutline, int contiguous=0);
   void Allocate();
+  void AllocateContiguousRows(); // allocates the contiguous storage for the current row lengths, and points the rows into it
+  void FreeRows();
   void FreeAuxiliaryData();
 };
 
@@ -771,6 +771,7 @@ void CubicMesh::subdivide()
   }
 
   propagateRegionsToElements();
+  invalidateAdjacency();
 }
 
 void CubicMesh::setParallelepipedMode(int parallelepipedMode_)
@@ -30,49 +30,78 @@
  *                                                                       *
  *************************************************************************/
 
-#include <set>
+#include <vector>
+#include <algorithm>
 using namespace std;
 #include "generateMeshGraph.h"
+#include "../../ThreadPool.h"
 
 Graph * GenerateMeshGraph::Generate(const VolumetricMesh * volumetricMesh)
 {
-  // Generate springs:
-  typedef pair<int,int> edge;
-  #define SORTED(i,j) ( (i) <= (j) ? make_pair((i),(j)) : make_pair((j),(i)) )
-
-  // first, all tensile springs (quad edges)
-  set<edge> edgeSet;
+  // all element edges, each with sorted vertices; the graph drops the duplicates
+  int numElements = volumetricMesh->getNumElements();
   int numElementEdges = volumetricMesh->getNumElementEdges();
-  int * edgeBuffer = (int*) malloc (sizeof(int) * 2 * numElementEdges);
-  for(int el=0; el<volumetricMesh->getNumElements(); el++)
+  vector<pair<int,int> > edges((size_t) numElements * numElementEdges);
+  ThreadPool::Get().ParallelFor(0, numElements, 4096, [&](int begin, int end)
   {
-    volumetricMesh->getElementEdges(el, edgeBuffer);  
+    vector<int> edgeBuffer(2 * numElementEdges);
+    for(int el=begin; el<end; el++)
+    {
+      volumetricMesh->getElementEdges(el, edgeBuffer.data());
 
-    for(int j=0; j<numElementEdges; j++)
-      edgeSet.insert(SORTED(edgeBuffer[2*j+0], edgeBuffer[2*j+1]));
-  }
+      for(int j=0; j<numElementEdges; j++)
+        edges[(size_t) el * numElementEdges + j] = minmax(edgeBuffer[2*j+0], edgeBuffer[2*j+1]);
+    }
+  });
 
-  free(edgeBuffer);
+  return new Graph(volumetricMesh->getNumVertices(), edges);
+}
 
-  int numEdges = edgeSet.size();
-  int * edges = (int*) malloc (sizeof(int) * 2 * numEdges);
+Graph * GenerateMeshGraph::GenerateElementGraph(const VolumetricMesh * volumetricMesh, int numCommonVertices)
+{
+  int numElements = volumetricMesh->getNumElements();
+  int numElementVertices = volumetricMesh->getNumElementVertices();
+  if (numCommonVertices <= 0)
+    numCommonVertices = (volumetricMesh->getElementType() == VolumetricMesh::CUBIC) ? 4 : 3;
 
-  int count = 0;
-  for(set<edge> :: iterator iter = edgeSet.begin(); iter != edgeSet.end(); iter++)
+  // an element's neighbors are the elements that occur at least numCommonVertices times
+  // among the incident elements of its vertices; chunk-local lists, concatenated in order
+  const int chunkSize = 4096;
+  int numChunks = (numElements + chunkSize - 1) / chunkSize;
+  vector<vector<pair<int,int> > > chunkEdges(numChunks);
+  ThreadPool::Get().ParallelFor(0, numChunks, 1, [&](int chunkBegin, int chunkEnd)
   {
-    edges[2*count+0] = iter->first;
-    edges[2*count+1] = iter->second;
-    count++;
-  }
+    vector<int> candidates;
+    for(int chunk=chunkBegin; chunk<chunkEnd; chunk++)
+    {
+      int elementEnd = min(numElements, (chunk + 1) * chunkSize);
+      for(int el=chunk*chunkSize; el<elementEnd; el++)
+      {
+        candidates.clear();
+        for(int j=0; j<numElementVertices; j++)
+        {
+          int vertex = volumetricMesh->getVertexIndex(el, j);
+          const int * incidentElements = volumetricMesh->getIncidentElements(vertex);
+          candidates.insert(candidates.end(), incidentElements, incidentElements + volumetricMesh->getNumIncidentElements(vertex));
+        }
+        sort(candidates.begin(), candidates.end());
 
-  //for(int i=0; i<numEdges; i++)
-    //printf("%d %d\n", edges[2*i+0], edges[2*i+1]);
-  //printf("Num edges: %d\n", numEdges);
+        for(size_t first=0; first<candidates.size(); )
+        {
+          size_t last = first;
+          while ((last < candidates.size()) && (candidates[last] == candidates[first]))
+            last++;
+          if ((candidates[first] > el) && ((int)(last - first) >= numCommonVertices))
+            chunkEdges[chunk].push_back(make_pair(el, candidates[first]));
+          first = last;
+        }
+      }
+    }
+  });
 
-  Graph * graph  = new Graph(volumetricMesh->getNumVertices(), numEdges, edges);
+  vector<pair<int,int> > edges;
+  for(int chunk=0; chunk<numChunks; chunk++)
+    edges.insert(edges.end(), chunkEdges[chunk].begin(), chunkEdges[chunk].end());
 
-  free(edges);
-
-  return graph;
+  return new Graph(numElements, edges);
 }
-
@@ -41,11 +41,14 @@
 
 // generates a graph of the vertices of a volumetric mesh
 // two vertices are connected if they share an edge
+// or a graph of the elements (e.g., to partition them with Graph::Partition)
+// two elements are connected if they share at least numCommonVertices vertices; default: a face (3 for tets, 4 for cubes)
 
 class GenerateMeshGraph
 {
 public:
   static Graph * Generate(const VolumetricMesh * volumetricMesh);
+  static Graph * GenerateElementGraph(const VolumetricMesh * volumetricMesh, int numCommonVertices = -1);
 };
 
 #endif
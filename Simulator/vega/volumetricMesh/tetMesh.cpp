@@ -68,7 +68,7 @@ TetMesh::TetMesh(const char * filename, int specialFileType, int verbose): Volum
     throw 1;
   }
 
-  char lineBuffer[1024];
+  char lineBuffer[4096];
   VolumetricMeshParser parser;
 
   // first, read the vertices
@@ -37,14 +37,50 @@
 #include <assert.h>
 #include <iostream>
 #include <map>
+#include <charconv>
+#include <algorithm>
 #include "volumetricMeshParser.h"
 #include "volumetricMesh.h"
+#include "volumetricMeshElementIndex.h"
 #include "volumetricMeshENuMaterial.h"
 #include "volumetricMeshOrthotropicMaterial.h"
 #include "volumetricMeshMooneyRivlinMaterial.h"
 #include "../utility/range.h"
+#include "../../ThreadPool.h"
 using namespace std;
 
+namespace
+{
+  // Writes numLines lines, line i being formatted by formatLine(i, buffer) into a char[256] and returning its
+  // length. Lines are formatted in parallel, a batch at a time, and written in order.
+  template<typename FormatLine>
+  void writeLines(FILE * fout, int numLines, const FormatLine & formatLine)
+  {
+    const int linesPerChunk = 4096;
+    const int chunksPerBatch = 16;
+    vector<string> chunkText(chunksPerBatch);
+
+    for(int batchStart=0; batchStart < numLines; batchStart += linesPerChunk * chunksPerBatch)
+    {
+      int numChunks = min(chunksPerBatch, (numLines - batchStart + linesPerChunk - 1) / linesPerChunk);
+      ThreadPool::Get().ParallelFor(0, numChunks, 1, [&](int chunkBegin, int chunkEnd)
+      {
+        char line[256];
+        for(int c=chunkBegin; c<chunkEnd; c++)
+        {
+          chunkText[c].clear();
+          int lineEnd = min(numLines, batchStart + (c + 1) * linesPerChunk);
+          for(int i = batchStart + c * linesPerChunk; i < lineEnd; i++)
+            chunkText[c].append(line, formatLine(i, line));
+        }
+      });
+
+      for(int c=0; c<numChunks; c++)
+        fwrite(chunkText[c].data(), 1, chunkText[c].size(), fout);
+    }
+  }
+}
+
 double VolumetricMesh::density_default = 1000;
 double VolumetricMesh::E_default = 1E9;
 double VolumetricMesh::nu_default = 0.45;
@@ -154,11 +190,6 @@ void VolumetricMesh::assignMaterialsToElements(int verbose)
 
 void VolumetricMesh::loadFromAscii(const char * filename, elementType * elementType_, int verbose)
 {
-  // create buffer for element vertices
-  vector<int> elementVerticesBuffer(numElementVertices);
-  int * v = &elementVerticesBuffer[0];
-
-
   // parse the .veg file
   VolumetricMeshParser volumetricMeshParser;
 
@@ -170,20 +201,18 @@ void VolumetricMesh::loadFromAscii(const char * filename, elementType * elementT
 
   // === First pass: parse vertices and elements, and count the number of materials, sets and regions  ===
 
-  int countNumVertices = 0;
-  int countNumElements = 0;
-
   numElements = -1;
   numMaterials = 0;
   numSets = 1; // set 0 is "allElements"
   numRegions = 0;
   *elementType_ = INVALID;
   int parseState = 0;
-  char lineBuffer[1024];
+  char lineBuffer[4096];
 
   int oneIndexedVertices = 1;
   int oneIndexedElements = 1;
-  while (volumetricMeshParser.getNextLine(lineBuffer, 0, 0) != NULL)
+  // only the keyword lines are read one by one, the vertex and element sections are parsed in bulk
+  while (volumetricMeshParser.getNextKeywordLine(lineBuffer) != NULL)
   {
     //lineBuffer now contains the next line
     //printf("%s\n", lineBuffer);
@@ -204,7 +233,16 @@ void VolumetricMesh::loadFromAscii(const char * filename, elementType * elementT
         printf("Error: file %s is not in the .veg format. Offending line:\n%s\n", filename, lineBuffer);
         throw 2;
       }
-  
+
+      // read the vertex positions
+      int zeroIndexed;
+      int code = volumetricMeshParser.parseVertexLines(numVertices, (double*) vertices, &zeroIndexed);
+      if (code != 0)
+        throw (code == 1) ? 6 : 7;
+
+      if (zeroIndexed)
+        oneIndexedVertices = 0; // input mesh has 0-indexed vertices
+
       continue;
     }
 
@@ -247,113 +285,26 @@ void VolumetricMesh::loadFromAscii(const char * filename, elementType * elementT
         throw 5;
       }
 
-      continue;
-    }
-
-    if ((parseState == 2) && (lineBuffer[0] == '*'))
-    {
-      parseState = 3; // end of elements
-    }
-
-    if (parseState == 1)
-    {
-      // read the vertex position
-      if (countNumVertices >= numVertices)
-      {
-        printf("Error: mismatch in the number of vertices in %s.\n", filename);
-        throw 6;
-      }
-
-      // ignore space, comma or tab
-      char * ch = lineBuffer;
-      while((*ch == ' ') || (*ch == ',') || (*ch == '\t'))
-        ch++;
-
-      int index;
-      sscanf(ch, "%d", &index);
-      // seek next separator
-      while((*ch != ' ') && (*ch != ',') && (*ch != '\t') && (*ch != 0))
-        ch++;
-
-      if (index == 0)
-        oneIndexedVertices = 0; // input mesh has 0-indexed vertices
-
-      double pos[3];
-      for(int i=0; i<3; i++)
-      {
-        // ignore space, comma or tab
-        while((*ch == ' ') || (*ch == ',') || (*ch == '\t'))
-          ch++;
-
-        if (*ch == 0)
-        {
-          printf("Error parsing line %s in file %s.\n", lineBuffer, filename);
-          throw 7;
-        }
-
-        sscanf(ch, "%lf", &pos[i]);
- 
-        // seek next separator
-        while((*ch != ' ') && (*ch != ',') && (*ch != '\t') && (*ch != 0))
-          ch++;
-      }
-
-      vertices[countNumVertices] = Vec3d(pos);
-      countNumVertices++;
-    }
-
-    if (parseState == 2)
-    {
       // read the element vertices
-      if (countNumElements >= numElements)
-      {
-        printf("Error: mismatch in the number of elements in %s.\n", filename);
-        throw 8;
-      }
+      vector<int> elementVertices(numElementVertices * numElements);
+      int zeroIndexed;
+      int code = volumetricMeshParser.parseElementLines(numElements, numElementVertices, elementVertices.data(), &zeroIndexed);
+      if (code != 0)
+        throw (code == 1) ? 8 : 9;
 
-      // ignore space, comma or tab
-      char * ch = lineBuffer;
-      while((*ch == ' ') || (*ch == ',') || (*ch == '\t'))
-        ch++;
-
-      int index;
-      sscanf(ch, "%d", &index);
-
-      if (index == 0)
+      if (zeroIndexed)
         oneIndexedElements = 0; // input mesh has 0-indexed elements
 
-      // seek next separator
-      while((*ch != ' ') && (*ch != ',') && (*ch != '\t') && (*ch != 0))
-        ch++;
-
-      for(int i=0; i<numElementVertices; i++)
+      // if vertices were 1-numbered in the .veg file, convert to 0-numbered
+      for(int el=0; el<numElements; el++)
       {
-        // ignore space, comma or tab
-        while((*ch == ' ') || (*ch == ',') || (*ch == '\t'))
-          ch++;
-
-        if (*ch == 0)
-        {
-          printf("Error parsing line %s in file %s.\n", lineBuffer, filename);
-          throw 9;
-        }
-
-        sscanf(ch, "%d", &v[i]);
-
-        // seek next separator
-        while((*ch != ' ') && (*ch != ',') && (*ch != '\t') && (*ch != 0))
-          ch++;
+        elements[el] = (int*) malloc (sizeof(int) * numElementVertices);
+        for(int j=0; j<numElementVertices; j++)
+          elements[el][j] = elementVertices[numElementVertices * el + j] - oneIndexedVertices;
       }
-      
-      // if vertices were 1-numbered in the .veg file, convert to 0-numbered
-      for (int k=0; k<numElementVertices; k++)
-        v[k] -= oneIndexedVertices;
 
-      elements[countNumElements] = (int*) malloc (sizeof(int) * numElementVertices);
-      for(int j=0; j<numElementVertices; j++)
-        elements[countNumElements][j] = v[j];
-
-      countNumElements++;
+      parseState = 3; // end of elements
+      continue;
     }
 
     if (strncmp(lineBuffer, "*MATERIAL", 9) == 0)
@@ -400,8 +351,9 @@ void VolumetricMesh::loadFromAscii(const char * filename, elementType * elementT
 
   // create the "allElements" set, containing all the elements
   sets[0] = new Set("allElements");
+  set<int> & allElements = sets[0]->getElements();
   for(int el=0; el<numElements; el++)
-    sets[0]->insert(el);
+    allElements.insert(allElements.end(), el); // in order, so each insertion is constant time
 
   int countNumMaterials = 0;
   int countNumSets = 1; // set 0 is "allElements"
@@ -413,7 +365,8 @@ void VolumetricMesh::loadFromAscii(const char * filename, elementType * elementT
 
   parseState = 0;
 
-  while (volumetricMeshParser.getNextLine(lineBuffer, 0, 0) != NULL)
+  // outside of sets, only the keyword lines matter: the vertex and element sections are skipped unread
+  while (((parseState == 11) ? volumetricMeshParser.getNextLine(lineBuffer, 0, 0) : volumetricMeshParser.getNextKeywordLine(lineBuffer)) != NULL)
   {
     //printf("%s\n", lineBuffer);
 
@@ -712,15 +665,19 @@ void VolumetricMesh::loadFromAscii(const char * filename, elementType * elementT
       // parse the next line of the comma-separated elements in the set
       // we know that lineBuffer[0] != '*' (i.e., not the end of the list), as that case was already previously handled
 
-      volumetricMeshParser.removeWhitespace(lineBuffer);
-      //printf("%s\n", lineBuffer);
-
-      // parse the comma-separated line
-      char * pch;
-      pch = strtok(lineBuffer, ",");
-      while ((pch != NULL) && (isdigit(*pch)))
+      // parse the comma-separated line, up to the first entry that is not a number
+      const char * ch = lineBuffer;
+      const char * lineEnd = lineBuffer + strlen(lineBuffer);
+      while (ch < lineEnd)
       {
-        int newElement = atoi(pch);
+        // ignore spaces and commas
+        while ((ch < lineEnd) && ((*ch == ' ') || (*ch == ',')))
+          ch++;
+        if ((ch == lineEnd) || !isdigit(*ch))
+          break;
+
+        int newElement;
+        ch = VolumetricMeshParser::parseInt(ch, lineEnd, &newElement);
         int ind = newElement-oneIndexedElements;
         if (ind >= numElements || ind < 0)
         {
@@ -728,7 +685,10 @@ void VolumetricMesh::loadFromAscii(const char * filename, elementType * elementT
           throw 21;
         }
         sets[countNumSets-1]->insert(ind); // sets are 0-indexed, but .veg files may be 1-indexed (oneIndexedElements == 1)
-        pch = strtok(NULL, ",");
+
+        // seek the next comma
+        while ((ch < lineEnd) && (*ch != ','))
+          ch++;
       }
     }
 
@@ -1243,11 +1203,11 @@ int VolumetricMesh::saveToAscii(const char * filename, elementType elementType_)
   fprintf(fout,"*VERTICES\n");
   fprintf(fout,"%d 3 0 0\n", numVertices);
           
-  for(int i=0; i < numVertices; i++)  
+  writeLines(fout, numVertices, [this](int i, char * line)
   {
     const Vec3d & v = getVertex(i);
-    fprintf(fout,"%d %.15G %.15G %.15G\n", i+1, v[0], v[1], v[2]);
-  }   
+    return snprintf(line, 256, "%d %.15G %.15G %.15G\n", i+1, v[0], v[1], v[2]);
+  });
   fprintf(fout, "\n");
 
   // write elements
@@ -1262,17 +1222,17 @@ int VolumetricMesh::saveToAscii(const char * filename, elementType elementType_)
 
   fprintf(fout,"%d %d 0\n", numElements, numElementVertices);
 
-  for(int el=0; el < numElements; el++)
-  {   
-    fprintf(fout,"%d ", el+1);
+  writeLines(fout, numElements, [this](int el, char * line)
+  {
+    char * ch = to_chars(line, line + 256, el+1).ptr;
     for(int j=0; j < numElementVertices; j++)
-    {   
-      fprintf(fout, "%d", getVertexIndex(el, j) + 1);
-      if (j != numElementVertices - 1)
-        fprintf(fout," ");
-    } 
-    fprintf(fout,"\n");
-  }     
+    {
+      *ch++ = ' ';
+      ch = to_chars(ch, line + 256, getVertexIndex(el, j) + 1).ptr;
+    }
+    *ch++ = '\n';
+    return int(ch - line);
+  });
   fprintf(fout, "\n");
 
   // write materials
@@ -1329,20 +1289,24 @@ int VolumetricMesh::saveToAscii(const char * filename, elementType elementType_)
     fprintf(fout, "*SET %s\n", name.c_str());
     set<int> setElements;
     sets[setIndex]->getElements(setElements);
+    string text;
+    char number[16];
     int count = 0;
     for(set<int>::iterator iter = setElements.begin(); iter != setElements.end(); iter++)
     {
-      fprintf(fout, "%d, ", *iter + 1); // .veg files are 1-indexed
+      text.append(number, to_chars(number, number + 16, *iter + 1).ptr); // .veg files are 1-indexed
+      text += ", ";
       count++;
       if (count == 8)
       {
-        fprintf(fout, "\n");
+        text += '\n';
         count = 0;
       }
     }
     if (count != 0)
-      fprintf(fout, "\n");
-    fprintf(fout, "\n");
+      text += '\n';
+    text += '\n';
+    fwrite(text.data(), 1, text.size(), fout);
   }
 
   // write regions
@@ -1697,8 +1661,8 @@ VolumetricMesh::elementType VolumetricMesh::getElementTypeASCII(const char * fil
     return elementType_;
   }
 
-  char lineBuffer[1024];
-  while (volumetricMeshParser.getNextLine(lineBuffer, 0, 0) != NULL)
+  char lineBuffer[4096];
+  while (volumetricMeshParser.getNextKeywordLine(lineBuffer) != NULL)
   {
     //printf("%s\n", lineBuffer);
 
@@ -1860,46 +1824,206 @@ Vec3d VolumetricMesh::getElementCenter(int el) const
   return pos;
 }
 
-void VolumetricMesh::getVerticesInElements(vector<int> & elements_, vector<int> & vertices_) const
+void VolumetricMesh::getVerticesInElements(const vector<int> & elements_, vector<int> & vertices_) const
 {
-  set<int> ver;
+  vector<int> ver;
+  ver.reserve(elements_.size() * numElementVertices);
   for(unsigned int i=0; i< elements_.size(); i++)
     for(int j=0; j< numElementVertices; j++)
-      ver.insert(getVertexIndex(elements_[i],j));
+      ver.push_back(getVertexIndex(elements_[i],j));
 
-  vertices_.clear();
-  set<int>::iterator iter;
-  for(iter = ver.begin(); iter != ver.end(); iter++)
-    vertices_.push_back(*iter);
+  sort(ver.begin(), ver.end());
+  ver.erase(unique(ver.begin(), ver.end()), ver.end());
+  vertices_.swap(ver);
 }
 
-void VolumetricMesh::getElementsTouchingVertices(vector<int> & vertices_, vector<int> & elements_) const
+void VolumetricMesh::getElementsTouchingVertices(const vector<int> & vertices_, vector<int> & elements_) const
 {
-  set<int> ver;
+  buildAdjacency(INCIDENT_ELEMENTS);
+
+  vector<int> el;
   for(unsigned int i=0; i<vertices_.size(); i++)
-    ver.insert(vertices_[i]);
+  {
+    int vertex = vertices_[i];
+    if ((vertex < 0) || (vertex >= numVertices))
+      continue;
+    el.insert(el.end(), incidentElements.begin() + incidentElementStarts[vertex], incidentElements.begin() + incidentElementStarts[vertex+1]);
+  }
 
-  elements_.clear();
-  for(int i=0; i< numElements; i++)
+  sort(el.begin(), el.end());
+  el.erase(unique(el.begin(), el.end()), el.end());
+  elements_.swap(el);
+}
+
+void VolumetricMesh::getVertexNeighborhood(const vector<int> & vertices_, vector<int> & neighborhood) const
+{
+  buildAdjacency(INCIDENT_ELEMENTS | VERTEX_NEIGHBORS);
+
+  vector<int> ver;
+  for(unsigned int i=0; i<vertices_.size(); i++)
   {
-    set<int> :: iterator iter;
-    for(int j=0; j<numElementVertices; j++)
+    int vertex = vertices_[i];
+    // a vertex in no element has an empty neighborhood
+    if ((vertex < 0) || (vertex >= numVertices) || (incidentElementStarts[vertex] == incidentElementStarts[vertex+1]))
+      continue;
+    ver.push_back(vertex);
+    ver.insert(ver.end(), vertexNeighbors.begin() + vertexNeighborStarts[vertex], vertexNeighbors.begin() + vertexNeighborStarts[vertex+1]);
+  }
+
+  sort(ver.begin(), ver.end());
+  ver.erase(unique(ver.begin(), ver.end()), ver.end());
+  neighborhood.swap(ver);
+}
+
+void VolumetricMesh::getVertexNeighborhoods(const vector<int> & vertices_, vector<int> & neighborhoodStarts, vector<int> & neighborhoods) const
+{
+  buildAdjacency(INCIDENT_ELEMENTS | VERTEX_NEIGHBORS);
+
+  int numSeeds = (int) vertices_.size();
+  vector<int> starts(numSeeds + 1, 0);
+  for(int i=0; i<numSeeds; i++)
+  {
+    int vertex = vertices_[i];
+    int size = 0;
+    if ((vertex >= 0) && (vertex < numVertices) && (incidentElementStarts[vertex] < incidentElementStarts[vertex+1]))
+      size = 1 + vertexNeighborStarts[vertex+1] - vertexNeighborStarts[vertex];
+    starts[i+1] = starts[i] + size;
+  }
+
+  vector<int> ver(starts[numSeeds]);
+  ThreadPool::Get().ParallelFor(0, numSeeds, 256, [&](int begin, int end)
+  {
+    for(int i=begin; i<end; i++)
     {
-      iter = ver.find(getVertexIndex(i,j));
-      if (iter != ver.end())
+      if (starts[i] == starts[i+1])
+        continue;
+
+      // the neighbors are ascending and exclude the vertex itself, which is merged in at its place
+      int vertex = vertices_[i];
+      const int * first = vertexNeighbors.data() + vertexNeighborStarts[vertex];
+      const int * last = vertexNeighbors.data() + vertexNeighborStarts[vertex+1];
+      const int * split = lower_bound(first, last, vertex);
+      int * out = copy(first, split, ver.data() + starts[i]);
+      *(out++) = vertex;
+      copy(split, last, out);
+    }
+  });
+
+  neighborhoodStarts.swap(starts);
+  neighborhoods.swap(ver);
+}
+
+int VolumetricMesh::getNumIncidentElements(int vertex) const
+{
+  buildAdjacency(INCIDENT_ELEMENTS);
+  return incidentElementStarts[vertex+1] - incidentElementStarts[vertex];
+}
+
+const int * VolumetricMesh::getIncidentElements(int vertex) const
+{
+  buildAdjacency(INCIDENT_ELEMENTS);
+  return incidentElements.data() + incidentElementStarts[vertex];
+}
+
+int VolumetricMesh::getNumVertexNeighbors(int vertex) const
+{
+  buildAdjacency(INCIDENT_ELEMENTS | VERTEX_NEIGHBORS);
+  return vertexNeighborStarts[vertex+1] - vertexNeighborStarts[vertex];
+}
+
+const int * VolumetricMesh::getVertexNeighbors(int vertex) const
+{
+  buildAdjacency(INCIDENT_ELEMENTS | VERTEX_NEIGHBORS);
+  return vertexNeighbors.data() + vertexNeighborStarts[vertex];
+}
+
+void VolumetricMesh::buildAdjacency(int parts) const
+{
+  if ((builtAdjacency.load(memory_order_acquire) & parts) == parts)
+    return;
+
+  lock_guard<mutex> lock(adjacencyMutex);
+  int built = builtAdjacency.load(memory_order_relaxed);
+
+  if (!(built & INCIDENT_ELEMENTS))
+  {
+    // counting sort of the (element, vertex) pairs by vertex; an element is listed once per distinct vertex
+    incidentElementStarts.assign(numVertices + 1, 0);
+    for(int el=0; el<numElements; el++)
+      for(int j=0; j<numElementVertices; j++)
       {
-        elements_.push_back(i);
-        break;
+        int vertex = elements[el][j];
+        if (find(elements[el], elements[el] + j, vertex) == elements[el] + j)
+          incidentElementStarts[vertex+1]++;
       }
-    }
+    for(int v=0; v<numVertices; v++)
+      incidentElementStarts[v+1] += incidentElementStarts[v];
+
+    incidentElements.resize(incidentElementStarts[numVertices]);
+    vector<int> fill(incidentElementStarts.begin(), incidentElementStarts.end() - 1);
+    for(int el=0; el<numElements; el++)
+      for(int j=0; j<numElementVertices; j++)
+      {
+        int vertex = elements[el][j];
+        if (find(elements[el], elements[el] + j, vertex) == elements[el] + j)
+          incidentElements[fill[vertex]++] = el;
+      }
+
+    built |= INCIDENT_ELEMENTS;
   }
+
+  if ((parts & VERTEX_NEIGHBORS) && !(built & VERTEX_NEIGHBORS))
+  {
+    // each chunk of vertices collects its rows separately, then the rows are concatenated
+    const int verticesPerChunk = 4096;
+    int numChunks = (numVertices + verticesPerChunk - 1) / verticesPerChunk;
+    vector<vector<int>> chunkNeighbors(numChunks);
+    vertexNeighborStarts.assign(numVertices + 1, 0);
+
+    ThreadPool::Get().ParallelFor(0, numChunks, 1, [&](int chunkBegin, int chunkEnd)
+    {
+      vector<int> row;
+      for(int c=chunkBegin; c<chunkEnd; c++)
+      {
+        int vertexEnd = min(numVertices, (c + 1) * verticesPerChunk);
+        for(int v = c * verticesPerChunk; v < vertexEnd; v++)
+        {
+          row.clear();
+          for(int k=incidentElementStarts[v]; k<incidentElementStarts[v+1]; k++)
+          {
+            int el = incidentElements[k];
+            for(int j=0; j<numElementVertices; j++)
+              if (elements[el][j] != v)
+                row.push_back(elements[el][j]);
+          }
+          sort(row.begin(), row.end());
+          row.erase(unique(row.begin(), row.end()), row.end());
+
+          vertexNeighborStarts[v+1] = (int) row.size();
+          chunkNeighbors[c].insert(chunkNeighbors[c].end(), row.begin(), row.end());
+        }
+      }
+    });
+
+    for(int v=0; v<numVertices; v++)
+      vertexNeighborStarts[v+1] += vertexNeighborStarts[v];
+    vertexNeighbors.resize(vertexNeighborStarts[numVertices]);
+    for(int c=0; c<numChunks; c++)
+      copy(chunkNeighbors[c].begin(), chunkNeighbors[c].end(), vertexNeighbors.begin() + vertexNeighborStarts[c * verticesPerChunk]);
+
+    built |= VERTEX_NEIGHBORS;
+  }
+
+  builtAdjacency.store(built, memory_order_release);
 }
 
-void VolumetricMesh::getVertexNeighborhood(vector<int> & vertices_, vector<int> & neighborhood) const
+void VolumetricMesh::invalidateAdjacency()
 {
-  vector<int> elements_;
-  getElementsTouchingVertices(vertices_, elements_);
-  getVerticesInElements(elements_, neighborhood);
+  builtAdjacency.store(0);
+  vector<int>().swap(incidentElementStarts);
+  vector<int>().swap(incidentElements);
+  vector<int>().swap(vertexNeighborStarts);
+  vector<int>().swap(vertexNeighbors);
 }
 
 double VolumetricMesh::getMass() const
@@ -2133,61 +2257,73 @@ int VolumetricMesh::generateInterpolationWeights(int numTargetLocations,
   *vertices_ = (int*) malloc (sizeof(int) * numElementVertices * numTargetLocations);
   *weights = (double*) malloc (sizeof(double) * numElementVertices * numTargetLocations);
 
-  double * barycentricWeights = (double*) malloc (sizeof(double) * numElementVertices);
+  // rows up to the first invalid element are still generated, as the serial loop did
+  int numValidTargetLocations = 0;
+  while ((numValidTargetLocations < numTargetLocations) && (elements[numValidTargetLocations] >= 0))
+    numValidTargetLocations++;
 
-  for (int i=0; i < numTargetLocations; i++) // over all interpolation locations
+  auto generateRange = [&](int begin, int end)
   {
-    if ((verbose) && (i % 100 == 0))
-    {
-      printf("%d ", i); fflush(NULL);
-    }
+    double * barycentricWeights = (double*) malloc (sizeof(double) * numElementVertices);
 
-    Vec3d pos = Vec3d(targetLocations[3*i+0],
-                      targetLocations[3*i+1],
-                      targetLocations[3*i+2]);
-
-    int element = elements[i];
-    if (element < 0)
+    for (int i=begin; i < end; i++) // over all interpolation locations
     {
-      printf("Error: invalid element index %d.\n", element);
-      return 1;
-    }
+      Vec3d pos = Vec3d(targetLocations[3*i+0],
+                        targetLocations[3*i+1],
+                        targetLocations[3*i+2]);
 
-    computeBarycentricWeights(element, pos, barycentricWeights);
+      int element = elements[i];
+      computeBarycentricWeights(element, pos, barycentricWeights);
 
-    if (zeroThreshold > 0)
-    {
-      // check whether vertex is close enough to the mesh
-      double minDistance = DBL_MAX;
-      int numElementVertices = getNumElementVertices();
-      int assignedZero = 0;
-      for(int ii=0; ii< numElementVertices; ii++)
+      if (zeroThreshold > 0)
       {
-        const Vec3d & vpos = getVertex(element, ii);
-        if (len(vpos-pos) < minDistance)
+        // check whether vertex is close enough to the mesh
+        double minDistance = DBL_MAX;
+        for(int ii=0; ii< numElementVertices; ii++)
+        {
+          const Vec3d & vpos = getVertex(element, ii);
+          if (len(vpos-pos) < minDistance)
+          {
+            minDistance = len(vpos-pos);
+          }
+        }
+
+        if (minDistance > zeroThreshold)
         {
-          minDistance = len(vpos-pos);
+          // assign zero weights
+          for(int ii=0; ii < numElementVertices; ii++)
+            barycentricWeights[ii] = 0.0;
+          continue;
         }
       }
 
-      if (minDistance > zeroThreshold)
+      for(int ii=0; ii<numElementVertices; ii++)
       {
-        // assign zero weights
-        for(int ii=0; ii < numElementVertices; ii++)
-          barycentricWeights[ii] = 0.0;
-        assignedZero++;
-        continue;
+        (*vertices_)[numElementVertices * i + ii] = getVertexIndex(element, ii);
+        (*weights)[numElementVertices * i + ii] = barycentricWeights[ii];
       }
     }
 
-    for(int ii=0; ii<numElementVertices; ii++)
+    free(barycentricWeights);
+  };
+
+  // with verbose on, in slices; progress is printed by this thread between them, not from inside the pool
+  int progressStep = verbose ? 10000 : numValidTargetLocations;
+  for(int sliceBegin=0; sliceBegin < numValidTargetLocations; sliceBegin += progressStep)
+  {
+    int sliceEnd = min(sliceBegin + progressStep, numValidTargetLocations);
+    ThreadPool::Get().ParallelFor(sliceBegin, sliceEnd, 256, generateRange);
+    if (verbose)
     {
-      (*vertices_)[numElementVertices * i + ii] = getVertexIndex(element, ii);
-      (*weights)[numElementVertices * i + ii] = barycentricWeights[ii];
+      printf("%d ", sliceEnd); fflush(NULL);
     }
   }
 
-  free(barycentricWeights);
+  if (numValidTargetLocations < numTargetLocations)
+  {
+    printf("Error: invalid element index %d.\n", elements[numValidTargetLocations]);
+    return 1;
+  }
 
   return 0;
 }
@@ -2198,23 +2334,31 @@ int VolumetricMesh::generateContainingElements(int numTargetLocations, const dou
 
   (*elements) = (int*) malloc (sizeof(int) * numTargetLocations);
 
-  // determine containing (or closest) elements
-  for (int i=0; i < numTargetLocations; i++) // over all interpolation locations
+  // determine containing (or closest) elements, with the same answers as the linear scans
+  VolumetricMeshElementIndex elementIndex(this);
+  vector<char> external(numTargetLocations, 0);
+  ThreadPool::Get().ParallelFor(0, numTargetLocations, 256, [&](int begin, int end)
   {
-    Vec3d pos = Vec3d(targetLocations[3*i+0], targetLocations[3*i+1], targetLocations[3*i+2]);
+    for (int i=begin; i < end; i++) // over all interpolation locations
+    {
+      Vec3d pos = Vec3d(targetLocations[3*i+0], targetLocations[3*i+1], targetLocations[3*i+2]);
 
-    // find element containing pos
-    int element = getContainingElement(pos);
+      // find element containing pos
+      int element = elementIndex.getContainingElement(pos);
 
-    // use closest element if outside
-    if (useClosestElementIfOutside && (element < 0))
-    {
-      element = getClosestElement(pos);
-      numExternalVertices++;
+      // use closest element if outside
+      if (useClosestElementIfOutside && (element < 0))
+      {
+        element = elementIndex.getClosestElement(pos);
+        external[i] = 1;
+      }
+
+      (*elements)[i] = element;
     }
+  });
 
-    (*elements)[i] = element;
-  }
+  for (int i=0; i < numTargetLocations; i++)
+    numExternalVertices += external[i];
 
   return numExternalVertices;
 }
@@ -2226,9 +2370,7 @@ int VolumetricMesh::generateInterpolationWeights(int numTargetLocations, const d
   int useClosestElementIfOutside = 1;
   int numExternalVertices = generateContainingElements(numTargetLocations, targetLocations, &elements, useClosestElementIfOutside);
 
-  // allocate interpolation arrays  
-  *vertices_ = (int*) malloc (sizeof(int) * numElementVertices * numTargetLocations);
-  *weights = (double*) malloc (sizeof(double) * numElementVertices * numTargetLocations);
+  // the arrays are allocated by the call below
   int code = generateInterpolationWeights(numTargetLocations, targetLocations, elements, vertices_, weights, zeroThreshold, verbose);
 
   if (containingElements == NULL)
@@ -2819,6 +2961,8 @@ void VolumetricMesh::setToSubsetMesh(std::set<int> & subsetElements, int removeI
     delete [] vertices;
     vertices = newVertices;
   }
+
+  invalidateAdjacency();
 }
 
 int VolumetricMesh::exportToEle(const char * baseFilename, int includeRegions) const
@@ -2925,6 +3069,8 @@ void VolumetricMesh::renumberVertices(const vector<int> & permutation)
   for (int i = 0; i < numElements; i++)
     for (int j = 0; j < numElementVertices; j++)
       elements[i][j] = permutation[elements[i][j]];
+
+  invalidateAdjacency();
 }
 
 void VolumetricMesh::addMaterial(const Material * material, const Set & newSet, bool removeEmptySets, bool removeEmptyMaterials)
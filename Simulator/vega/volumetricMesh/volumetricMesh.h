@@ -57,6 +57,8 @@
 #include <set>
 #include <string>
 #include <map>
+#include <atomic>
+#include <mutex>
 #include "../minivector/minivector.h"
 #include "../utility/boundingBox.h"
 
@@ -165,10 +167,21 @@ public:
   void getMeshGeometricParameters(Vec3d & centroid, double * radius) const;
   BoundingBox getBoundingBox() const;
 
-  // mesh 1-neighborhood queries
-  void getVerticesInElements(std::vector<int> & elements, std::vector<int> & vertices) const;
-  void getElementsTouchingVertices(std::vector<int> & vertices, std::vector<int> & elements) const;
-  void getVertexNeighborhood(std::vector<int> & vertices, std::vector<int> & neighborhood) const;
+  // mesh 1-neighborhood queries; the outputs are sorted, without duplicates
+  // the vertex queries use a vertex adjacency that is built on first use and kept until the topology changes,
+  // so they cost O(size of the neighborhood); vertex indices out of range are ignored
+  void getVerticesInElements(const std::vector<int> & elements, std::vector<int> & vertices) const;
+  void getElementsTouchingVertices(const std::vector<int> & vertices, std::vector<int> & elements) const;
+  void getVertexNeighborhood(const std::vector<int> & vertices, std::vector<int> & neighborhood) const; // the vertices of the elements touching the given vertices
+  // batch version of getVertexNeighborhood, one neighborhood per given vertex, computed in parallel:
+  // the neighborhood of vertices[i] is neighborhoods[neighborhoodStarts[i]], ..., neighborhoods[neighborhoodStarts[i+1]-1]
+  void getVertexNeighborhoods(const std::vector<int> & vertices, std::vector<int> & neighborhoodStarts, std::vector<int> & neighborhoods) const;
+
+  // the cached adjacency: the elements containing the given vertex, and the vertices sharing an element with it (excluding itself), both ascending
+  int getNumIncidentElements(int vertex) const;
+  const int * getIncidentElements(int vertex) const;
+  int getNumVertexNeighbors(int vertex) const;
+  const int * getVertexNeighbors(int vertex) const;
 
   // proximity queries
   int getClosestElement(Vec3d pos) const; // finds the closest element to the given position (using linear scan); distance to a element is defined as distance to its center
@@ -348,6 +361,8 @@ protected:
   VolumetricMesh(void * binaryInputStream, int numElementVertices, elementType * elementType_, int memoryLoad = 0);
   VolumetricMesh(int numElementVertices_) { numElementVertices = numElementVertices_; }
   void propagateRegionsToElements();
+  // drops the cached vertex adjacency; call after changing the elements or the number of vertices
+  void invalidateAdjacency();
   void loadFromBinaryGeneric(void * binaryInputStream, elementType * elementType_, int memoryLoad);
 
   // constructs a mesh from the given vertices and elements, 
@@ -389,6 +404,15 @@ protected:
 
   elementType temp; // auxiliary
 
+  // vertex adjacency (see the 1-neighborhood queries), in compressed rows: the entries of vertex v
+  // are [starts[v], starts[v+1]); built lazily (and thread-safely) by buildAdjacency
+  enum { INCIDENT_ELEMENTS = 1, VERTEX_NEIGHBORS = 2 };
+  mutable std::vector<int> incidentElementStarts, incidentElements;
+  mutable std::vector<int> vertexNeighborStarts, vertexNeighbors;
+  mutable std::atomic<int> builtAdjacency { 0 };
+  mutable std::mutex adjacencyMutex;
+  void buildAdjacency(int parts) const;
+
   friend class VolumetricMeshExtensions;
   friend class VolumetricMeshLoader;
 
@@ -0,0 +1,288 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 4.0                               *
+ *                                                                       *
+ * "volumetricMesh" library , Copyright (C) 2007 CMU, 2009 MIT, 2018 USC *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/vega                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Hongyi Xu, Yijing Li,                        *
+ *           Danyong Zhao, Bohan Wang,                                   *
+ *           Fun Shing Sin, Daniel Schroeder,                            *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC,                *
+ *          Sloan Foundation, Okawa Foundation,                          *
+ *          USC Annenberg Foundation                                     *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#include <float.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include "volumetricMeshElementIndex.h"
+#include "../../ThreadPool.h"
+using namespace std;
+
+namespace
+{
+  const int maxLeafSize = 4;
+
+  // the containment test of an element computes its result from differences of positions, with a rounding
+  // error of a few ulps of the element's size, amplified by how flat the element is (size^3 / volume)
+  const double containmentTolerance = 1000.0 * DBL_EPSILON;
+
+  inline bool isInside(const Vec3d & pos, const Vec3d & bmin, const Vec3d & bmax)
+  {
+    return (pos[0] >= bmin[0]) && (pos[1] >= bmin[1]) && (pos[2] >= bmin[2]) &&
+           (pos[0] <= bmax[0]) && (pos[1] <= bmax[1]) && (pos[2] <= bmax[2]);
+  }
+
+  // a lower bound of the distance from pos to any point in the box
+  inline double boxDistance(const Vec3d & pos, const Vec3d & bmin, const Vec3d & bmax)
+  {
+    double dist2 = 0.0;
+    for(int i=0; i<3; i++)
+    {
+      double gap = max(max(bmin[i] - pos[i], pos[i] - bmax[i]), 0.0);
+      dist2 += gap * gap;
+    }
+    return sqrt(dist2);
+  }
+}
+
+VolumetricMeshElementIndex::VolumetricMeshElementIndex(const VolumetricMesh * volumetricMesh_): volumetricMesh(volumetricMesh_)
+{
+  int numElements = volumetricMesh->getNumElements();
+  int numElementVertices = volumetricMesh->getNumElementVertices();
+
+  vector<Vec3d> bmin(numElements), bmax(numElements);
+  vector<char> alwaysTested(numElements, 0);
+  centers.resize(numElements);
+
+  ThreadPool::Get().ParallelFor(0, numElements, 4096, [&](int begin, int end)
+  {
+    for(int el=begin; el<end; el++)
+    {
+      centers[el] = volumetricMesh->getElementCenter(el);
+
+      Vec3d lo = volumetricMesh->getVertex(el, 0);
+      Vec3d hi = lo;
+      for(int j=1; j<numElementVertices; j++)
+      {
+        const Vec3d & v = volumetricMesh->getVertex(el, j);
+        for(int i=0; i<3; i++)
+        {
+          lo[i] = min(lo[i], v[i]);
+          hi[i] = max(hi[i], v[i]);
+        }
+      }
+
+      double size = len(hi - lo);
+      double volume = fabs(volumetricMesh->getElementVolume(el));
+      double pad = containmentTolerance * size * (size * size * size / volume);
+
+      // degenerate, nearly so, or not finite
+      if (!(volume > 0) || !(pad < size))
+      {
+        alwaysTested[el] = 1;
+        continue;
+      }
+
+      bmin[el] = lo - Vec3d(pad, pad, pad);
+      bmax[el] = hi + Vec3d(pad, pad, pad);
+    }
+  });
+
+  // the boxes of the elements that are tested anyway are left out of the hierarchy
+  boxBmin.swap(bmin);
+  boxBmax.swap(bmax);
+  for(int el=0; el<numElements; el++)
+  {
+    if (alwaysTested[el])
+      alwaysTestedElements.push_back(el);
+    else
+      boxElements.push_back(el);
+  }
+  build(boxNodes, boxElements, boxBmin, boxBmax);
+
+  centerElements.resize(numElements);
+  for(int el=0; el<numElements; el++)
+    centerElements[el] = el;
+  build(centerNodes, centerElements, centers, centers);
+}
+
+void VolumetricMeshElementIndex::build(vector<Node> & nodes, vector<int> & elements, const vector<Vec3d> & bmin, const vector<Vec3d> & bmax)
+{
+  nodes.clear();
+  if (elements.empty())
+    return;
+
+  struct Task
+  {
+    int node, begin, end;
+  };
+  vector<Task> stack;
+
+  nodes.push_back(Node());
+  Task root = { 0, 0, (int) elements.size() };
+  stack.push_back(root);
+  while (!stack.empty())
+  {
+    Task task = stack.back();
+    stack.pop_back();
+
+    // bounds of the boxes, and of their centers
+    Vec3d lo(DBL_MAX, DBL_MAX, DBL_MAX), hi(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+    Vec3d centerLo = lo, centerHi = hi;
+    for(int k=task.begin; k<task.end; k++)
+    {
+      int el = elements[k];
+      for(int i=0; i<3; i++)
+      {
+        lo[i] = min(lo[i], bmin[el][i]);
+        hi[i] = max(hi[i], bmax[el][i]);
+        double center = 0.5 * (bmin[el][i] + bmax[el][i]);
+        centerLo[i] = min(centerLo[i], center);
+        centerHi[i] = max(centerHi[i], center);
+      }
+    }
+    nodes[task.node].bmin = lo;
+    nodes[task.node].bmax = hi;
+
+    if (task.end - task.begin <= maxLeafSize)
+    {
+      nodes[task.node].first = task.begin;
+      nodes[task.node].count = task.end - task.begin;
+      continue;
+    }
+
+    // median split along the longest axis of the centers
+    Vec3d extent = centerHi - centerLo;
+    int axis = (extent[0] >= extent[1]) ? ((extent[0] >= extent[2]) ? 0 : 2) : ((extent[1] >= extent[2]) ? 1 : 2);
+    int mid = (task.begin + task.end) / 2;
+    nth_element(elements.begin() + task.begin, elements.begin() + mid, elements.begin() + task.end, [&](int a, int b)
+    {
+      double ca = bmin[a][axis] + bmax[a][axis];
+      double cb = bmin[b][axis] + bmax[b][axis];
+      return (ca < cb) || ((ca == cb) && (a < b));
+    });
+
+    int child = (int) nodes.size();
+    nodes[task.node].first = child;
+    nodes[task.node].count = 0;
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+
+    Task left = { child, task.begin, mid };
+    Task right = { child + 1, mid, task.end };
+    stack.push_back(left);
+    stack.push_back(right);
+  }
+}
+
+int VolumetricMeshElementIndex::getContainingElement(const Vec3d & pos) const
+{
+  int found = INT_MAX;
+
+  // in ascending order, so the first hit is the lowest
+  for(size_t k=0; k<alwaysTestedElements.size(); k++)
+  {
+    if (volumetricMesh->containsVertex(alwaysTestedElements[k], pos))
+    {
+      found = alwaysTestedElements[k];
+      break;
+    }
+  }
+
+  if (boxNodes.empty())
+    return (found == INT_MAX) ? -1 : found;
+
+  int stack[64];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0)
+  {
+    const Node & node = boxNodes[stack[--stackSize]];
+    if (!isInside(pos, node.bmin, node.bmax))
+      continue;
+
+    if (node.count == 0)
+    {
+      stack[stackSize++] = node.first;
+      stack[stackSize++] = node.first + 1;
+      continue;
+    }
+
+    for(int k=node.first; k<node.first+node.count; k++)
+    {
+      int el = boxElements[k];
+      if ((el < found) && isInside(pos, boxBmin[el], boxBmax[el]) && volumetricMesh->containsVertex(el, pos))
+        found = el;
+    }
+  }
+
+  return (found == INT_MAX) ? -1 : found;
+}
+
+int VolumetricMeshElementIndex::getClosestElement(const Vec3d & pos) const
+{
+  // same start as the linear scan: element 0 if no distance is below DBL_MAX
+  double closestDist = DBL_MAX;
+  int closestElement = 0;
+  if (centerNodes.empty())
+    return closestElement;
+
+  // nodes are culled with some slack, so rounding can't cull a tie
+  const double slack = 1.0 + 1e-10;
+
+  int stack[64];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0)
+  {
+    const Node & node = centerNodes[stack[--stackSize]];
+    if (boxDistance(pos, node.bmin, node.bmax) > closestDist * slack)
+      continue;
+
+    if (node.count == 0)
+    {
+      // the nearer child is visited first
+      int nearChild = node.first, farChild = node.first + 1;
+      if (boxDistance(pos, centerNodes[farChild].bmin, centerNodes[farChild].bmax) <
+          boxDistance(pos, centerNodes[nearChild].bmin, centerNodes[nearChild].bmax))
+        swap(nearChild, farChild);
+      stack[stackSize++] = farChild;
+      stack[stackSize++] = nearChild;
+      continue;
+    }
+
+    for(int k=node.first; k<node.first+node.count; k++)
+    {
+      int el = centerElements[k];
+      double dist = len(pos - centers[el]);
+      if ((dist < closestDist) || ((dist == closestDist) && (el < closestElement)))
+      {
+        closestDist = dist;
+        closestElement = el;
+      }
+    }
+  }
+
+  return closestElement;
+}
+
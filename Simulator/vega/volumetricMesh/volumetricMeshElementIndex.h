@@ -0,0 +1,91 @@
+/*************************************************************************
+ *                                                                       *
+ * Vega FEM Simulation Library Version 4.0                               *
+ *                                                                       *
+ * "volumetricMesh" library , Copyright (C) 2007 CMU, 2009 MIT, 2018 USC *
+ * All rights reserved.                                                  *
+ *                                                                       *
+ * Code author: Jernej Barbic                                            *
+ * http://www.jernejbarbic.com/vega                                      *
+ *                                                                       *
+ * Research: Jernej Barbic, Hongyi Xu, Yijing Li,                        *
+ *           Danyong Zhao, Bohan Wang,                                   *
+ *           Fun Shing Sin, Daniel Schroeder,                            *
+ *           Doug L. James, Jovan Popovic                                *
+ *                                                                       *
+ * Funding: National Science Foundation, Link Foundation,                *
+ *          Singapore-MIT GAMBIT Game Lab,                               *
+ *          Zumberge Research and Innovation Fund at USC,                *
+ *          Sloan Foundation, Okawa Foundation,                          *
+ *          USC Annenberg Foundation                                     *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of the BSD-style license that is            *
+ * included with this library in the file LICENSE.txt                    *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the file     *
+ * LICENSE.TXT for more details.                                         *
+ *                                                                       *
+ *************************************************************************/
+
+#ifndef _VOLUMETRICMESHELEMENTINDEX_H_
+#define _VOLUMETRICMESHELEMENTINDEX_H_
+
+#include <vector>
+#include "volumetricMesh.h"
+
+/*
+  Spatial index over the elements of a volumetric mesh, for the point
+  location queries of interpolation weight generation. Two bounding volume
+  hierarchies are built once: one over the element bounding boxes, and one
+  over the element centers.
+
+  The queries return exactly what the linear scans in VolumetricMesh return,
+  including the tie-breaking towards the lowest element index. Each element box
+  is enlarged by the rounding error of the element's containment test, so a
+  point that containsVertex accepts is never culled. Elements too flat to
+  bound that way are tested for every query.
+
+  The index keeps a pointer to the mesh; it must not be modified while the
+  index is in use. Queries are const and may run concurrently.
+*/
+
+class VolumetricMeshElementIndex
+{
+public:
+  VolumetricMeshElementIndex(const VolumetricMesh * volumetricMesh);
+
+  // same as VolumetricMesh::getContainingElement: the lowest element that contains pos, or -1
+  int getContainingElement(const Vec3d & pos) const;
+  // same as VolumetricMesh::getClosestElement: the lowest element with the center closest to pos
+  int getClosestElement(const Vec3d & pos) const;
+
+protected:
+  struct Node
+  {
+    Vec3d bmin, bmax;
+    int first; // leaf: first entry in "elements"; inner: index of the first child, the second one follows it
+    int count; // leaf: number of entries, 0 for inner nodes
+  };
+
+  // builds the hierarchy over the boxes [bmin[i], bmax[i]] of the given elements (reordered in place)
+  static void build(std::vector<Node> & nodes, std::vector<int> & elements, const std::vector<Vec3d> & bmin, const std::vector<Vec3d> & bmax);
+
+  const VolumetricMesh * volumetricMesh;
+
+  // over the (enlarged) element boxes, boxBmin/boxBmax[element]
+  std::vector<Node> boxNodes;
+  std::vector<int> boxElements;
+  std::vector<Vec3d> boxBmin, boxBmax;
+  std::vector<int> alwaysTestedElements;
+
+  // over the element centers, as computed by getElementCenter
+  std::vector<Node> centerNodes;
+  std::vector<int> centerElements;
+  std::vector<Vec3d> centers;
+};
+
+#endif
+
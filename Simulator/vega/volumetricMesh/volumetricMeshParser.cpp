@@ -30,16 +30,66 @@
  *                                                                       *
  *************************************************************************/
 
+
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <string.h>
+#include <charconv>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "volumetricMeshParser.h"
+#include "../../ThreadPool.h"
+
+namespace
+{
+  // data sections are split into chunks of about this size for parallel parsing
+  const size_t chunkSize = 1 << 20;
+
+  inline bool isSeparator(char c)
+  {
+    return (c == ' ') || (c == ',') || (c == '\t');
+  }
+
+  // getNextLine skips comments and blank lines
+  inline bool isDataLine(const char * line)
+  {
+    return (line[0] != '#') && (line[0] != 13) && (line[0] != 10);
+  }
+
+  // [line, lineEnd) is the next line of [p, end), without its '\n'; returns the start of the line after
+  inline const char * nextLine(const char * p, const char * end, const char ** lineEnd)
+  {
+    const char * newline = (const char*) memchr(p, '\n', end - p);
+    *lineEnd = newline ? newline : end;
+    return newline ? newline + 1 : end;
+  }
+
+  // the first line of [p, end) that starts with '*', or NULL; p must be at a line start
+  inline const char * findKeywordLine(const char * p, const char * end)
+  {
+    const char * lineStart = p;
+    while (p < end)
+    {
+      const char * star = (const char*) memchr(p, '*', end - p);
+      if (star == NULL)
+        return NULL;
+      if ((star == lineStart) || (star[-1] == '\n'))
+        return star;
+      p = star + 1;
+    }
+    return NULL;
+  }
+
+  const double powersOf10[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+}
 
 VolumetricMeshParser::VolumetricMeshParser(const char * includeToken_)
 {
-  fin = NULL;
-  //fileStackDepth = -1;
-  fileStack.empty();
+  spanIndex = 0;
+  pos = NULL;
   if (includeToken_ == NULL)
   {
     includeTokenLength = 9;
@@ -54,50 +104,118 @@ VolumetricMeshParser::VolumetricMeshParser(const char * includeToken_)
 
 int VolumetricMeshParser::open(const char * filename)
 {
-  // extract directory name and filename
-  // seek for last '/' in filename
-  // if no '/', then directory name is "."
-  // else, everything before '/' is directory name, and everything after is filename
+  close();
 
-  const char * iter = filename;
-  const char * lastPos = NULL;
+  // extract directory name: everything before the last '/' (or '\'), "." if there is none
+  string name(filename);
+  size_t lastSlash = name.find_last_of("/\\");
+  directoryName = (lastSlash == string::npos) ? string(".") : name.substr(0, lastSlash);
 
-  while (*iter != '\0')
+  if (mapFile(name) != 0)
+    return 1;
+
+  // resolve the *INCLUDEs once; getNextLine then just walks the spans
+  if (appendSpans(0, 0) != 0)
   {
-    if ((*iter == '/') || (*iter == '\\'))
-    {
-      lastPos = iter;
-    }
-    iter++;
+    close();
+    throw -1;
   }
 
-  // lastPos is NULL if no slash found, otherwise it points to the last slash
-  if (lastPos == NULL)
+  rewindToStart();
+  return 0;
+}
+
+int VolumetricMeshParser::mapFile(const string & filename)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return 1;
+
+  MappedFile file;
+  file.name = filename;
+  file.data = NULL;
+  file.size = 0;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
   {
-    directoryName[0] = '.';
-    directoryName[1] = '\0';
+    ::close(fd);
+    return 1;
   }
-  else
+
+  // an empty file can't be mapped, and doesn't need to be
+  if (st.st_size > 0)
   {
-    iter = filename;
-    int charPos = 0;
-    while (iter != lastPos)
+    void * data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
     {
-      directoryName[charPos] = *iter;
-      charPos++;
-      iter++;
+      ::close(fd);
+      return 1;
     }
-    directoryName[charPos] = '\0';
+    madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+    file.data = data;
+    file.size = (size_t) st.st_size;
   }
+  ::close(fd);
 
-  // now, directoryName has been extracted
-  fin = fopen(filename, "r");
-  if (!fin)
-    return 1;
+  files.push_back(file);
+  return 0;
+}
+
+// appends the lines of files[file] to the spans, replacing each *INCLUDE line with the lines of the included file
+int VolumetricMeshParser::appendSpans(int file, int depth)
+{
+  const char * begin = (const char*) files[file].data;
+  const char * end = begin + files[file].size;
+  const char * appendedEnd = begin;
+
+  const char * p = begin;
+  while ((p = findKeywordLine(p, end)) != NULL)
+  {
+    const char * lineEnd;
+    const char * next = nextLine(p, end, &lineEnd);
+
+    if ((lineEnd - p >= includeTokenLength) && (strncmp(p, includeToken, includeTokenLength) == 0))
+    {
+      if (p > appendedEnd)
+      {
+        Span span = { appendedEnd, p, file };
+        spans.push_back(span);
+      }
+      appendedEnd = next;
 
-  //fileStackDepth=0;
-  fileStack.push_back(fin);
+      // includes are relative to the directory of the top file
+      const char * nameEnd = lineEnd;
+      while ((nameEnd > p + includeTokenLength) && ((nameEnd[-1] == 13) || (nameEnd[-1] == ' ') || (nameEnd[-1] == '\t')))
+        nameEnd--;
+      string includeName = directoryName + "/" + string(p + includeTokenLength, nameEnd);
 
+      if (depth >= 64)
+      {
+        printf("Error: include files nested too deeply at %s.\n", includeName.c_str());
+        return 1;
+      }
+
+      if (mapFile(includeName) != 0)
+      {
+        printf("Error: couldn't open include file %s.\n", includeName.c_str());
+        return 1;
+      }
+
+      if (files.back().size == 0)
+        printf("Warning: include file is empty.\n");
+      else if (appendSpans(int(files.size()) - 1, depth + 1) != 0)
+        return 1;
+    }
+
+    p = next;
+  }
+
+  if (end > appendedEnd)
+  {
+    Span span = { appendedEnd, end, file };
+    spans.push_back(span);
+  }
   return 0;
 }
 
@@ -108,27 +226,19 @@ VolumetricMeshParser::~VolumetricMeshParser()
 
 void VolumetricMeshParser::rewindToStart()
 {
-  if (fileStack.empty()) // no files currently opened
-    return;
-
-  while (fileStack.size() > 1)
-  {
-    fclose(fileStack[fileStack.size() - 1]);
-    fileStack.pop_back();
-  }
-
-  // now, we have fileStackDepth == 0
-  fin = fileStack[0];
-  rewind(fin);
+  spanIndex = 0;
+  pos = spans.empty() ? NULL : spans[0].begin;
 }
 
 void VolumetricMeshParser::close()
 {
-  while (fileStack.size() > 0)
-  {
-    fclose(fileStack[fileStack.size() - 1]);
-    fileStack.pop_back();
-  }
+  for(size_t i=0; i<files.size(); i++)
+    if (files[i].data != NULL)
+      munmap(files[i].data, files[i].size);
+  files.clear();
+  spans.clear();
+  spanIndex = 0;
+  pos = NULL;
 }
 
 void VolumetricMeshParser::beautifyLine(char * s, int numRetainedSpaces, int removeWhitespace_)
@@ -152,64 +262,388 @@ void VolumetricMeshParser::beautifyLine(char * s, int numRetainedSpaces, int rem
 
 char * VolumetricMeshParser::getNextLine(char * s, int numRetainedSpaces, int removeWhitespace_)
 {
-  char * code;
-  do
+  while (spanIndex < spans.size())
   {
-    while (((code = fgets(s, 4096, fin)) == NULL) && (fileStack.size() > 1)) // if EOF, pop previous file from stack
+    const Span & span = spans[spanIndex];
+    if (pos >= span.end)
     {
-      fclose(fin);
-      fileStack.pop_back();
-      fin = fileStack[fileStack.size() - 1];
+      spanIndex++;
+      pos = (spanIndex < spans.size()) ? spans[spanIndex].begin : NULL;
+      continue;
     }
 
-    if (code == NULL) // reached end of main file
+    const char * line = pos;
+    const char * lineEnd;
+    pos = nextLine(pos, span.end, &lineEnd);
+
+    if (!isDataLine(line)) // ignore comments and blank lines
+      continue;
+
+    // same as fgets into a 4096-char buffer: the '\n' is kept, beautifyLine removes it
+    size_t length = (pos - line < 4095) ? size_t(pos - line) : 4095;
+    memcpy(s, line, length);
+    s[length] = 0;
+
+    beautifyLine(s, numRetainedSpaces, removeWhitespace_);
+    return s;
+  }
+
+  return NULL;
+}
+
+char * VolumetricMeshParser::getNextKeywordLine(char * s)
+{
+  while (spanIndex < spans.size())
+  {
+    const char * keyword = findKeywordLine(pos, spans[spanIndex].end);
+    if (keyword != NULL)
     {
-      return NULL; 
+      pos = keyword;
+      return getNextLine(s, 0, 0);
     }
+
+    spanIndex++;
+    pos = (spanIndex < spans.size()) ? spans[spanIndex].begin : NULL;
   }
-  while ((s[0] == '#') || (s[0] == 13) || (s[0] == 10)); // ignore comments and blank lines
 
-  beautifyLine(s, numRetainedSpaces, removeWhitespace_);
+  return NULL;
+}
 
-  // handle the case where input is specified via *INCLUDE
-  while(strncmp(s, includeToken, includeTokenLength) == 0)
+// the data lines from the current position up to the next keyword line, split into chunks at line boundaries
+void VolumetricMeshParser::findDataChunks(vector<Chunk> & chunks)
+{
+  chunks.clear();
+  while (spanIndex < spans.size())
   {
-    // open up the new file
-    char * newFile = &(s[includeTokenLength]);
-    char newFileCompleteName[4096];
-    sprintf(newFileCompleteName,"%s/%s",directoryName,newFile);
+    const Span & span = spans[spanIndex];
+    const char * keyword = findKeywordLine(pos, span.end);
+    const char * sectionEnd = (keyword != NULL) ? keyword : span.end;
 
-    FILE * finNew = fopen(newFileCompleteName, "r");
+    const char * begin = pos;
+    while (begin < sectionEnd)
+    {
+      const char * end = sectionEnd;
+      if (size_t(sectionEnd - begin) > chunkSize)
+      {
+        const char * newline = (const char*) memchr(begin + chunkSize, '\n', sectionEnd - (begin + chunkSize));
+        end = newline ? newline + 1 : sectionEnd;
+      }
+      Chunk chunk = { begin, end, span.file };
+      chunks.push_back(chunk);
+      begin = end;
+    }
 
-    if (!finNew)
+    if (keyword != NULL)
     {
-      printf("Error: couldn't open include file %s.\n", newFileCompleteName);
-      //exit(1);
-      close();
-      throw -1;
+      pos = keyword;
+      return;
     }
 
-    if ((code = fgets(s,4096,finNew)) != NULL) // new file is not empty
+    spanIndex++;
+    pos = (spanIndex < spans.size()) ? spans[spanIndex].begin : NULL;
+  }
+}
+
+void VolumetricMeshParser::skipDataLines()
+{
+  while (spanIndex < spans.size())
+  {
+    const char * keyword = findKeywordLine(pos, spans[spanIndex].end);
+    if (keyword != NULL)
     {
-      beautifyLine(s, numRetainedSpaces, removeWhitespace_);
+      pos = keyword;
+      return;
+    }
 
-      // register the new file
-      fileStack.push_back(finNew);
-      fin = finNew;
+    spanIndex++;
+    pos = (spanIndex < spans.size()) ? spans[spanIndex].begin : NULL;
+  }
+}
+
+void VolumetricMeshParser::printLineError(const char * message, const char * line, int file) const
+{
+  const char * lineEnd = line;
+  while ((*lineEnd != '\n') && (*lineEnd != 13) && (lineEnd < (const char*) files[file].data + files[file].size))
+    lineEnd++;
+  printf("%s %.*s in file %s.\n", message, int(lineEnd - line), line, files[file].name.c_str());
+}
+
+namespace
+{
+  // Parses the data lines of the chunks in parallel: a counting pass, so every chunk knows the index of its
+  // first line, then parseLine(line, lineEnd, index) on each. Returns the first line parseLine rejected, or NULL.
+  template<typename ParseLine>
+  const char * parseChunks(const vector<const char*> & begins, const vector<const char*> & ends, int * numLines,
+                           int maxLines, const ParseLine & parseLine, int * errorChunk)
+  {
+    int numChunks = int(begins.size());
+    ThreadPool & pool = ThreadPool::Get();
+
+    vector<int> firstLine(numChunks + 1, 0);
+    pool.ParallelFor(0, numChunks, 1, [&](int chunkBegin, int chunkEnd)
+    {
+      for(int c=chunkBegin; c<chunkEnd; c++)
+      {
+        int count = 0;
+        const char * lineEnd;
+        for(const char * line = begins[c]; line < ends[c]; line = nextLine(line, ends[c], &lineEnd))
+          count += isDataLine(line);
+        firstLine[c + 1] = count;
+      }
+    });
+    for(int c=0; c<numChunks; c++)
+      firstLine[c + 1] += firstLine[c];
+
+    *numLines = firstLine[numChunks];
+    if (*numLines != maxLines)
+      return NULL;
+
+    vector<const char*> errors(numChunks, (const char*) NULL);
+    pool.ParallelFor(0, numChunks, 1, [&](int chunkBegin, int chunkEnd)
+    {
+      for(int c=chunkBegin; c<chunkEnd; c++)
+      {
+        int index = firstLine[c];
+        const char * lineEnd;
+        for(const char * line = begins[c]; line < ends[c]; )
+        {
+          const char * next = nextLine(line, ends[c], &lineEnd);
+          if (isDataLine(line))
+          {
+            if (!parseLine(line, lineEnd, index))
+            {
+              errors[c] = line;
+              break;
+            }
+            index++;
+          }
+          line = next;
+        }
+      }
+    });
+
+    for(int c=0; c<numChunks; c++)
+    {
+      if (errors[c] != NULL)
+      {
+        *errorChunk = c;
+        return errors[c];
+      }
+    }
+    return NULL;
+  }
+
+  // the fields of a data line: an index, then numValues values, like the sscanf loop of VolumetricMesh::loadFromAscii
+  template<typename Value, typename ParseValue>
+  bool parseDataLine(const char * ch, const char * lineEnd, int numValues, Value * values, int * index, const ParseValue & parseValue)
+  {
+    while ((ch < lineEnd) && isSeparator(*ch))
+      ch++;
+    if (VolumetricMeshParser::parseInt(ch, lineEnd, index) == ch)
+      return false;
+
+    for(int i=0; i<=numValues; i++)
+    {
+      // seek next separator
+      while ((ch < lineEnd) && !isSeparator(*ch))
+        ch++;
+
+      if (i == numValues)
+        break;
+
+      // ignore space, comma or tab
+      while ((ch < lineEnd) && isSeparator(*ch))
+        ch++;
+
+      if ((ch == lineEnd) || (parseValue(ch, lineEnd, &values[i]) == ch))
+        return false;
+    }
+    return true;
+  }
+}
+
+int VolumetricMeshParser::parseVertexLines(int numVertices, double * vertices, int * zeroIndexed)
+{
+  vector<Chunk> chunks;
+  findDataChunks(chunks);
+
+  vector<const char*> begins(chunks.size()), ends(chunks.size());
+  for(size_t c=0; c<chunks.size(); c++)
+  {
+    begins[c] = chunks[c].begin;
+    ends[c] = chunks[c].end;
+  }
+
+  vector<char> zeroIndex(numVertices, 0);
+  int numLines = 0;
+  int errorChunk = -1;
+  const char * error = parseChunks(begins, ends, &numLines, numVertices, [&](const char * line, const char * lineEnd, int vertex)
+  {
+    int index;
+    if (!parseDataLine(line, lineEnd, 3, &vertices[3 * vertex], &index, &VolumetricMeshParser::parseDouble))
+      return false;
+    zeroIndex[vertex] = (index == 0);
+    return true;
+  }, &errorChunk);
+
+  if (numLines != numVertices)
+  {
+    printf("Error: mismatch in the number of vertices in %s.\n", files[0].name.c_str());
+    return 1;
+  }
+  if (error != NULL)
+  {
+    printLineError("Error parsing line", error, chunks[errorChunk].file);
+    return 2;
+  }
+
+  *zeroIndexed = 0;
+  for(int i=0; i<numVertices; i++)
+    *zeroIndexed |= zeroIndex[i];
+  return 0;
+}
+
+int VolumetricMeshParser::parseElementLines(int numElements, int numElementVertices, int * elementVertices, int * zeroIndexed)
+{
+  vector<Chunk> chunks;
+  findDataChunks(chunks);
+
+  vector<const char*> begins(chunks.size()), ends(chunks.size());
+  for(size_t c=0; c<chunks.size(); c++)
+  {
+    begins[c] = chunks[c].begin;
+    ends[c] = chunks[c].end;
+  }
+
+  vector<char> zeroIndex(numElements, 0);
+  int numLines = 0;
+  int errorChunk = -1;
+  const char * error = parseChunks(begins, ends, &numLines, numElements, [&](const char * line, const char * lineEnd, int element)
+  {
+    int index;
+    if (!parseDataLine(line, lineEnd, numElementVertices, &elementVertices[numElementVertices * element], &index, &VolumetricMeshParser::parseInt))
+      return false;
+    zeroIndex[element] = (index == 0);
+    return true;
+  }, &errorChunk);
+
+  if (numLines != numElements)
+  {
+    printf("Error: mismatch in the number of elements in %s.\n", files[0].name.c_str());
+    return 1;
+  }
+  if (error != NULL)
+  {
+    printLineError("Error parsing line", error, chunks[errorChunk].file);
+    return 2;
+  }
+
+  *zeroIndexed = 0;
+  for(int i=0; i<numElements; i++)
+    *zeroIndexed |= zeroIndex[i];
+  return 0;
+}
+
+// Clinger's fast path: if the digits fit into 53 bits (.veg files are written with %.15G) and the exponent
+// is small, the mantissa and the power of 10 are exact doubles, and one multiplication or division rounds
+// correctly. Everything else goes to strtod.
+const char * VolumetricMeshParser::parseDouble(const char * s, const char * end, double * value)
+{
+  const char * p = s;
+  bool negative = false;
+  if ((p < end) && ((*p == '+') || (*p == '-')))
+  {
+    negative = (*p == '-');
+    p++;
+  }
+
+  unsigned long long mantissa = 0;
+  int numDigits = 0, exponent = 0;
+  bool anyDigits = false, exact = true;
+  for(; (p < end) && ((unsigned)(*p - '0') < 10); p++)
+  {
+    anyDigits = true;
+    if (numDigits < 19)
+    {
+      mantissa = 10 * mantissa + (*p - '0');
+      numDigits += (mantissa != 0);
     }
     else
     {
-      fclose(finNew);
-      printf("Warning: include file is empty.\n");
-      code = getNextLine(s, numRetainedSpaces);
-      beautifyLine(s, numRetainedSpaces, removeWhitespace_);
-      return code;
+      exponent++;
+      exact = false;
+    }
+  }
+  if ((p < end) && (*p == '.'))
+  {
+    for(p++; (p < end) && ((unsigned)(*p - '0') < 10); p++)
+    {
+      anyDigits = true;
+      if (numDigits < 19)
+      {
+        mantissa = 10 * mantissa + (*p - '0');
+        numDigits += (mantissa != 0);
+        exponent--;
+      }
+      else
+        exact = false;
+    }
+  }
+  if ((p < end) && ((*p == 'e') || (*p == 'E')))
+  {
+    const char * q = p + 1;
+    bool negativeExponent = false;
+    if ((q < end) && ((*q == '+') || (*q == '-')))
+    {
+      negativeExponent = (*q == '-');
+      q++;
+    }
+    if ((q < end) && ((unsigned)(*q - '0') < 10))
+    {
+      int e = 0;
+      for(; (q < end) && ((unsigned)(*q - '0') < 10); q++)
+        e = (e < 100000) ? 10 * e + (*q - '0') : e;
+      exponent += negativeExponent ? -e : e;
+      p = q;
     }
   }
 
-  //printf("%s\n", s);
+  // hexadecimal, inf, nan: not produced by vega, left to strtod
+  bool special = (p < end) && ((*p == 'x') || (*p == 'X') || (*p == 'n') || (*p == 'N') || (*p == 'i') || (*p == 'I'));
+
+  if (anyDigits && !special && exact && (mantissa <= (1ull << 53)) && (exponent >= -22) && (exponent <= 22))
+  {
+    double v = (double) mantissa;
+    v = (exponent < 0) ? v / powersOf10[-exponent] : v * powersOf10[exponent];
+    *value = negative ? -v : v;
+    return p;
+  }
+
+  // strtod needs a terminated copy of the token
+  const char * tokenEnd = s;
+  while ((tokenEnd < end) && !isSeparator(*tokenEnd) && (*tokenEnd != 13) && (*tokenEnd != '\n'))
+    tokenEnd++;
+  string token(s, tokenEnd);
+  char * parsedEnd;
+  double v = strtod(token.c_str(), &parsedEnd);
+  if (parsedEnd == token.c_str())
+    return s;
+  *value = v;
+  return s + (parsedEnd - token.c_str());
+}
+
+const char * VolumetricMeshParser::parseInt(const char * s, const char * end, int * value)
+{
+  const char * p = s;
+  if ((p < end) && (*p == '+'))
+    p++;
+  if ((p == end) || ((*p == '-') && (p != s)))
+    return s;
 
-  return code;
+  from_chars_result result = from_chars(p, end, *value);
+  if (result.ec != errc())
+    return s;
+  return result.ptr;
 }
 
 // convert string to uppercase
@@ -30,11 +30,13 @@
  *                                                                       *
  *************************************************************************/
 
+
 #ifndef _VOLUMETRICMESHPARSER_H_
 #define _VOLUMETRICMESHPARSER_H_
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string>
 #include <vector>
 using namespace std;
 
@@ -42,6 +44,11 @@ using namespace std;
   A parser for the volumetric mesh text file format.
   Note: the end user never needs to use this class directly.
   See volumetricMesh.h .
+
+  The file, and every file it *INCLUDEs, is memory-mapped; the includes are
+  resolved once at open() into a sequence of line ranges. Besides reading
+  line by line, the vertex and element sections can be parsed in bulk, in
+  parallel chunks, with the same results as sscanf.
 */
 
 class VolumetricMeshParser
@@ -53,9 +60,26 @@ public:
 
   int open(const char * filename);
 
-  // return the next line, s must be externally allocated string
+  // return the next line, s must be externally allocated string (4096 chars)
   // if last line, return will be NULL
   char * getNextLine(char * s, int numRetainedSpaces=0, int removeWhitespace=1);
+  // return the next line that starts with '*', skipping the lines in between without reading them
+  char * getNextKeywordLine(char * s);
+
+  // Bulk parsing of the data lines from the current position up to the next
+  // line that starts with '*' (or the end of the input), where the position
+  // then moves. Comments and blank lines are skipped as in getNextLine.
+  // Return 0 on success; otherwise print the problem and return 1 if the
+  // number of lines is not the expected one, 2 if a line can't be parsed.
+
+  // vertex lines "index x y z" (separated by spaces, commas or tabs) into vertices[3 * numVertices];
+  // *zeroIndexed is set to 1 if any index is 0, to 0 otherwise
+  int parseVertexLines(int numVertices, double * vertices, int * zeroIndexed);
+  // element lines "index v_0 ... v_(numElementVertices-1)" into elementVertices[numElementVertices * numElements], as written;
+  // *zeroIndexed as above
+  int parseElementLines(int numElements, int numElementVertices, int * elementVertices, int * zeroIndexed);
+  // skip the data lines
+  void skipDataLines();
 
   void rewindToStart();
   void close();
@@ -64,12 +88,48 @@ public:
   static void removeWhitespace(char * s, int numRetainedSpaces=0); // any whitespace equal in length or longer to "numRetainedSpaces" is shrunk to "numRetainedSpaces" and retained
   static void beautifyLine(char * s, int numRetainedSpaces, int removeWhitespace=1); // strip whitespace + removes trailing "\n"
 
+  // parse a number at s like strtod (correctly rounded), without requiring a terminating 0; return the end of the number, or s if there is none
+  static const char * parseDouble(const char * s, const char * end, double * value);
+  // same for an int, like strtol
+  static const char * parseInt(const char * s, const char * end, int * value);
+
 protected:
-  FILE * fin;
-  vector< FILE* > fileStack;
-  //int fileStackDepth;
+  struct MappedFile
+  {
+    string name;
+    void * data;
+    size_t size;
+  };
+
+  // whole lines of one file, in reading order
+  struct Span
+  {
+    const char * begin;
+    const char * end;
+    int file;
+  };
+
+  // a part of a data section, split at line boundaries
+  struct Chunk
+  {
+    const char * begin;
+    const char * end;
+    int file;
+  };
+
+  int mapFile(const string & filename);
+  int appendSpans(int file, int depth);
+  void findDataChunks(vector<Chunk> & chunks);
+  void printLineError(const char * message, const char * line, int file) const;
+
+  vector<MappedFile> files;
+  vector<Span> spans;
+
+  // the current position
+  size_t spanIndex;
+  const char * pos;
 
-  char directoryName[4096];
+  string directoryName;
 
   char includeToken[96]; // normally "*INCLUDE "
   int includeTokenLength; // normally 9
@@ -15,6 +15,8 @@
 struct Config
 {
     std::string bundlePath;
+    // writable directory for derived data of the assets, empty: nothing is cached
+    std::string cachePath;
 
     struct Simulator
     {
@@ -25,16 +27,44 @@ struct Config
 
         struct Material {
             double E, nu, rho;
+            // hyperelastic energy of the nonlinear element model, see EnergyFunction.h
+            enum class Model { ARAP, StVK, NeoHookean, StableNeoHookean } model;
         } material;
 
         double loadStep;
         uint32_t loadedVert;
         std::vector<uint32_t> BCs;
+
+        // Corotational: linear FEM with each element's rest stiffness
+        // precomputed at StartUp, only the element rotations change per step
+        enum class ElementModel { ARAP, Corotational } elementModel;
+        // start the per-element rotation extraction from last step's result
+        bool warmStartRotations;
+
+        // instruction set of the solver and interpolation kernels, Auto picks
+        // the best one the CPU supports
+        enum class InstructionSet { Auto, Scalar, NEON, AVX2, AVX512 } instructionSet;
+
+        // run the solver on its own thread, the renderer then always shows the
+        // latest finished step instead of waiting for the current one
+        bool asynchronous;
+        // steps per second of the simulation thread, 0: as fast as it goes
+        double stepRate;
     } simulator;
 
     struct Renderer
     {
-
+        // upload the surface normals as octahedral 2x16-bit instead of 3 floats
+        bool packNormals;
+        // > 0: lazy surface update, only around simulation vertices that moved
+        // more than this (in model units) since they were last shown
+        float motionThreshold;
+        // reorder the loaded meshes for the vertex cache and fetch locality,
+        // see MeshOptimizer.h
+        bool optimizeMeshes;
+        // keep the interpolation weights as 16 bits instead of floats in the
+        // binary file they are loaded from, see InterpolationWeights.h
+        bool quantizeInterpolationWeights;
     } renderer;
 };
 
@@ -44,7 +74,10 @@ struct State
     uint32_t selectedVert;
 };
 
+// displacements of the simulation mesh, xyz interleaved; a view of the
+// simulator's own storage, valid until the next Simulator::Update
 struct Result
 {
-    std::vector<simd_float3> u;
+    const double* u;
+    uint32_t numVertices;
 };
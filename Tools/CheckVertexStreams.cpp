@@ -0,0 +1,148 @@
+//
+//  CheckVertexStreams.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+//  Runs VertexStreams headless against a CPUUploadBackend and checks what
+//  Flush uploads: merged dirty ranges, byte counts, and the buffer contents,
+//  including the round trip of the packed normals. Build from the repository
+//  root with
+//
+//      clang++ -std=c++17 -O2 Tools/CheckVertexStreams.cpp Renderer/VertexStreams.cpp -o CheckVertexStreams
+//
+
+#include "../Renderer/VertexStreams.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace
+{
+	int numFailures = 0;
+
+	void Check(bool condition, const std::string& what)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << what << '\n';
+			++numFailures;
+		}
+	}
+
+	// position and normal of a vertex, 8 floats apart like a padded Vertex
+	struct TestVertex
+	{
+		float position[3], pad0;
+		float normal[3], pad1;
+	};
+
+	VertexSource GetVertexSource(const std::vector<TestVertex>& vertices)
+	{
+		VertexSource source;
+		source.positions = vertices.front().position;
+		source.normals = vertices.front().normal;
+		source.stride = sizeof(TestVertex);
+		return source;
+	}
+
+	void CheckStreams(NormalEncoding encoding)
+	{
+		const std::string name = encoding == NormalEncoding::Float32 ? "float normals: " : "packed normals: ";
+		const uint32_t numVertices = 1000;
+		const size_t normalStride = encoding == NormalEncoding::Float32 ? 12 : 4;
+
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+		std::vector<TestVertex> vertices(numVertices);
+		for (TestVertex& v : vertices)
+		{
+			for (int k = 0; k < 3; ++k)
+				v.position[k] = uniform(rng);
+			const float n[3] = { uniform(rng), uniform(rng), uniform(rng) };
+			const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; ++k)
+				v.normal[k] = n[k] / length;
+		}
+		const std::vector<uint32_t> indices = { 0, 1, 2, 2, 1, 3 };
+
+		CPUUploadBackend backend;
+		VertexStreams streams;
+		streams.Create(backend, GetVertexSource(vertices), numVertices, indices, encoding);
+		Check(backend.GetNumUploads() == 3, name + "Create uploads indices, positions and normals once each");
+		Check(backend.GetUploadedBytes() == indices.size() * 4 + numVertices * (12 + normalStride), name + "Create uploads everything");
+		Check(streams.GetStride(VertexStreams::Normals) == normalStride, name + "normal stride");
+
+		// overlapping and touching ranges merge, separate ones do not
+		for (TestVertex& v : vertices)
+			v.position[0] += 1.f;
+		backend.ResetCounters();
+		streams.MarkDirty(VertexStreams::Positions, { { 15, 30 }, { 10, 20 } });
+		streams.MarkDirty(VertexStreams::Positions, { { 30, 40 }, { 100, 110 } });
+		streams.MarkDirty(VertexStreams::Normals, { { 500, 501 } });
+		streams.Flush(backend, GetVertexSource(vertices));
+		Check(backend.GetNumUploads() == 3, name + "Flush merges into [10, 40) and [100, 110) plus one normal range");
+		Check(backend.GetUploadedBytes() == (30 + 10) * 12 + normalStride, name + "Flush uploads only the dirty ranges");
+
+		// the uploaded positions are current inside the ranges, stale outside
+		const std::vector<uint8_t>& positions = backend.GetContents(streams.GetBuffer(VertexStreams::Positions));
+		bool current = true, stale = true;
+		for (uint32_t i = 0; i < numVertices; ++i)
+		{
+			float x;
+			memcpy(&x, positions.data() + 12 * i, sizeof(float));
+			const bool dirty = (i >= 10 && i < 40) || (i >= 100 && i < 110);
+			if (dirty)
+				current = current && x == vertices[i].position[0];
+			else
+				stale = stale && x == vertices[i].position[0] - 1.f;
+		}
+		Check(current && stale, name + "position contents");
+
+		// a flush without dirty ranges uploads nothing
+		backend.ResetCounters();
+		streams.Flush(backend, GetVertexSource(vertices));
+		Check(backend.GetNumUploads() == 0, name + "clean Flush uploads nothing");
+
+		// normals read back from the buffer
+		const std::vector<uint8_t>& normals = backend.GetContents(streams.GetBuffer(VertexStreams::Normals));
+		float maxError = 0.f;
+		for (uint32_t i = 0; i < numVertices; ++i)
+		{
+			float n[3];
+			if (encoding == NormalEncoding::Float32)
+				memcpy(n, normals.data() + 12 * i, sizeof(n));
+			else
+			{
+				uint32_t packed;
+				memcpy(&packed, normals.data() + 4 * i, sizeof(packed));
+				UnpackNormalOctahedral(packed, n);
+			}
+			for (int k = 0; k < 3; ++k)
+				maxError = std::max(maxError, std::abs(n[k] - vertices[i].normal[k]));
+		}
+		Check(maxError <= (encoding == NormalEncoding::Float32 ? 0.f : 1e-4f), name + "normal round trip, error " + std::to_string(maxError));
+	}
+}
+
+int main()
+{
+	CheckStreams(NormalEncoding::Float32);
+	CheckStreams(NormalEncoding::Octahedral16);
+
+	// octahedral edge cases: the axes, the lower hemisphere's folds, zero
+	const float cases[][3] = { { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0.6f, 0, -0.8f }, { -0.48f, 0.6f, -0.64f } };
+	for (const auto& c : cases)
+	{
+		float n[3];
+		UnpackNormalOctahedral(PackNormalOctahedral(c[0], c[1], c[2]), n);
+		Check(std::abs(n[0] - c[0]) < 1e-4f && std::abs(n[1] - c[1]) < 1e-4f && std::abs(n[2] - c[2]) < 1e-4f, "octahedral round trip of an edge case");
+	}
+	Check(PackNormalOctahedral(0, 0, 0) == 0, "zero normal packs to 0");
+
+	std::cout << (numFailures == 0 ? "all vertex stream checks passed\n" : "vertex stream checks failed\n");
+	return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+//
+//  ConvertInterpolationWeights.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+//  Converts interpolation weights into the memory-mappable .interpm the
+//  renderer picks up next to them (see InterpolationWeights.h):
+//
+//      ConvertInterpolationWeights [-q] <model>.interp <numTargets> [<model>.interpm]
+//      ConvertInterpolationWeights [-q] -m <vega multi-model binary> [<output>.interpm]
+//
+//  -q stores the weights quantized to 16 bits. Build from the repository root with
+//
+//      clang++ -std=c++17 -O2 -ISimulator/vega/minivector -ISimulator/vega/volumetricMesh
+//          -ISimulator/vega/utility Tools/ConvertInterpolationWeights.cpp Renderer/InterpolationWeights.cpp
+//          Simulator/ThreadPool.cpp Simulator/Kernels.cpp Simulator/vega/*/*.cpp -o ConvertInterpolationWeights
+//
+
+#include "../Renderer/InterpolationWeights.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+	bool quantize = false, multi = false;
+	std::vector<std::string> arguments;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		if (argument == "-q")
+			quantize = true;
+		else if (argument == "-m")
+			multi = true;
+		else
+			arguments.push_back(argument);
+	}
+
+	const size_t numInputs = multi ? 1 : 2;
+	if (arguments.size() < numInputs || arguments.size() > numInputs + 1)
+	{
+		std::cout << "usage: " << argv[0] << " [-q] <model>.interp <numTargets> [<model>.interpm]\n"
+			<< "       " << argv[0] << " [-q] -m <vega multi-model binary> [<output>.interpm]\n";
+		return 1;
+	}
+
+	const std::string input = arguments[0];
+	const uint32_t numTargets = multi ? 0 : uint32_t(std::stoul(arguments[1]));
+	std::string output = arguments.size() > numInputs ? arguments[numInputs] : input;
+	if (arguments.size() == numInputs)
+	{
+		const size_t extension = output.find_last_of('.');
+		if (extension != std::string::npos && extension > output.find_last_of('/') + 1)
+			output.resize(extension);
+		output += ".interpm";
+	}
+
+	using Clock = std::chrono::steady_clock;
+	const auto Milliseconds = [](Clock::time_point begin, Clock::time_point end) {
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	};
+
+	std::string error;
+	InterpolationWeights weights;
+	const InterpolationWeights::Encoding encoding =
+		quantize ? InterpolationWeights::Encoding::UNorm16 : InterpolationWeights::Encoding::Float32;
+
+	const Clock::time_point start = Clock::now();
+	if (!(multi ? weights.LoadVegaMultiBinary(input, error) : weights.LoadASCII(input, numTargets, error)))
+	{
+		std::cout << error << '\n';
+		return 1;
+	}
+	const Clock::time_point parsed = Clock::now();
+
+	if (!weights.SaveBinary(output, input, encoding, error))
+	{
+		std::cout << error << '\n';
+		return 1;
+	}
+
+	// read it back the way the renderer will
+	InterpolationWeights mapped;
+	const Clock::time_point mapStart = Clock::now();
+	if (!mapped.LoadBinary(output, error))
+	{
+		std::cout << error << '\n';
+		return 1;
+	}
+	const Clock::time_point mapEnd = Clock::now();
+
+	bool same = mapped.GetNumModels() == weights.GetNumModels() && mapped.GetEncoding() == encoding;
+	float maxError = 0.f;
+	for (uint32_t m = 0; same && m < weights.GetNumModels(); ++m)
+	{
+		const InterpolationWeights::Model& original = weights.GetModel(m);
+		const InterpolationWeights::Model& read = mapped.GetModel(m);
+		same = read.numTargets == original.numTargets && read.numElementVertices == original.numElementVertices;
+
+		const size_t count = size_t(original.numTargets) * original.numElementVertices;
+		for (size_t k = 0; same && k < count; ++k)
+		{
+			same = read.indices[k] == original.indices[k];
+			maxError = std::max(maxError, std::abs(read.GetWeight(k) - original.GetWeight(k)));
+		}
+		// floats are exact, quantization is off by at most half a step
+		same = same && maxError <= (quantize ? 0.51f * read.weightScale : 0.f);
+	}
+	if (!same)
+	{
+		std::cout << output << ": does not read back the same\n";
+		return 1;
+	}
+
+	std::cout << output << ": " << weights.GetNumModels() << " model(s), " << weights.GetModel(0).numTargets << " targets"
+		<< (quantize ? ", max quantization error " + std::to_string(maxError) : std::string{}) << "; "
+		<< "parsing took " << Milliseconds(start, parsed) << " ms, mapping " << Milliseconds(mapStart, mapEnd) << " ms\n";
+	return 0;
+}
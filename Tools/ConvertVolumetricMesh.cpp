@@ -0,0 +1,91 @@
+//
+//  ConvertVolumetricMesh.cpp
+//  iFEM
+//
+//  Created by Marci Solti on 2026. 10. 19..
+//  Copyright © 2026. Apple. All rights reserved.
+//
+//  Converts an ASCII .veg into the memory-mappable .vegm the solver picks up
+//  next to it (see SimulationMesh.h):
+//
+//      ConvertVolumetricMesh <model>.veg [<model>.vegm]
+//
+//  Build from the repository root with
+//
+//      clang++ -std=c++17 -O2 -ISimulator/vega/minivector -ISimulator/vega/volumetricMesh
+//          -ISimulator/vega/utility Tools/ConvertVolumetricMesh.cpp Simulator/SimulationMesh.cpp Simulator/ThreadPool.cpp
+//          Simulator/Kernels.cpp Simulator/vega/*/*.cpp -o ConvertVolumetricMesh
+//
+
+#include "../Simulator/SimulationMesh.h"
+
+#include <chrono>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		std::cout << "usage: " << argv[0] << " <model>.veg [<model>.vegm]\n";
+		return 1;
+	}
+
+	const std::string input = argv[1];
+	std::string output = argc == 3 ? argv[2] : input;
+	if (argc == 2)
+	{
+		if (output.size() > 4 && output.compare(output.size() - 4, 4, ".veg") == 0)
+			output.resize(output.size() - 4);
+		output += ".vegm";
+	}
+
+	using Clock = std::chrono::steady_clock;
+	const auto Milliseconds = [](Clock::time_point begin, Clock::time_point end) {
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	};
+
+	std::string error;
+	SimulationMesh mesh;
+
+	const Clock::time_point start = Clock::now();
+	if (!mesh.LoadASCII(input, error))
+	{
+		std::cout << error << '\n';
+		return 1;
+	}
+	const Clock::time_point parsed = Clock::now();
+
+	if (!mesh.SaveBinary(output, input, error))
+	{
+		std::cout << error << '\n';
+		return 1;
+	}
+
+	// read it back the way the solver will
+	SimulationMesh mapped;
+	const Clock::time_point mapStart = Clock::now();
+	if (!mapped.LoadBinary(output, error))
+	{
+		std::cout << error << '\n';
+		return 1;
+	}
+	const Clock::time_point mapEnd = Clock::now();
+
+	bool same = mapped.GetElementType() == mesh.GetElementType() &&
+		mapped.GetNumVertices() == mesh.GetNumVertices() &&
+		mapped.GetNumElements() == mesh.GetNumElements() &&
+		mapped.GetCubeSize() == mesh.GetCubeSize();
+	for (uint32_t i = 0; same && i < 3 * mesh.GetNumVertices(); ++i)
+		same = mapped.GetVertices()[i] == mesh.GetVertices()[i];
+	for (uint32_t i = 0; same && i < mesh.GetNumElementVertices() * mesh.GetNumElements(); ++i)
+		same = mapped.GetElements()[i] == mesh.GetElements()[i];
+	if (!same)
+	{
+		std::cout << output << ": does not read back the same\n";
+		return 1;
+	}
+
+	std::cout << output << ": " << mesh.GetNumVertices() << " vertices, " << mesh.GetNumElements() << " elements; "
+		<< "parsing took " << Milliseconds(start, parsed) << " ms, mapping " << Milliseconds(mapStart, mapEnd) << " ms\n";
+	return 0;
+}